@@ -0,0 +1,746 @@
+#include <header_parser.h>
+#include <equ_map.h>
+#include <result_cache.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <time.h>
+#include <stdatomic.h>
+
+#define BENCH_EQUATIONS     100000
+#define BENCH_FILE_HEADER   27
+#define BENCH_RECORD_SIZE   32
+#define BENCH_MAP_WINDOW    4096
+#define BENCH_DECODE_ROUNDS 20
+#define BENCH_DIVISOR_RUN   64
+#define BENCH_CHECKED_BATCH 8192
+
+// Provided by the sanitizer runtime when the build links one. Declared weak
+// so that builds without it still link, and here since not every toolchain
+// ships sanitizer/allocator_interface.h
+__attribute__((weak)) int __sanitizer_install_malloc_and_free_hooks(
+    void (* malloc_hook)(const volatile void *, size_t),
+    void (* free_hook)(const volatile void *));
+
+static atomic_uint_fast64_t alloc_count;
+static int counting_allocs;
+
+static void count_malloc(const volatile void * ptr, size_t size);
+static void count_free(const volatile void * ptr);
+static void install_alloc_hooks(void);
+static void print_allocs(uint64_t allocs, uint64_t count);
+static int bench_stream(int fd, uint64_t number_of_eq);
+static int bench_map(int fd, uint64_t number_of_eq);
+static int bench_decode(int fd, uint64_t number_of_eq);
+static int bench_solve(uint64_t number_of_eq);
+static int bench_checked(uint64_t number_of_eq);
+static int bench_cached(uint64_t number_of_eq);
+static int bench_dedupe(uint64_t number_of_eq);
+static uint8_t branching_checks(uint64_t l_operand, uint8_t opt, uint64_t r_operand, uint64_t * solution);
+static int write_equ_file(char * path, uint64_t number_of_eq);
+static uint64_t read_syscalls(void);
+static double elapsed(struct timespec * start, struct timespec * end);
+
+/*!
+ * @brief Generate an unsolved equation file and run it through the stream
+ * parser and the mmap loader while counting the read syscalls issued and the
+ * heap allocations made. The numbers are reported per equation so that they
+ * can be compared between changes to the parser. The record decoder is then
+ * timed on its own for every instruction set variant the CPU supports, as
+ * are the solver kernels. The checked multiply, divide and modulo kernels are
+ * compared against the branching checks the callbacks used to make and
+ * against looking their results up in a warm result cache. Finally batches
+ * with a growing share of repeated equations are solved with and without the
+ * duplicate pass.
+ */
+int main(int argc, char ** argv)
+{
+    uint64_t number_of_eq = BENCH_EQUATIONS;
+    if (argc > 1)
+    {
+        number_of_eq = strtoull(argv[1], NULL, 10);
+    }
+
+    char path[] = "/tmp/bench_parser_XXXXXX";
+    int fd = write_equ_file(path, number_of_eq);
+    if (-1 == fd)
+    {
+        return EXIT_FAILURE;
+    }
+
+    install_alloc_hooks();
+
+    int result = bench_stream(fd, number_of_eq);
+    if (EXIT_SUCCESS == result)
+    {
+        result = bench_map(fd, number_of_eq);
+    }
+    if (EXIT_SUCCESS == result)
+    {
+        result = bench_decode(fd, number_of_eq);
+    }
+    if (EXIT_SUCCESS == result)
+    {
+        result = bench_solve(number_of_eq);
+    }
+    if (EXIT_SUCCESS == result)
+    {
+        result = bench_checked(number_of_eq);
+    }
+    if (EXIT_SUCCESS == result)
+    {
+        result = bench_cached(number_of_eq);
+    }
+    if (EXIT_SUCCESS == result)
+    {
+        result = bench_dedupe(number_of_eq);
+    }
+
+    close(fd);
+    return result;
+}
+
+/*!
+ * @brief Parse the whole file through a stream reader
+ */
+static int bench_stream(int fd, uint64_t number_of_eq)
+{
+    struct timespec start;
+    struct timespec end;
+    lseek(fd, 0, SEEK_SET);
+    uint64_t syscalls_before = read_syscalls();
+    uint64_t allocs_before = atomic_load(&alloc_count);
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    stream_reader_t * reader = stream_reader_init(fd, SR_DEFAULT_CAPACITY);
+    equations_t * eqs = (NULL == reader) ? NULL : parse_stream(reader);
+
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    uint64_t allocs = atomic_load(&alloc_count) - allocs_before;
+    uint64_t syscalls = read_syscalls() - syscalls_before;
+
+    if (NULL == eqs)
+    {
+        fprintf(stderr, "[BENCH] Failed to parse the generated file\n");
+        stream_reader_destroy(&reader);
+        return EXIT_FAILURE;
+    }
+
+    printf("[BENCH] parse_stream: %lu equations in %.3f ms\n"
+           "\t\tread syscalls: %lu (%.4f per equation)\n",
+           number_of_eq, elapsed(&start, &end) * 1000.0,
+           syscalls, (double)syscalls / (double)number_of_eq);
+    print_allocs(allocs, number_of_eq);
+
+    free_equation(eqs);
+    stream_reader_destroy(&reader);
+    return EXIT_SUCCESS;
+}
+
+/*!
+ * @brief Map the file and decode and solve it in fixed size windows, dropping
+ * the pages of every finished window
+ */
+static int bench_map(int fd, uint64_t number_of_eq)
+{
+    struct timespec start;
+    struct timespec end;
+    uint64_t syscalls_before = read_syscalls();
+    uint64_t allocs_before = atomic_load(&alloc_count);
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    equ_map_t * map = equ_map_open(fd);
+    equ_batch_t * batch = get_equation_batch(BENCH_MAP_WINDOW);
+    if ((NULL == map) || (NULL == batch))
+    {
+        fprintf(stderr, "[BENCH] Failed to map the generated file\n");
+        equ_map_close(&map);
+        free_equation_batch(batch);
+        return EXIT_FAILURE;
+    }
+
+    for (uint64_t first = 0; first < map->header->number_of_eq; first += BENCH_MAP_WINDOW)
+    {
+        uint64_t count = map->header->number_of_eq - first;
+        count = (count < BENCH_MAP_WINDOW) ? count : BENCH_MAP_WINDOW;
+        equ_map_load_batch(map, first, count, batch);
+        solve_equation_batch(batch);
+        equ_map_release(map, first + count);
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    uint64_t allocs = atomic_load(&alloc_count) - allocs_before;
+    uint64_t syscalls = read_syscalls() - syscalls_before;
+
+    printf("[BENCH] equ_map decode and solve: %lu equations in %.3f ms\n"
+           "\t\tread syscalls: %lu (%.4f per equation)\n",
+           number_of_eq, elapsed(&start, &end) * 1000.0,
+           syscalls, (double)syscalls / (double)number_of_eq);
+    print_allocs(allocs, number_of_eq);
+
+    equ_map_close(&map);
+    free_equation_batch(batch);
+    return EXIT_SUCCESS;
+}
+
+/*!
+ * @brief Decode every record of the mapped file into one batch with each
+ * decoder variant and report the records decoded per second
+ */
+static int bench_decode(int fd, uint64_t number_of_eq)
+{
+    static const struct
+    {
+        decode_variant_t variant;
+        const char * name;
+    } variants[] = {
+        {DECODE_VARIANT_SCALAR, "scalar"},
+        {DECODE_VARIANT_AVX2,   "avx2"},
+        {DECODE_VARIANT_AVX512, "avx512"},
+    };
+
+    equ_map_t * map = equ_map_open(fd);
+    equ_batch_t * batch = get_equation_batch(number_of_eq);
+    if ((NULL == map) || (NULL == batch))
+    {
+        fprintf(stderr, "[BENCH] Failed to map the generated file\n");
+        equ_map_close(&map);
+        free_equation_batch(batch);
+        return EXIT_FAILURE;
+    }
+
+    decode_variant_t original = get_decode_variant();
+    for (size_t i = 0; i < sizeof(variants) / sizeof(variants[0]); i++)
+    {
+        if (0 == set_decode_variant(variants[i].variant))
+        {
+            printf("[BENCH] decode %-6s: not supported by this CPU\n", variants[i].name);
+            continue;
+        }
+
+        struct timespec start;
+        struct timespec end;
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        for (int round = 0; round < BENCH_DECODE_ROUNDS; round++)
+        {
+            equ_map_load_batch(map, 0, number_of_eq, batch);
+        }
+        clock_gettime(CLOCK_MONOTONIC, &end);
+
+        double seconds = elapsed(&start, &end);
+        printf("[BENCH] decode %-6s: %.1f M records/sec\n", variants[i].name,
+               (double)(number_of_eq * BENCH_DECODE_ROUNDS) / seconds / 1e6);
+    }
+    set_decode_variant(original);
+
+    equ_map_close(&map);
+    free_equation_batch(batch);
+    return EXIT_SUCCESS;
+}
+
+/*!
+ * @brief Solve columns of the operators that have SIMD kernels with each
+ * solver variant. The columns are solved once sorted into one run per
+ * operator and once with the operators interleaved at random like a real
+ * file, which goes through the bucketing stage.
+ */
+static int bench_solve(uint64_t number_of_eq)
+{
+    static const struct
+    {
+        solve_variant_t variant;
+        const char * name;
+    } variants[] = {
+        {SOLVE_VARIANT_SCALAR, "scalar"},
+        {SOLVE_VARIANT_AVX2,   "avx2"},
+        {SOLVE_VARIANT_AVX512, "avx512"},
+    };
+    static const uint8_t opts[] = {0x01, 0x02, 0x06, 0x07, 0x08, 0x09, 0x0a, 0x0b, 0x0c};
+    const uint64_t opt_count = sizeof(opts) / sizeof(opts[0]);
+
+    equ_batch_t * batch = get_equation_batch(number_of_eq);
+    if (NULL == batch)
+    {
+        fprintf(stderr, "[BENCH] Failed to allocate the solve columns\n");
+        return EXIT_FAILURE;
+    }
+
+    srand(1337);
+    for (uint64_t i = 0; i < number_of_eq; i++)
+    {
+        batch->l_operand[i] = (uint64_t)rand() * (uint64_t)rand();
+        batch->opt[i] = opts[(i * opt_count) / number_of_eq];
+        batch->r_operand[i] = (batch->opt[i] >= 0x06) ? (uint64_t)(rand() % 80) : (uint64_t)rand();
+    }
+
+    solve_variant_t original = get_solve_variant();
+    for (int mixed = 0; mixed < 2; mixed++)
+    {
+        // Shuffle the operators with their operands for the second pass
+        for (uint64_t i = number_of_eq; (1 == mixed) && (i > 1); i--)
+        {
+            uint64_t j = (uint64_t)rand() % i;
+            uint64_t l_operand = batch->l_operand[i - 1];
+            uint64_t r_operand = batch->r_operand[i - 1];
+            uint8_t opt = batch->opt[i - 1];
+            batch->l_operand[i - 1] = batch->l_operand[j];
+            batch->r_operand[i - 1] = batch->r_operand[j];
+            batch->opt[i - 1] = batch->opt[j];
+            batch->l_operand[j] = l_operand;
+            batch->r_operand[j] = r_operand;
+            batch->opt[j] = opt;
+        }
+
+        for (size_t i = 0; i < sizeof(variants) / sizeof(variants[0]); i++)
+        {
+            const char * layout = (0 == mixed) ? "sorted" : "mixed";
+            if (0 == set_solve_variant(variants[i].variant))
+            {
+                printf("[BENCH] solve %-6s %-6s: not supported by this CPU\n", layout, variants[i].name);
+                continue;
+            }
+
+            struct timespec start;
+            struct timespec end;
+            clock_gettime(CLOCK_MONOTONIC, &start);
+            for (int round = 0; round < BENCH_DECODE_ROUNDS; round++)
+            {
+                solve_equation_batch(batch);
+            }
+            clock_gettime(CLOCK_MONOTONIC, &end);
+
+            double seconds = elapsed(&start, &end);
+            printf("[BENCH] solve %-6s %-6s: %.1f M equations/sec\n", layout, variants[i].name,
+                   (double)(number_of_eq * BENCH_DECODE_ROUNDS) / seconds / 1e6);
+        }
+    }
+    set_solve_variant(original);
+
+    free_equation_batch(batch);
+    return EXIT_SUCCESS;
+}
+
+/*!
+ * @brief Time multiply, divide and modulo over signed operands of every
+ * magnitude, about a quarter of which overflow or divide by zero. Each
+ * operator is solved by the column kernels and by the branching checks to
+ * show the cost per equation of both. Division and modulo are timed again
+ * with each divisor repeated for BENCH_DIVISOR_RUN equations, and all three
+ * with the 16 bit operands the grader generates
+ */
+static int bench_checked(uint64_t number_of_eq)
+{
+    static const struct
+    {
+        uint8_t opt;
+        uint64_t run;
+        uint8_t narrow;
+        const char * name;
+    } operators[] = {
+        {0x03, 1, 0, "mul"},
+        {0x04, 1, 0, "div"},
+        {0x05, 1, 0, "mod"},
+        {0x04, BENCH_DIVISOR_RUN, 0, "div runs"},
+        {0x05, BENCH_DIVISOR_RUN, 0, "mod runs"},
+        {0x03, 1, 1, "mul 16 bit"},
+        {0x04, 1, 1, "div 16 bit"},
+        {0x05, 1, 1, "mod 16 bit"},
+    };
+
+    // Solve one cache sized batch over and over so the time is spent on the
+    // arithmetic rather than waiting on memory
+    uint64_t batch_size = (number_of_eq < BENCH_CHECKED_BATCH) ? number_of_eq : BENCH_CHECKED_BATCH;
+    if (0 == batch_size)
+    {
+        return EXIT_SUCCESS;
+    }
+    uint64_t rounds = (number_of_eq * BENCH_DECODE_ROUNDS) / batch_size;
+    equ_batch_t * batch = get_equation_batch(batch_size);
+    if (NULL == batch)
+    {
+        fprintf(stderr, "[BENCH] Failed to allocate the checked columns\n");
+        return EXIT_FAILURE;
+    }
+
+    srand(7331);
+    for (size_t op = 0; op < sizeof(operators) / sizeof(operators[0]); op++)
+    {
+        for (uint64_t i = 0; i < batch_size; i++)
+        {
+            // Shift random values down by a random amount so the products
+            // land on both sides of the 64 bit range
+            uint64_t l_operand = ((uint64_t)rand() << 33 | (uint64_t)rand()) >> (rand() % 64);
+            uint64_t r_operand = ((uint64_t)rand() << 33 | (uint64_t)rand()) >> (rand() % 64);
+            batch->l_operand[i] = (rand() & 1) ? l_operand : 0 - l_operand;
+            batch->r_operand[i] = (0 == (rand() % 16)) ? 0 : ((rand() & 1) ? r_operand : 0 - r_operand);
+            if (0 != (i % operators[op].run))
+            {
+                batch->r_operand[i] = batch->r_operand[i - 1];
+            }
+            if (operators[op].narrow)
+            {
+                // Same range as the operands the grader generates
+                batch->l_operand[i] = (uint64_t)(rand() % 65537);
+                batch->r_operand[i] = (uint64_t)(rand() % 65537);
+            }
+            batch->opt[i] = operators[op].opt;
+        }
+
+        // Time the scalar kernels first and then the ones this CPU selected
+        struct timespec start;
+        struct timespec end;
+        double kernel_seconds[2] = {0};
+        solve_variant_t original = get_solve_variant();
+        for (int variant = 0; variant < 2; variant++)
+        {
+            set_solve_variant((0 == variant) ? SOLVE_VARIANT_SCALAR : original);
+            clock_gettime(CLOCK_MONOTONIC, &start);
+            for (uint64_t round = 0; round < rounds; round++)
+            {
+                solve_equation_batch(batch);
+            }
+            clock_gettime(CLOCK_MONOTONIC, &end);
+            kernel_seconds[variant] = elapsed(&start, &end);
+        }
+
+        uint64_t mismatches = 0;
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        for (uint64_t round = 0; round < rounds; round++)
+        {
+            for (uint64_t i = 0; i < batch_size; i++)
+            {
+                uint64_t solution = 0;
+                uint8_t solved = branching_checks(batch->l_operand[i], batch->opt[i], batch->r_operand[i], &solution);
+                mismatches += (solved != batch->result[i]) | (solved & (solution != batch->solution[i]));
+            }
+        }
+        clock_gettime(CLOCK_MONOTONIC, &end);
+        double branch_seconds = elapsed(&start, &end);
+
+        uint64_t solved = batch_size * rounds;
+        printf("[BENCH] checked %-10s: scalar %.2f ns/equation, selected %.2f ns/equation, "
+               "branching %.2f ns/equation\n", operators[op].name, kernel_seconds[0] * 1e9 / (double)solved,
+               kernel_seconds[1] * 1e9 / (double)solved, branch_seconds * 1e9 / (double)solved);
+        if (0 != mismatches)
+        {
+            fprintf(stderr, "[BENCH] checked %s: %lu results differ\n", operators[op].name, mismatches);
+            free_equation_batch(batch);
+            return EXIT_FAILURE;
+        }
+    }
+
+    free_equation_batch(batch);
+    return EXIT_SUCCESS;
+}
+
+/*!
+ * @brief Solve a batch of multiply, divide and modulo equations with the
+ * selected kernels, then again with every result already in the result
+ * cache, the case of a client resubmitting the same file
+ */
+static int bench_cached(uint64_t number_of_eq)
+{
+    static const struct
+    {
+        uint8_t opt;
+        const char * name;
+    } operators[] = {
+        {0x03, "mul"},
+        {0x04, "div"},
+        {0x05, "mod"},
+    };
+
+    uint64_t batch_size = (number_of_eq < BENCH_CHECKED_BATCH) ? number_of_eq : BENCH_CHECKED_BATCH;
+    if (0 == batch_size)
+    {
+        return EXIT_SUCCESS;
+    }
+    uint64_t rounds = (number_of_eq * BENCH_DECODE_ROUNDS) / batch_size;
+    equ_batch_t * batch = get_equation_batch(batch_size);
+    if (NULL == batch)
+    {
+        fprintf(stderr, "[BENCH] Failed to allocate the cached columns\n");
+        return EXIT_FAILURE;
+    }
+
+    srand(1337);
+    for (size_t op = 0; op < sizeof(operators) / sizeof(operators[0]); op++)
+    {
+        for (uint64_t i = 0; i < batch_size; i++)
+        {
+            batch->l_operand[i] = ((uint64_t)rand() << 33 | (uint64_t)rand()) >> (rand() % 64);
+            batch->r_operand[i] = ((uint64_t)rand() << 33 | (uint64_t)rand()) >> (rand() % 64);
+            batch->opt[i] = operators[op].opt;
+        }
+
+        struct timespec start;
+        struct timespec end;
+        double seconds[2] = {0};
+        for (int cached = 0; cached < 2; cached++)
+        {
+            if (cached && (-1 == result_cache_init(batch_size * 2)))
+            {
+                fprintf(stderr, "[BENCH] Failed to create the result cache\n");
+                free_equation_batch(batch);
+                return EXIT_FAILURE;
+            }
+
+            // Warm up the cache, and the kernels for a fair comparison
+            solve_equation_batch(batch);
+            clock_gettime(CLOCK_MONOTONIC, &start);
+            for (uint64_t round = 0; round < rounds; round++)
+            {
+                solve_equation_batch(batch);
+            }
+            clock_gettime(CLOCK_MONOTONIC, &end);
+            seconds[cached] = elapsed(&start, &end);
+        }
+
+        result_cache_stats_t stats;
+        result_cache_stats(&stats);
+        result_cache_destroy();
+
+        uint64_t solved = batch_size * rounds;
+        printf("[BENCH] cached %-3s: kernels %.2f ns/equation, warm cache %.2f ns/equation "
+               "(%.1f%% hits)\n", operators[op].name, seconds[0] * 1e9 / (double)solved,
+               seconds[1] * 1e9 / (double)solved,
+               100.0 * (double)stats.hits / (double)(stats.hits + stats.misses));
+    }
+
+    free_equation_batch(batch);
+    return EXIT_SUCCESS;
+}
+
+/*!
+ * @brief Solve batches where the given share of equations repeat an earlier
+ * one through solve_equation_batch, which deduplicates once enough of a
+ * sample repeats, and through solve_columns which solves every equation
+ */
+static int bench_dedupe(uint64_t number_of_eq)
+{
+    static const uint64_t repeat_percents[] = {0, 50, 90, 99};
+
+    uint64_t batch_size = (number_of_eq < BENCH_CHECKED_BATCH * 2) ? number_of_eq : BENCH_CHECKED_BATCH * 2;
+    if (0 == batch_size)
+    {
+        return EXIT_SUCCESS;
+    }
+    uint64_t rounds = (number_of_eq * BENCH_DECODE_ROUNDS) / batch_size;
+    equ_batch_t * batch = get_equation_batch(batch_size);
+    if (NULL == batch)
+    {
+        fprintf(stderr, "[BENCH] Failed to allocate the dedupe columns\n");
+        return EXIT_FAILURE;
+    }
+
+    srand(4242);
+    for (size_t percent = 0; percent < sizeof(repeat_percents) / sizeof(repeat_percents[0]); percent++)
+    {
+        for (uint64_t i = 0; i < batch_size; i++)
+        {
+            if ((0 != i) && ((uint64_t)(rand() % 100) < repeat_percents[percent]))
+            {
+                uint64_t earlier = (uint64_t)rand() % i;
+                batch->l_operand[i] = batch->l_operand[earlier];
+                batch->opt[i] = batch->opt[earlier];
+                batch->r_operand[i] = batch->r_operand[earlier];
+                continue;
+            }
+            batch->l_operand[i] = ((uint64_t)rand() << 33 | (uint64_t)rand()) >> (rand() % 64);
+            batch->r_operand[i] = ((uint64_t)rand() << 33 | (uint64_t)rand()) >> (rand() % 64);
+            batch->opt[i] = (uint8_t)(1 + (rand() % 12));
+        }
+
+        struct timespec start;
+        struct timespec end;
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        for (uint64_t round = 0; round < rounds; round++)
+        {
+            solve_columns(batch->l_operand, batch->opt, batch->r_operand, batch->count,
+                          batch->solution, batch->sign, batch->result);
+        }
+        clock_gettime(CLOCK_MONOTONIC, &end);
+        double columns_seconds = elapsed(&start, &end);
+
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        for (uint64_t round = 0; round < rounds; round++)
+        {
+            solve_equation_batch(batch);
+        }
+        clock_gettime(CLOCK_MONOTONIC, &end);
+        double batch_seconds = elapsed(&start, &end);
+
+        uint64_t solved = batch_size * rounds;
+        printf("[BENCH] dedupe %2lu%% repeats: every equation %.2f ns/equation, adaptive %.2f ns/equation\n",
+               repeat_percents[percent], columns_seconds * 1e9 / (double)solved,
+               batch_seconds * 1e9 / (double)solved);
+    }
+
+    free_equation_batch(batch);
+    return EXIT_SUCCESS;
+}
+
+/*!
+ * @brief Overflow checks made with comparisons against a quotient, the way
+ * the multiply callback used to detect overflow, kept as the baseline for
+ * bench_checked. Negative right operands are checked on the quotient of the
+ * magnitudes so the baseline produces the same results as the kernels
+ * @return 1 if the equation was solved otherwise 0
+ */
+static uint8_t branching_checks(uint64_t l_operand, uint8_t opt, uint64_t r_operand, uint64_t * solution)
+{
+    int64_t l_value = (int64_t)l_operand;
+    int64_t r_value = (int64_t)r_operand;
+
+    if (0x03 == opt)
+    {
+        // A negative right operand is never solved
+        if (r_value < 0)
+        {
+            return 0;
+        }
+        if ((0 != r_value) && ((l_value > (INT64_MAX / r_value)) || (l_value < (INT64_MIN / r_value))))
+        {
+            return 0;
+        }
+        *solution = (uint64_t)(l_value * r_value);
+        return 1;
+    }
+
+    if ((0 == r_value)
+        || ((INT64_MIN == l_value) && (-1 == r_value))
+        || ((INT64_MIN == r_value) && (-1 == l_value)))
+    {
+        return 0;
+    }
+    *solution = (uint64_t)((0x04 == opt) ? (l_value / r_value) : (l_value % r_value));
+    return 1;
+}
+
+/*!
+ * @brief Count allocations through the sanitizer hooks when the runtime is
+ * linked in
+ */
+static void install_alloc_hooks(void)
+{
+    if (NULL == __sanitizer_install_malloc_and_free_hooks)
+    {
+        printf("[BENCH] No sanitizer runtime, allocations are not counted\n");
+        return;
+    }
+    __sanitizer_install_malloc_and_free_hooks(count_malloc, count_free);
+    counting_allocs = 1;
+}
+
+static void print_allocs(uint64_t allocs, uint64_t count)
+{
+    if (!counting_allocs)
+    {
+        printf("\t\tallocations:   not counted\n");
+        return;
+    }
+    printf("\t\tallocations:   %lu (%.4f per equation)\n", allocs, (double)allocs / (double)count);
+}
+
+static void count_malloc(const volatile void * ptr, size_t size)
+{
+    (void)ptr;
+    (void)size;
+    atomic_fetch_add(&alloc_count, 1);
+}
+
+static void count_free(const volatile void * ptr)
+{
+    (void)ptr;
+}
+
+/*!
+ * @brief Write an unsolved equation file to a temporary file using the same
+ * value ranges as EquGrader.gen_equations. The file is unlinked right away
+ * so only the returned descriptor keeps it alive.
+ * @param path mkstemp template for the temporary file
+ * @param number_of_eq Number of equations to generate
+ * @return File descriptor positioned at the start of the file or -1
+ */
+static int write_equ_file(char * path, uint64_t number_of_eq)
+{
+    int fd = mkstemp(path);
+    if (-1 == fd)
+    {
+        perror("[BENCH] mkstemp");
+        return -1;
+    }
+    unlink(path);
+
+    uint8_t header[BENCH_FILE_HEADER] = {0};
+    uint32_t magic = MAGIC_VALUE;
+    uint64_t file_id = 0x0b7ce70362787a3a;
+    uint32_t offset = BENCH_FILE_HEADER;
+    memcpy(header, &magic, HEAD_MAGIC);
+    memcpy(header + 4, &file_id, HEAD_FILEID);
+    memcpy(header + 12, &number_of_eq, HEAD_NUM_OF_EQU);
+    memcpy(header + 21, &offset, HEAD_EQU_OFFSET);
+    if (BENCH_FILE_HEADER != write(fd, header, BENCH_FILE_HEADER))
+    {
+        perror("[BENCH] write");
+        close(fd);
+        return -1;
+    }
+
+    srand(1337);
+    uint8_t record[BENCH_RECORD_SIZE];
+    for (uint64_t i = 0; i < number_of_eq; i++)
+    {
+        memset(record, 0, BENCH_RECORD_SIZE);
+        uint32_t eq_id = (uint32_t)i;
+        uint8_t opt = (uint8_t)(rand() % 12 + 1);
+        uint64_t l_operand = (uint64_t)(rand() % 0x10001);
+        uint64_t r_operand = (opt >= 0x06) ? (uint64_t)(rand() % 17)
+                                           : (uint64_t)(rand() % 0x10001);
+        memcpy(record, &eq_id, UNSO_EQU_ID);
+        memcpy(record + 5, &l_operand, L_OPERAND);
+        record[13] = opt;
+        memcpy(record + 14, &r_operand, R_OPERAND);
+        if (BENCH_RECORD_SIZE != write(fd, record, BENCH_RECORD_SIZE))
+        {
+            perror("[BENCH] write");
+            close(fd);
+            return -1;
+        }
+    }
+
+    return fd;
+}
+
+/*!
+ * @brief Fetch the number of read syscalls issued by this process so far
+ * @return Value of the syscr field of /proc/self/io or 0 if not available
+ */
+static uint64_t read_syscalls(void)
+{
+    FILE * io = fopen("/proc/self/io", "r");
+    if (NULL == io)
+    {
+        return 0;
+    }
+
+    char line[128];
+    uint64_t syscr = 0;
+    while (NULL != fgets(line, sizeof(line), io))
+    {
+        if (1 == sscanf(line, "syscr: %lu", &syscr))
+        {
+            break;
+        }
+    }
+    fclose(io);
+    return syscr;
+}
+
+static double elapsed(struct timespec * start, struct timespec * end)
+{
+    return (double)(end->tv_sec - start->tv_sec)
+           + (double)(end->tv_nsec - start->tv_nsec) / 1e9;
+}
@@ -0,0 +1,303 @@
+#include <thread_pool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <sched.h>
+#include <stdatomic.h>
+
+#define BENCH_JOBS      1000000
+#define BENCH_THREADS   4
+#define BENCH_WARMUP    10000
+#define BENCH_BATCH     64
+#define BENCH_LIFECYCLE 50
+
+// Provided by the sanitizer runtime when the build links one. Declared weak
+// so that builds without it still link, and here since not every toolchain
+// ships sanitizer/allocator_interface.h
+__attribute__((weak)) int __sanitizer_install_malloc_and_free_hooks(
+    void (* malloc_hook)(const volatile void *, size_t),
+    void (* free_hook)(const volatile void *));
+
+typedef enum
+{
+    SUBMIT_MALLOC_ARG,      // A malloc'd int freed by the job, how fds were passed
+    SUBMIT_INLINE_ARG,      // The int copied into the job
+    SUBMIT_FROM_WORKER,     // Inline jobs spawned by a job onto its worker's deque
+    SUBMIT_BATCH,           // BENCH_BATCH jobs at a time through thpool_enqueue_batch
+} submit_mode_t;
+
+// Handed to the job that spawns jobs from inside the pool
+typedef struct spawn_args_t
+{
+    thpool_t * thpool;
+    uint64_t number_of_jobs;
+} spawn_args_t;
+
+static atomic_uint_fast64_t alloc_count;
+static int counting_allocs;
+static atomic_uint_fast64_t jobs_run;
+
+static void count_malloc(const volatile void * ptr, size_t size);
+static void count_free(const volatile void * ptr);
+static void install_alloc_hooks(void);
+static void print_allocs(uint64_t allocs, uint64_t count);
+static void job_malloc_arg(void * arg);
+static void job_inline_arg(void * arg);
+static void job_spawn(void * arg);
+static void submit(thpool_t * thpool, submit_mode_t mode, uint64_t number_of_jobs);
+static int bench_submit(thpool_t * thpool, submit_mode_t mode, const char * name, uint64_t number_of_jobs);
+static int bench_lifecycle(uint8_t thread_count);
+static double elapsed(struct timespec * start, struct timespec * end);
+
+/*!
+ * @brief Time starting and stopping pools of a few sizes, then push jobs
+ * through a warmed up thread pool while counting the heap allocations made
+ * by the pool and its callers. The numbers are reported per
+ * job so that they can be compared between changes to the pool. Jobs passing
+ * a malloc'd argument are compared against jobs carrying their argument
+ * inline, both submitted from outside the pool and spawned from a job
+ * running on a worker, and against jobs submitted in batches.
+ */
+int main(int argc, char ** argv)
+{
+    uint64_t number_of_jobs = BENCH_JOBS;
+    if (argc > 1)
+    {
+        number_of_jobs = strtoull(argv[1], NULL, 10);
+    }
+
+    int result = EXIT_SUCCESS;
+    uint8_t lifecycle_threads[] = {1, 8, 64};
+    for (size_t size = 0; (size < sizeof(lifecycle_threads)) && (EXIT_SUCCESS == result); size++)
+    {
+        result = bench_lifecycle(lifecycle_threads[size]);
+    }
+    if (EXIT_SUCCESS != result)
+    {
+        return result;
+    }
+
+    thpool_t * thpool = thpool_init(BENCH_THREADS);
+    if (NULL == thpool)
+    {
+        fprintf(stderr, "[BENCH] Failed to create the thread pool\n");
+        return EXIT_FAILURE;
+    }
+
+    // Only count the steady state, not the set up of the pool
+    submit(thpool, SUBMIT_INLINE_ARG, BENCH_WARMUP);
+    install_alloc_hooks();
+
+    result = bench_submit(thpool, SUBMIT_MALLOC_ARG, "malloc'd arg", number_of_jobs);
+    if (EXIT_SUCCESS == result)
+    {
+        result = bench_submit(thpool, SUBMIT_INLINE_ARG, "inline arg", number_of_jobs);
+    }
+    if (EXIT_SUCCESS == result)
+    {
+        result = bench_submit(thpool, SUBMIT_FROM_WORKER, "from worker", number_of_jobs);
+    }
+    if (EXIT_SUCCESS == result)
+    {
+        result = bench_submit(thpool, SUBMIT_BATCH, "batch", number_of_jobs);
+    }
+
+    thpool_destroy(&thpool);
+    return result;
+}
+
+/*!
+ * @brief Start and stop a pool of idle threads repeatedly and report the
+ * mean time thpool_init and thpool_destroy take
+ */
+static int bench_lifecycle(uint8_t thread_count)
+{
+    struct timespec start;
+    struct timespec ready;
+    struct timespec end;
+    double init_time = 0;
+    double destroy_time = 0;
+
+    for (int round = 0; round < BENCH_LIFECYCLE; round++)
+    {
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        thpool_t * thpool = thpool_init(thread_count);
+        clock_gettime(CLOCK_MONOTONIC, &ready);
+        if (NULL == thpool)
+        {
+            fprintf(stderr, "[BENCH] Failed to create a pool of %u threads\n", thread_count);
+            return EXIT_FAILURE;
+        }
+        thpool_destroy(&thpool);
+        clock_gettime(CLOCK_MONOTONIC, &end);
+
+        init_time += elapsed(&start, &ready);
+        destroy_time += elapsed(&ready, &end);
+    }
+
+    printf("[BENCH] lifecycle of %3u threads: init %.1f us, destroy %.1f us\n",
+           thread_count,
+           init_time * 1e6 / BENCH_LIFECYCLE,
+           destroy_time * 1e6 / BENCH_LIFECYCLE);
+    return EXIT_SUCCESS;
+}
+
+/*!
+ * @brief Submit jobs in the given way and wait for all of them to finish
+ */
+static int bench_submit(thpool_t * thpool, submit_mode_t mode, const char * name, uint64_t number_of_jobs)
+{
+    struct timespec start;
+    struct timespec end;
+    atomic_store(&jobs_run, 0);
+    uint64_t allocs_before = atomic_load(&alloc_count);
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    submit(thpool, mode, number_of_jobs);
+
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    uint64_t allocs = atomic_load(&alloc_count) - allocs_before;
+
+    if (number_of_jobs != atomic_load(&jobs_run))
+    {
+        fprintf(stderr, "[BENCH] %s: %lu of %lu jobs ran\n",
+                name, atomic_load(&jobs_run), number_of_jobs);
+        return EXIT_FAILURE;
+    }
+
+    printf("[BENCH] %-12s %lu jobs in %.3f ms (%.1f ns per job)\n",
+           name, number_of_jobs, elapsed(&start, &end) * 1000.0,
+           elapsed(&start, &end) * 1e9 / (double)number_of_jobs);
+    print_allocs(allocs, number_of_jobs);
+    return EXIT_SUCCESS;
+}
+
+/*!
+ * @brief Enqueue the jobs, retrying while the queue is full, and wait for
+ * the pool to drain
+ */
+static void submit(thpool_t * thpool, submit_mode_t mode, uint64_t number_of_jobs)
+{
+    if (SUBMIT_FROM_WORKER == mode)
+    {
+        spawn_args_t spawn = {.thpool = thpool, .number_of_jobs = number_of_jobs};
+        thpool_enqueue_job(thpool, job_spawn, &spawn);
+        thpool_wait(thpool);
+        return;
+    }
+
+    if (SUBMIT_BATCH == mode)
+    {
+        static int value = 0;
+        void * args[BENCH_BATCH];
+        for (size_t job = 0; job < BENCH_BATCH; job++)
+        {
+            args[job] = &value;
+        }
+        for (uint64_t job = 0; job < number_of_jobs; job += BENCH_BATCH)
+        {
+            size_t count = (number_of_jobs - job < BENCH_BATCH) ? (size_t)(number_of_jobs - job) : BENCH_BATCH;
+            while (THP_SUCCESS != thpool_enqueue_batch(thpool, job_inline_arg, args, count))
+            {
+                sched_yield();
+            }
+        }
+        thpool_wait(thpool);
+        return;
+    }
+
+    for (uint64_t job = 0; job < number_of_jobs; job++)
+    {
+        int value = (int)job;
+        if (SUBMIT_MALLOC_ARG == mode)
+        {
+            int * arg = (int *)malloc(sizeof(int));
+            *arg = value;
+            while (THP_SUCCESS != thpool_enqueue_job(thpool, job_malloc_arg, arg))
+            {
+                sched_yield();
+            }
+        }
+        else
+        {
+            while (THP_SUCCESS != thpool_enqueue_inline(thpool, job_inline_arg, &value, sizeof(value)))
+            {
+                sched_yield();
+            }
+        }
+    }
+    thpool_wait(thpool);
+}
+
+/*!
+ * @brief Spawn the jobs from inside the pool so they go onto the deque of
+ * the worker running this job, other workers steal them from there
+ */
+static void job_spawn(void * arg)
+{
+    spawn_args_t * spawn = (spawn_args_t *)arg;
+    for (uint64_t job = 0; job < spawn->number_of_jobs; job++)
+    {
+        int value = (int)job;
+        while (THP_SUCCESS != thpool_enqueue_inline(spawn->thpool, job_inline_arg, &value, sizeof(value)))
+        {
+            sched_yield();
+        }
+    }
+}
+
+static void job_malloc_arg(void * arg)
+{
+    (void)*(volatile int *)arg;
+    free(arg);
+    atomic_fetch_add_explicit(&jobs_run, 1, memory_order_relaxed);
+}
+
+static void job_inline_arg(void * arg)
+{
+    (void)*(volatile int *)arg;
+    atomic_fetch_add_explicit(&jobs_run, 1, memory_order_relaxed);
+}
+
+/*!
+ * @brief Count allocations through the sanitizer hooks when the runtime is
+ * linked in
+ */
+static void install_alloc_hooks(void)
+{
+    if (NULL == __sanitizer_install_malloc_and_free_hooks)
+    {
+        printf("[BENCH] No sanitizer runtime, allocations are not counted\n");
+        return;
+    }
+    __sanitizer_install_malloc_and_free_hooks(count_malloc, count_free);
+    counting_allocs = 1;
+}
+
+static void print_allocs(uint64_t allocs, uint64_t count)
+{
+    if (!counting_allocs)
+    {
+        printf("\t\tallocations:   not counted\n");
+        return;
+    }
+    printf("\t\tallocations:   %lu (%.4f per job)\n", allocs, (double)allocs / (double)count);
+}
+
+static void count_malloc(const volatile void * ptr, size_t size)
+{
+    (void)ptr;
+    (void)size;
+    atomic_fetch_add(&alloc_count, 1);
+}
+
+static void count_free(const volatile void * ptr)
+{
+    (void)ptr;
+}
+
+static double elapsed(struct timespec * start, struct timespec * end)
+{
+    return (double)(end->tv_sec - start->tv_sec)
+           + (double)(end->tv_nsec - start->tv_nsec) / 1e9;
+}
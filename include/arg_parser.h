@@ -12,13 +12,17 @@ extern "C" {
 typedef enum
 {
     DEFAULT_PORT    = 31337,
-    DEFAULT_THREADS = 4
+    DEFAULT_THREADS = 4,
+    DEFAULT_WINDOW  = 16384,
+    DEFAULT_CACHE   = 0         // Result cache is disabled unless sized
 } args_default_t;
 
 typedef struct args_t
 {
     uint32_t port;
     uint8_t threads;
+    uint32_t window;
+    uint32_t cache_size;
 } args_t;
 
 args_t * parse_args(int argc, char ** argv);
@@ -7,6 +7,7 @@ extern "C" {
 
 #include <stdint.h>
 #include <utils.h>
+#include <cpu_dispatch.h>
 // This enum is used for the eval union return value
 typedef enum eq_eval_type_t
 {
@@ -21,11 +22,53 @@ typedef enum eq_result_t
     EQ_UNSOLVED = 2    // Equation has not been attempted yet
 } eq_result_t;
 
+// Every supported operator as X(code, name, sign, cached). The sign is the
+// eq_eval_type_t of a solved result, failures are always EQ_VAL_UNSIGNED.
+// Operators marked cached are slow enough to look up in the result cache
+// before solving. The callback and kernel tables are generated from this
+// list and the codes must cover OPERATOR_MIN through OPERATOR_MAX exactly once
+#define OPERATORS(X)                            \
+    X(0x01, add,        EQ_VAL_SIGNED,      0)  \
+    X(0x02, sub,        EQ_VAL_SIGNED,      0)  \
+    X(0x03, mul,        EQ_VAL_SIGNED,      1)  \
+    X(0x04, div,        EQ_VAL_SIGNED,      1)  \
+    X(0x05, mod,        EQ_VAL_SIGNED,      1)  \
+    X(0x06, s_left,     EQ_VAL_UNSIGNED,    0)  \
+    X(0x07, s_right,    EQ_VAL_UNSIGNED,    0)  \
+    X(0x08, and,        EQ_VAL_UNSIGNED,    0)  \
+    X(0x09, or,         EQ_VAL_UNSIGNED,    0)  \
+    X(0x0a, xor,        EQ_VAL_UNSIGNED,    0)  \
+    X(0x0b, r_left,     EQ_VAL_UNSIGNED,    0)  \
+    X(0x0c, r_right,    EQ_VAL_UNSIGNED,    0)
+
+#define OPERATOR_MIN 0x01
+#define OPERATOR_MAX 0x0c
+
+// Instruction set used by the kernels of solve_columns. The default comes
+// from get_isa_level
+typedef enum solve_variant_t
+{
+    SOLVE_VARIANT_SCALAR = ISA_SCALAR,
+    SOLVE_VARIANT_AVX2 = ISA_AVX2,
+    SOLVE_VARIANT_AVX512 = ISA_AVX512
+} solve_variant_t;
+
+// Reason an equation failed. The message for each is kept in a static table
+// and fetched with get_status_message
+typedef enum eq_status_t
+{
+    EQ_STATUS_OK = 0,               // Equation did not fail
+    EQ_STATUS_OVERFLOW,             // Result is above the range of the type
+    EQ_STATUS_UNDERFLOW,            // Result is below the range of the type
+    EQ_STATUS_DIV_BY_ZERO,          // Right operand of a division is zero
+    EQ_STATUS_UNKNOWN_OPERATOR      // Operator byte code is not supported
+} eq_status_t;
+
 // Structure contains the data needed to resolve the equation
 typedef struct solution_t
 {
     uint32_t eq_id;         // Equation ID provided by the spec
-    char * error_msg;       // Message indicating the error
+    eq_status_t status;     // Reason the operation failed
     uint64_t l_operand;     // Left operand
     uint64_t r_operand;     // Right operand
     uint64_t solution;    // Eval result
@@ -34,11 +77,48 @@ typedef struct solution_t
     uint8_t opt;            // Operator byte code
 } solution_t;
 
+// Scratch space used to solve repeated equations once, private to the solver
+typedef struct dedupe_scratch_t dedupe_scratch_t;
+
+// Structure of arrays holding a whole file of equations. Every column holds
+// count entries and index i of each column describes the same equation so
+// that passes over a single field stream through contiguous memory. Only
+// whether an equation failed is kept, the reason it failed is only available
+// through the status of a single equation solution_t
+typedef struct equ_batch_t
+{
+    uint64_t count;         // Number of equations in each column
+    uint32_t * eq_id;       // Equation IDs provided by the spec
+    uint8_t * flags;        // Flags byte of the unsolved equation
+    uint64_t * l_operand;   // Left operands
+    uint8_t * opt;          // Operator byte codes
+    uint64_t * r_operand;   // Right operands
+    uint64_t * solution;    // Eval results
+    uint8_t * sign;         // eq_eval_type_t of each result
+    uint8_t * result;       // eq_result_t of each equation
+    dedupe_scratch_t * dedupe;  // Allocated the first time the batch has duplicates
+} equ_batch_t;
+
 solution_t * get_equation_struct(uint32_t equation_id,
                                  uint64_t l_operand,
                                  uint8_t opt,
                                  uint64_t r_operand);
 void free_equation_struct(solution_t * equation);
+uint64_t hash_equation(uint64_t l_operand, uint8_t opt, uint64_t r_operand);
+const char * get_status_message(eq_status_t status);
+equ_batch_t * get_equation_batch(uint64_t count);
+equ_batch_t * resize_equation_batch(equ_batch_t * batch, uint64_t count);
+void solve_equation_batch(equ_batch_t * batch);
+void solve_columns(const uint64_t * l_operand,
+                   const uint8_t * opt,
+                   const uint64_t * r_operand,
+                   uint64_t count,
+                   uint64_t * solution,
+                   uint8_t * sign,
+                   uint8_t * result);
+uint8_t set_solve_variant(solve_variant_t variant);
+solve_variant_t get_solve_variant(void);
+void free_equation_batch(equ_batch_t * batch);
 
 #ifdef __cplusplus
 }
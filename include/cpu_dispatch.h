@@ -0,0 +1,29 @@
+#ifndef JG_NETCALC_INCLUDE_CPU_DISPATCH_H_
+#define JG_NETCALC_INCLUDE_CPU_DISPATCH_H_
+#ifdef __cplusplus
+extern "C" {
+#endif //END __cplusplus
+#include <stdint.h>
+
+// Environment variable naming the instruction set to use instead of the
+// widest one the CPU supports. Used to A/B benchmark the kernels
+#define ISA_FORCE_ENV "NETCALC_FORCE_ISA"
+
+// Instruction sets the kernels are built for, narrowest first. Every module
+// with SIMD kernels keeps a table indexed by this level
+typedef enum isa_level_t
+{
+    ISA_SCALAR = 0,
+    ISA_AVX2,
+    ISA_AVX512,
+    ISA_COUNT
+} isa_level_t;
+
+isa_level_t get_isa_level(void);
+uint8_t isa_supported(isa_level_t isa_level);
+const char * get_isa_name(isa_level_t isa_level);
+
+#ifdef __cplusplus
+}
+#endif //END __cplusplus
+#endif //JG_NETCALC_INCLUDE_CPU_DISPATCH_H_
@@ -0,0 +1,50 @@
+#ifndef JG_NETCALC_INCLUDE_EQU_MAP_H_
+#define JG_NETCALC_INCLUDE_EQU_MAP_H_
+#ifdef __cplusplus
+extern "C" {
+#endif //END __cplusplus
+#include <stdint.h>
+#include <stddef.h>
+#include <calculation.h>
+
+// Byte exact views of the structures of an EQU file. They are packed so they
+// can be laid directly over the mapped file without copying anything
+typedef struct __attribute__((packed)) equ_header_view_t
+{
+    uint32_t magic;
+    uint64_t file_id;
+    uint64_t number_of_eq;
+    uint8_t flags;
+    uint32_t offset;
+    uint16_t num_of_opts;
+} equ_header_view_t;
+
+typedef struct __attribute__((packed)) unsolved_view_t
+{
+    uint32_t eq_id;
+    uint8_t flags;
+    uint64_t l_operand;
+    uint8_t opt;
+    uint64_t r_operand;
+    uint8_t padding[10];
+} unsolved_view_t;
+
+// Read only mapping of an unsolved EQU file. The header and records point
+// into the mapping so they are only valid until the map is closed
+typedef struct equ_map_t
+{
+    const uint8_t * map;
+    size_t map_size;
+    const equ_header_view_t * header;
+    const unsolved_view_t * records;    // First record found at header->offset
+} equ_map_t;
+
+equ_map_t * equ_map_open(int fd);
+void equ_map_load_batch(equ_map_t * map, uint64_t first, uint64_t count, equ_batch_t * batch);
+void equ_map_release(equ_map_t * map, uint64_t consumed);
+void equ_map_close(equ_map_t ** map);
+
+#ifdef __cplusplus
+}
+#endif //END __cplusplus
+#endif //JG_NETCALC_INCLUDE_EQU_MAP_H_
@@ -0,0 +1,46 @@
+#ifndef JG_NETCALC_INCLUDE_EQU_PARSER_H_
+#define JG_NETCALC_INCLUDE_EQU_PARSER_H_
+#ifdef __cplusplus
+extern "C" {
+#endif //END __cplusplus
+#include <stdint.h>
+#include <stddef.h>
+#include <header_parser.h>
+
+typedef enum
+{
+    EP_NEED_MORE,       // Every byte fed was consumed and more are required
+    EP_COMPLETE,        // The whole upload has been parsed
+    EP_ERROR            // The upload is malformed, no more bytes are accepted
+} equ_parser_status_t;
+
+// Sections of a NetCalc upload in the order they arrive on the wire
+typedef enum
+{
+    EP_STATE_NET_HEADER,
+    EP_STATE_FILE_HEADER,
+    EP_STATE_OPT_HEADERS,
+    EP_STATE_RECORDS,
+    EP_STATE_DONE,
+    EP_STATE_ERROR
+} equ_parser_state_t;
+
+// Resumable parser for a single upload. Bytes are pushed in as they arrive
+// instead of the parser pulling from a blocking fd, so one thread can drive
+// any number of partially received uploads
+typedef struct equ_parser_t equ_parser_t;
+
+equ_parser_t * equ_parser_init(void);
+equ_parser_status_t equ_parser_feed(equ_parser_t * parser,
+                                    const uint8_t * data,
+                                    size_t data_size,
+                                    size_t * consumed);
+equ_parser_state_t equ_parser_state(equ_parser_t * parser);
+net_header_t * equ_parser_take_header(equ_parser_t * parser);
+equations_t * equ_parser_take_equations(equ_parser_t * parser);
+void equ_parser_destroy(equ_parser_t ** parser);
+
+#ifdef __cplusplus
+}
+#endif //END __cplusplus
+#endif //JG_NETCALC_INCLUDE_EQU_PARSER_H_
@@ -4,13 +4,19 @@
 extern "C" {
 #endif //END __cplusplus
 #include <stdint.h>
+#include <stddef.h>
 #include <calculation.h>
+#include <stream_reader.h>
 
 #define MAGIC_VALUE     0xDD77BB55
 #define UNSOLVED_VAL    0x00
 #define SOLVED_VAL      0x01
 #define SIGNED_OUTPUT   0x01
 #define UNSIGNED_OUTPUT 0x02
+#define EQU_HEADER_SIZE 27      // Sum of the EQU_FILE_HEADER_BYTES fields
+#define UNSOLVED_EQU_SIZE 32    // Sum of the UNSOLVED_EQU_FORMAT_BYTES fields
+#define SOLVED_EQU_SIZE 14      // Sum of the SOLVED_EQU_FORMAT_BYTES fields
+#define BATCH_START_SIZE 4096   // Equations a batch holds before it grows to fit the records received
 
 typedef enum {
     NET_HEADER_SIZE         = 4,
@@ -44,9 +50,9 @@ typedef enum
 typedef enum
 {
     SO_EQU_ID       = 4,
-//    SO_FLAGS        = 1,
-//    SO_TYPE         = 1,
-//    SO_SOLUTION     = 8
+    SO_EQU_FLAGS    = 1,
+    SO_EQU_TYPE     = 1,
+    SO_EQU_SOLUTION = 8
 } SOLVED_EQU_FORMAT_BYTES;
 
 
@@ -58,17 +64,14 @@ typedef enum
 } SERIALIZED_EQU_FORMAT;
 
 
-typedef struct unsolved_eq_t unsolved_eq_t;
-typedef struct unsolved_eq_t
+// Instruction set used to decode runs of unsolved records. The default comes
+// from get_isa_level
+typedef enum
 {
-    uint32_t eq_id;
-    uint8_t flags;
-    uint64_t l_operand;
-    uint8_t opt;
-    uint64_t r_operand;
-    unsolved_eq_t * next;
-    solution_t * solution;
-} unsolved_eq_t;
+    DECODE_VARIANT_SCALAR = ISA_SCALAR,
+    DECODE_VARIANT_AVX2 = ISA_AVX2,
+    DECODE_VARIANT_AVX512 = ISA_AVX512
+} decode_variant_t;
 
 typedef struct equations_t
 {
@@ -78,8 +81,7 @@ typedef struct equations_t
     uint8_t flags;
     uint32_t offset;
     uint16_t num_of_opts;
-    unsolved_eq_t * eqs;
-    unsolved_eq_t * tail;
+    equ_batch_t * batch;
 } equations_t;
 
 typedef struct net_header_t
@@ -91,8 +93,22 @@ typedef struct net_header_t
 } net_header_t;
 
 
-equations_t * parse_stream(int fd);
-net_header_t * read_header(int fd);
+equations_t * parse_stream(stream_reader_t * reader);
+equations_t * parse_file_header(stream_reader_t * reader);
+int8_t parse_records(stream_reader_t * reader, equ_batch_t * batch, uint64_t index, uint64_t count);
+int8_t grow_equation_batch(equations_t * eqs);
+net_header_t * read_header(stream_reader_t * reader);
+void decode_net_header(const uint8_t * buffer, net_header_t * header);
+void decode_file_header(const uint8_t * buffer, equations_t * eqs);
+void decode_unsolved(const uint8_t * buffer, equ_batch_t * batch, uint64_t index);
+uint64_t decode_unsolved_run(const uint8_t * records, uint64_t count, equ_batch_t * batch, uint64_t index);
+uint8_t set_decode_variant(decode_variant_t variant);
+decode_variant_t get_decode_variant(void);
+int8_t validate_file_header(equations_t * eqs);
+uint64_t get_solved_size(equations_t * eqs);
+size_t serialize_file_header(equations_t * eqs, uint8_t * buffer, size_t buffer_size);
+void encode_file_header(equations_t * eqs, uint8_t * buffer);
+size_t serialize_solutions(equ_batch_t * batch, uint8_t * buffer, size_t buffer_size);
 void free_equation(equations_t * eq);
 void free_header(net_header_t * header);
 uint64_t swap_byte_order(uint64_t val);
@@ -0,0 +1,40 @@
+#ifndef JG_NETCALC_INCLUDE_RESULT_CACHE_H_
+#define JG_NETCALC_INCLUDE_RESULT_CACHE_H_
+#ifdef __cplusplus
+extern "C" {
+#endif //END __cplusplus
+#include <stdint.h>
+
+// Counters of the result cache. Inserts and evictions are summed over the
+// shards when fetched, hits and misses are what result_cache_record added
+typedef struct result_cache_stats_t
+{
+    uint64_t capacity;      // Number of results the cache holds
+    uint64_t hits;          // Lookups that found the equation
+    uint64_t misses;        // Lookups that did not find the equation
+    uint64_t inserts;       // Results stored
+    uint64_t evictions;     // Results replaced to make room for another
+} result_cache_stats_t;
+
+int8_t result_cache_init(uint64_t capacity);
+void result_cache_destroy(void);
+uint8_t result_cache_enabled(void);
+uint8_t result_cache_lookup(uint64_t l_operand,
+                            uint8_t opt,
+                            uint64_t r_operand,
+                            uint64_t * solution,
+                            uint8_t * sign,
+                            uint8_t * result);
+void result_cache_store(uint64_t l_operand,
+                        uint8_t opt,
+                        uint64_t r_operand,
+                        uint64_t solution,
+                        uint8_t sign,
+                        uint8_t result);
+void result_cache_record(uint64_t hits, uint64_t misses);
+void result_cache_stats(result_cache_stats_t * stats);
+
+#ifdef __cplusplus
+}
+#endif //END __cplusplus
+#endif //JG_NETCALC_INCLUDE_RESULT_CACHE_H_
@@ -12,10 +12,14 @@ typedef enum
     MIN_THREADS = 1,
     MIN_PORT    = 1024,       // Ports 1024+ are user defined ports
     MAX_PORT    = 0xFFFF,
-    BACK_LOG    = 1024
+    BACK_LOG    = 1024,
+    MIN_WINDOW  = 1,
+    MAX_WINDOW  = 1048576,    // Records held per window while streaming a file
+    MIN_CACHE   = 1,
+    MAX_CACHE   = 16777216    // Results held by the result cache
 } server_defaults_t;
 
-void start_server(uint8_t thread_count, uint32_t port_num);
+void start_server(uint8_t thread_count, uint32_t port_num, uint32_t window_size, uint32_t cache_size);
 
 #ifdef __cplusplus
 }
@@ -0,0 +1,29 @@
+#ifndef JG_NETCALC_INCLUDE_STREAM_READER_H_
+#define JG_NETCALC_INCLUDE_STREAM_READER_H_
+#ifdef __cplusplus
+extern "C" {
+#endif //END __cplusplus
+#include <stdint.h>
+#include <stddef.h>
+
+typedef enum
+{
+    SR_DEFAULT_CAPACITY = 65536     // Bytes pulled from the fd per read(2)
+} stream_reader_defaults_t;
+
+// The reader is owned by a single connection and buffers the bytes read from
+// its file descriptor so that the fixed width fields of the headers and the
+// equations can be handed out without a syscall per field
+typedef struct stream_reader_t stream_reader_t;
+
+stream_reader_t * stream_reader_init(int fd, size_t capacity);
+int8_t stream_reader_read(stream_reader_t * reader, void * caller_buffer, size_t bytes_to_read);
+int8_t stream_reader_skip(stream_reader_t * reader, size_t bytes_to_skip);
+const uint8_t * stream_reader_peek(stream_reader_t * reader, size_t * available);
+void stream_reader_consume(stream_reader_t * reader, size_t bytes_consumed);
+void stream_reader_destroy(stream_reader_t ** reader);
+
+#ifdef __cplusplus
+}
+#endif //END __cplusplus
+#endif //JG_NETCALC_INCLUDE_STREAM_READER_H_
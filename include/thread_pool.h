@@ -6,8 +6,16 @@ extern "C" {
 #endif //END __cplusplus
 #include <utils.h>
 #include <stdint.h>
+#include <stddef.h>
 #include <threads.h>
 
+// Number of jobs the work queue holds, must be a power of two. Enqueueing
+// into a full queue fails instead of blocking the producer.
+#define THPOOL_QUEUE_SIZE 4096
+
+// Largest argument thpool_enqueue_inline copies into the job itself
+#define THPOOL_INLINE_ARG_SIZE 16
+
 typedef enum
 {
     THP_SUCCESS,
@@ -18,6 +26,14 @@ typedef struct thpool_t thpool_t;
 thpool_t * thpool_init(uint8_t thread_count);
 void thpool_wait(thpool_t * thpool);
 thpool_status thpool_enqueue_job(thpool_t * thpool, void (* job_function)(void *), void * job_arg);
+thpool_status thpool_enqueue_inline(thpool_t * thpool,
+                                    void (* job_function)(void *),
+                                    const void * job_arg,
+                                    size_t arg_size);
+thpool_status thpool_enqueue_batch(thpool_t * thpool,
+                                   void (* job_function)(void *),
+                                   void ** job_args,
+                                   size_t count);
 void thpool_destroy(thpool_t ** thpool);
 
 
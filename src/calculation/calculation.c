@@ -1,27 +1,87 @@
 #include <calculation.h>
 #include <stdlib.h>
-#include <string.h>
 #include <stdio.h>
+#include <stdbool.h>
+#include <string.h>
+
+
 
+// Solves one equation. Returns EQ_STATUS_OK and writes the solution or
+// returns the reason the equation failed
+typedef eq_status_t (* operation_t)(uint64_t l_operand, uint64_t r_operand, uint64_t * solution);
 
+// Semantics of one operator byte code
+typedef struct operator_t
+{
+    operation_t operation;  // Solves the equation, NULL for unknown codes
+    eq_eval_type_t sign;    // Sign type of a solved result
+} operator_t;
+
+#define OPERATION_DECLARATION(code, name, sign, cached) \
+    static eq_status_t name##_operation(uint64_t l_operand, uint64_t r_operand, uint64_t * solution);
+OPERATORS(OPERATION_DECLARATION)
+#undef OPERATION_DECLARATION
 
 static void resolve_equation(solution_t * eq);
-static void add_callback(solution_t * eq);
-static void sub_callback(solution_t * eq);
-static void mul_callback(solution_t * eq);
-static void div_callback(solution_t * eq);
-static void mod_callback(solution_t * eq);
-static void s_left_callback(solution_t * eq);
-static void s_right_callback(solution_t * eq);
-static void and_callback(solution_t * eq);
-static void or_callback(solution_t * eq);
-static void xor_callback(solution_t * eq);
-static void r_left_callback(solution_t * eq);
-static void r_right_callback(solution_t * eq);
-
-static void unknown_callback(solution_t * eq);
+static uint8_t * next_column(uint8_t ** cursor, size_t size);
+DEBUG_STATIC uint16_t sample_duplicates(const uint64_t * l_operand,
+                                        const uint8_t * opt,
+                                        const uint64_t * r_operand,
+                                        uint16_t count);
+DEBUG_STATIC void solve_deduplicated(dedupe_scratch_t * scratch,
+                                     const uint64_t * l_operand,
+                                     const uint8_t * opt,
+                                     const uint64_t * r_operand,
+                                     uint16_t count,
+                                     uint64_t * solution,
+                                     uint8_t * sign,
+                                     uint8_t * result);
+
+// Each operator code sets its own bit. With as many operators as codes in
+// the range, the bits only add up to the whole range if no code is repeated
+#define OPERATOR_ONE(code, name, sign, cached) + 1
+#define OPERATOR_BIT(code, name, sign, cached) + ((uint32_t)1 << (code))
+#define OPERATOR_RANGE_BITS ((((uint32_t)1 << (OPERATOR_MAX + 1)) - 1) & ~(((uint32_t)1 << OPERATOR_MIN) - 1))
+_Static_assert((0 OPERATORS(OPERATOR_ONE)) == (OPERATOR_MAX - OPERATOR_MIN + 1),
+               "OPERATORS lists one entry per code from OPERATOR_MIN to OPERATOR_MAX");
+_Static_assert((0 OPERATORS(OPERATOR_BIT)) == OPERATOR_RANGE_BITS,
+               "OPERATORS covers every code from OPERATOR_MIN to OPERATOR_MAX once");
+#undef OPERATOR_ONE
+#undef OPERATOR_BIT
+#undef OPERATOR_RANGE_BITS
+
+// Indexed by any operator byte code so looking one up needs no range check
+#define OPERATOR_ENTRY(code, name, sign, cached) [code] = {name##_operation, sign},
+static const operator_t operators[UINT8_MAX + 1] = {
+    OPERATORS(OPERATOR_ENTRY)
+};
+#undef OPERATOR_ENTRY
 
 #define MAX_BITS 64
+#define BATCH_ALIGN 64              // Cache line every batch column starts on
+#define BATCH_COLUMNS 8             // Columns carved out of a batch allocation
+#define DEDUPE_WINDOW 16384         // Equations deduplicated together
+#define DEDUPE_SLOTS (DEDUPE_WINDOW * 2)
+#define DEDUPE_MIN_COUNT 4096       // Smallest window sampled for duplicates
+#define DEDUPE_CHUNKS 8             // Evenly spaced runs of equations sampled
+#define DEDUPE_CHUNK 128            // Equations in each sampled run
+#define DEDUPE_SAMPLE (DEDUPE_CHUNKS * DEDUPE_CHUNK)
+#define DEDUPE_SAMPLE_SLOTS (DEDUPE_SAMPLE * 2)
+#define DEDUPE_MIN_PERCENT 95       // Sampled duplicates needed to deduplicate
+
+// Scratch space of the duplicate pass over one window. Slots and indexes
+// are stored + 1 so that zero marks an empty slot
+struct dedupe_scratch_t
+{
+    uint64_t l_operand[DEDUPE_WINDOW];      // Distinct equations
+    uint64_t r_operand[DEDUPE_WINDOW];
+    uint64_t solution[DEDUPE_WINDOW];
+    uint16_t slots[DEDUPE_SLOTS];           // Open addressing table of distinct indexes
+    uint16_t distinct_of[DEDUPE_WINDOW];    // Distinct index of every equation
+    uint8_t opt[DEDUPE_WINDOW];
+    uint8_t sign[DEDUPE_WINDOW];
+    uint8_t result[DEDUPE_WINDOW];
+};
 
 /*!
  * @brief Allocate memory for an equation object and return it containing the
@@ -45,7 +105,7 @@ solution_t * get_equation_struct(uint32_t equation_id,
 
     *equation = (solution_t) {
         .eq_id      = equation_id,
-        .error_msg  = NULL,
+        .status     = EQ_STATUS_OK,
         .l_operand  = l_operand,
         .r_operand  = r_operand,
         .solution = 0,
@@ -64,265 +124,465 @@ solution_t * get_equation_struct(uint32_t equation_id,
  */
 void free_equation_struct(solution_t * equation)
 {
-    if (NULL != equation->error_msg)
-    {
-        free(equation->error_msg);
-    }
     free(equation);
 }
 
-static void resolve_equation(solution_t * eq)
+/*!
+ * @brief Fetch the message describing a status. The messages are static so
+ * nothing is allocated when an equation fails and the message is only looked
+ * up by callers that want to display it.
+ * @param status Status of an equation
+ * @return Message for the status. The string must not be freed
+ */
+const char * get_status_message(eq_status_t status)
 {
-    switch(eq->opt)
+    static const char * const messages[] = {
+        [EQ_STATUS_OK]                  = "No error",
+        [EQ_STATUS_OVERFLOW]            = "Overflow detected for operation",
+        [EQ_STATUS_UNDERFLOW]           = "Underflow detected for operation",
+        [EQ_STATUS_DIV_BY_ZERO]         = "Division by zero error",
+        [EQ_STATUS_UNKNOWN_OPERATOR]    = "Unknown operator",
+    };
+
+    if ((size_t)status >= (sizeof(messages) / sizeof(messages[0])))
     {
-        case 0x01:
-            add_callback(eq);
-            break;
-        case 0x02:
-            sub_callback(eq);
-            break;
-        case 0x03:
-            mul_callback(eq);
-            break;
-        case 0x04:
-            div_callback(eq);
-            break;
-        case 0x05:
-            mod_callback(eq);
-            break;
-        case 0x06:
-            s_left_callback(eq);
-            break;
-        case 0x07:
-            s_right_callback(eq);
-            break;
-        case 0x08:
-            and_callback(eq);
-            break;
-        case 0x09:
-            or_callback(eq);
-            break;
-        case 0x0a:
-            xor_callback(eq);
-            break;
-        case 0x0b:
-            r_left_callback(eq);
-            break;
-        case 0x0c:
-            r_right_callback(eq);
-            break;
-        default:
-            unknown_callback(eq);
-            break;
+        return "Unknown status";
     }
+    return messages[status];
 }
 
-static void add_callback(solution_t * eq)
+/*!
+ * @brief Allocate a batch of equations. The batch and all of its columns
+ * share a single allocation with every column starting on its own cache
+ * line, so a whole file costs one allocation regardless of the number of
+ * equations in it and is released with a single free.
+ * @param count Number of equations the batch holds
+ * @return Pointer to the batch object or NULL if unable to allocate memory
+ */
+equ_batch_t * get_equation_batch(uint64_t count)
 {
-    int64_t l_operand = (int64_t)eq->l_operand;
-    int64_t r_operand = (int64_t)eq->r_operand;
+    // Always allocate at least one slot so an empty file is not mistaken
+    // for an allocation failure
+    uint64_t slots = (0 == count) ? 1 : count;
+
+    // Each column is padded to a whole number of cache lines. The count
+    // comes from the file header so the size is checked before it is summed
+    size_t bytes_per_slot = (3 * sizeof(uint64_t)) + sizeof(uint32_t) + (4 * sizeof(uint8_t));
+    size_t padding = (BATCH_COLUMNS + 1) * BATCH_ALIGN;
+    if (slots > ((SIZE_MAX - sizeof(equ_batch_t) - padding) / bytes_per_slot))
+    {
+        debug_print_err("Unable to allocate a batch of %lu equations\n", count);
+        return NULL;
+    }
 
-    if ((r_operand > 0) && (l_operand > (INT64_MAX - r_operand)))
+    size_t size = sizeof(equ_batch_t) + padding + ((size_t)slots * bytes_per_slot);
+    equ_batch_t * batch = (equ_batch_t *)calloc(1, size);
+    if (UV_INVALID_ALLOC == verify_alloc(batch))
     {
-        eq->error_msg = strdup("Overflow detected for operation\n");
-        eq->result = EQ_FAILURE;
-        return;
+        return NULL;
     }
-    if ((r_operand < 0) && (l_operand < (INT64_MIN - r_operand)))
+    batch->count = count;
+
+    uint8_t * column = (uint8_t *)batch + sizeof(equ_batch_t);
+    batch->l_operand    = (uint64_t *)next_column(&column, slots * sizeof(uint64_t));
+    batch->r_operand    = (uint64_t *)next_column(&column, slots * sizeof(uint64_t));
+    batch->solution     = (uint64_t *)next_column(&column, slots * sizeof(uint64_t));
+    batch->eq_id        = (uint32_t *)next_column(&column, slots * sizeof(uint32_t));
+    batch->flags        = next_column(&column, slots * sizeof(uint8_t));
+    batch->opt          = next_column(&column, slots * sizeof(uint8_t));
+    batch->sign         = next_column(&column, slots * sizeof(uint8_t));
+    batch->result       = next_column(&column, slots * sizeof(uint8_t));
+    return batch;
+}
+
+/*!
+ * @brief Move the equations of a batch into a new batch of count equations.
+ * The first min(count, batch->count) equations of every column are copied
+ * over and the old batch is freed. Used to grow a batch as records arrive
+ * when the number of equations announced by a client can not be trusted.
+ * @param batch Pointer to the batch object
+ * @param count Number of equations the new batch holds
+ * @return Pointer to the new batch or NULL if unable to allocate memory, in
+ * which case the old batch is left untouched
+ */
+equ_batch_t * resize_equation_batch(equ_batch_t * batch, uint64_t count)
+{
+    equ_batch_t * resized = get_equation_batch(count);
+    if (NULL == resized)
     {
-        eq->error_msg = strdup("Underflow detected for operation\n");
-        eq->result = EQ_FAILURE;
-        return;
+        return NULL;
     }
 
-    eq->solution = (uint64_t)(l_operand + r_operand);
-    eq->sign = EQ_VAL_SIGNED;
-    eq->result = EQ_SOLVED;
-    return;
+    uint64_t kept = (batch->count < count) ? batch->count : count;
+    memcpy(resized->l_operand, batch->l_operand, kept * sizeof(uint64_t));
+    memcpy(resized->r_operand, batch->r_operand, kept * sizeof(uint64_t));
+    memcpy(resized->solution, batch->solution, kept * sizeof(uint64_t));
+    memcpy(resized->eq_id, batch->eq_id, kept * sizeof(uint32_t));
+    memcpy(resized->flags, batch->flags, kept * sizeof(uint8_t));
+    memcpy(resized->opt, batch->opt, kept * sizeof(uint8_t));
+    memcpy(resized->sign, batch->sign, kept * sizeof(uint8_t));
+    memcpy(resized->result, batch->result, kept * sizeof(uint8_t));
+    free_equation_batch(batch);
+    return resized;
+}
+
+/*!
+ * @brief Solve every equation in the batch, writing the result and sign type
+ * into the batch columns with the per operator kernels of solve_columns
+ * @param batch Pointer to the batch object
+ */
+void solve_equation_batch(equ_batch_t * batch)
+{
+    for (uint64_t start = 0; start < batch->count; start += DEDUPE_WINDOW)
+    {
+        uint16_t window = (uint16_t)(((batch->count - start) < DEDUPE_WINDOW) ? (batch->count - start) : DEDUPE_WINDOW);
+        const uint64_t * l_operand = batch->l_operand + start;
+        const uint8_t * opt = batch->opt + start;
+        const uint64_t * r_operand = batch->r_operand + start;
+
+        // A window with enough repeated equations solves each distinct one
+        // once. Building the table costs more than solving most equations
+        // so the pass only runs when a sample of the window is mostly
+        // duplicates
+        if ((window >= DEDUPE_MIN_COUNT)
+            && (((uint32_t)sample_duplicates(l_operand, opt, r_operand, window) * 100)
+                >= (DEDUPE_SAMPLE * DEDUPE_MIN_PERCENT)))
+        {
+            if (NULL == batch->dedupe)
+            {
+                batch->dedupe = (dedupe_scratch_t *)malloc(sizeof(dedupe_scratch_t));
+            }
+            if (UV_VALID_ALLOC == verify_alloc(batch->dedupe))
+            {
+                solve_deduplicated(batch->dedupe, l_operand, opt, r_operand, window,
+                                   batch->solution + start, batch->sign + start, batch->result + start);
+                continue;
+            }
+        }
+
+        solve_columns(l_operand, opt, r_operand, window,
+                      batch->solution + start, batch->sign + start, batch->result + start);
+    }
+}
+
+/*
+ * Hand out the next column of a batch allocation, starting on a cache line
+ * boundary, and move the cursor past it
+ */
+static uint8_t * next_column(uint8_t ** cursor, size_t size)
+{
+    uintptr_t address = ((uintptr_t)*cursor + (BATCH_ALIGN - 1)) & ~(uintptr_t)(BATCH_ALIGN - 1);
+    *cursor = (uint8_t *)address + size;
+    return (uint8_t *)address;
 }
 
-static void sub_callback(solution_t * eq)
+/*!
+ * @brief Hash the three fields of an equation into one word. Used to index
+ * the duplicate table and the result cache
+ * @param l_operand Left operand
+ * @param opt Operator byte code
+ * @param r_operand Right operand
+ * @return Hash of the equation
+ */
+uint64_t hash_equation(uint64_t l_operand, uint8_t opt, uint64_t r_operand)
 {
-    int64_t l_operand = (int64_t)eq->l_operand;
-    int64_t r_operand = (int64_t)eq->r_operand;
+    uint64_t hash = l_operand ^ ((uint64_t)opt << 56);
+    hash = (hash ^ (hash >> 33)) * 0xFF51AFD7ED558CCD;
+    hash ^= r_operand;
+    hash = (hash ^ (hash >> 33)) * 0xC4CEB9FE1A85EC53;
+    hash ^= hash >> 33;
+    return hash;
+}
 
+/*!
+ * @brief Count the repeated equations in DEDUPE_CHUNKS evenly spaced runs of
+ * a window. The runs are spread over the whole window so repeats far apart
+ * are caught as well as short ones.
+ * @param count Number of equations in the window, at least DEDUPE_SAMPLE
+ * @return Number of the DEDUPE_SAMPLE sampled equations that were already
+ * seen in the sample
+ */
+DEBUG_STATIC uint16_t sample_duplicates(const uint64_t * l_operand,
+                                        const uint8_t * opt,
+                                        const uint64_t * r_operand,
+                                        uint16_t count)
+{
+    uint16_t slots[DEDUPE_SAMPLE_SLOTS] = {0};
+    uint16_t stride = (uint16_t)(count / DEDUPE_CHUNKS);
+    uint16_t duplicates = 0;
 
-    if ((r_operand < 0) && (l_operand > (INT64_MAX + r_operand)))
+    for (uint16_t chunk = 0; chunk < DEDUPE_CHUNKS; chunk++)
     {
-        eq->error_msg = strdup("Overflow detected for operation\n");
-        eq->result = EQ_FAILURE;
-        return;
+        uint16_t first = (uint16_t)(chunk * stride);
+        for (uint16_t i = first; i < (first + DEDUPE_CHUNK); i++)
+        {
+            uint64_t slot = hash_equation(l_operand[i], opt[i], r_operand[i]) & (DEDUPE_SAMPLE_SLOTS - 1);
+            while (0 != slots[slot])
+            {
+                uint16_t seen = (uint16_t)(slots[slot] - 1);
+                if ((l_operand[seen] == l_operand[i]) && (r_operand[seen] == r_operand[i]) && (opt[seen] == opt[i]))
+                {
+                    duplicates++;
+                    break;
+                }
+                slot = (slot + 1) & (DEDUPE_SAMPLE_SLOTS - 1);
+            }
+            if (0 == slots[slot])
+            {
+                slots[slot] = (uint16_t)(i + 1);
+            }
+        }
     }
-    if ((r_operand > 0) && (l_operand < (INT64_MIN + r_operand)))
+    return duplicates;
+}
+
+/*!
+ * @brief Solve each distinct equation of a window once and copy its result
+ * to every equation that repeats it. The distinct equations are gathered
+ * into the scratch columns through an open addressing table and solved with
+ * solve_columns.
+ * @param scratch Scratch space of the batch
+ * @param count Number of equations in the window, at most DEDUPE_WINDOW
+ */
+DEBUG_STATIC void solve_deduplicated(dedupe_scratch_t * scratch,
+                                     const uint64_t * l_operand,
+                                     const uint8_t * opt,
+                                     const uint64_t * r_operand,
+                                     uint16_t count,
+                                     uint64_t * solution,
+                                     uint8_t * sign,
+                                     uint8_t * result)
+{
+    memset(scratch->slots, 0, sizeof(scratch->slots));
+
+    uint16_t distinct_count = 0;
+    for (uint16_t i = 0; i < count; i++)
     {
-        eq->error_msg = strdup("Underflow detected for operation\n");
-        eq->result = EQ_FAILURE;
-        return;
+        uint64_t slot = hash_equation(l_operand[i], opt[i], r_operand[i]) & (DEDUPE_SLOTS - 1);
+        while (true)
+        {
+            uint16_t index = scratch->slots[slot];
+            if (0 == index)
+            {
+                scratch->l_operand[distinct_count] = l_operand[i];
+                scratch->opt[distinct_count] = opt[i];
+                scratch->r_operand[distinct_count] = r_operand[i];
+                scratch->distinct_of[i] = distinct_count++;
+                scratch->slots[slot] = distinct_count;
+                break;
+            }
+            index--;
+            if ((scratch->l_operand[index] == l_operand[i])
+                && (scratch->r_operand[index] == r_operand[i])
+                && (scratch->opt[index] == opt[i]))
+            {
+                scratch->distinct_of[i] = index;
+                break;
+            }
+            slot = (slot + 1) & (DEDUPE_SLOTS - 1);
+        }
     }
 
-    eq->solution = (uint64_t)(l_operand - r_operand);
-    eq->sign = EQ_VAL_SIGNED;
-    eq->result = EQ_SOLVED;
-    return;
+    solve_columns(scratch->l_operand, scratch->opt, scratch->r_operand, distinct_count,
+                  scratch->solution, scratch->sign, scratch->result);
+    for (uint16_t i = 0; i < count; i++)
+    {
+        uint16_t index = scratch->distinct_of[i];
+        solution[i] = scratch->solution[index];
+        sign[i] = scratch->sign[index];
+        result[i] = scratch->result[index];
+    }
 }
 
-static void mul_callback(solution_t * eq)
+/*!
+ * @brief Free the batch. The columns live in the same allocation
+ * @param batch Pointer to the batch object
+ */
+void free_equation_batch(equ_batch_t * batch)
 {
-    int64_t l_operand = (int64_t)eq->l_operand;
-    int64_t r_operand = (int64_t)eq->r_operand;
-
-    if ((-1 == l_operand) && (INT64_MIN == r_operand))
+    if (NULL == batch)
     {
-        eq->error_msg = strdup("Overflow detected for operation\n");
-        eq->result = EQ_FAILURE;
         return;
     }
-    if ((-1 == r_operand) && (INT64_MIN == l_operand))
+    free(batch->dedupe);
+    free(batch);
+}
+
+/*!
+ * @brief Solve the equation with the operation of its operator code. A
+ * solved equation takes the sign type of its operator. A failed equation
+ * keeps a zero solution and the unsigned sign type.
+ * @param eq Pointer to the equation object
+ */
+static void resolve_equation(solution_t * eq)
+{
+    const operator_t * op = &operators[eq->opt];
+    if (NULL == op->operation)
     {
-        eq->error_msg = strdup("Overflow detected for operation\n");
+        eq->status = EQ_STATUS_UNKNOWN_OPERATOR;
         eq->result = EQ_FAILURE;
         return;
     }
-    if ((0 != r_operand) && (l_operand > (INT64_MAX / r_operand)))
+
+    uint64_t solution = 0;
+    eq_status_t status = op->operation(eq->l_operand, eq->r_operand, &solution);
+    if (EQ_STATUS_OK != status)
     {
-        eq->error_msg = strdup("Overflow detected for operation\n");
+        eq->status = status;
         eq->result = EQ_FAILURE;
         return;
     }
-    if ((0 != r_operand) && (l_operand < (INT64_MIN / r_operand)))
+
+    eq->solution = solution;
+    eq->sign = op->sign;
+    eq->result = EQ_SOLVED;
+}
+
+static eq_status_t add_operation(uint64_t l_operand, uint64_t r_operand, uint64_t * solution)
+{
+    int64_t left = (int64_t)l_operand;
+    int64_t right = (int64_t)r_operand;
+
+    if ((right > 0) && (left > (INT64_MAX - right)))
+    {
+        return EQ_STATUS_OVERFLOW;
+    }
+    if ((right < 0) && (left < (INT64_MIN - right)))
     {
-        eq->error_msg = strdup("Underflow detected for operation\n");
-        eq->result = EQ_FAILURE;
-        return;
+        return EQ_STATUS_UNDERFLOW;
     }
 
-    eq->solution = (uint64_t)(l_operand * r_operand);
-    eq->sign = EQ_VAL_SIGNED;
-    eq->result = EQ_SOLVED;
-    return;
+    *solution = (uint64_t)(left + right);
+    return EQ_STATUS_OK;
 }
 
-static void div_callback(solution_t * eq)
+static eq_status_t sub_operation(uint64_t l_operand, uint64_t r_operand, uint64_t * solution)
 {
-    int64_t l_operand = (int64_t)eq->l_operand;
-    int64_t r_operand = (int64_t)eq->r_operand;
+    int64_t left = (int64_t)l_operand;
+    int64_t right = (int64_t)r_operand;
 
-    if (0 == r_operand)
+    if ((right < 0) && (left > (INT64_MAX + right)))
     {
-        eq->error_msg = strdup("Division by zero error\n");
-        eq->result = EQ_FAILURE;
-        return;
+        return EQ_STATUS_OVERFLOW;
+    }
+    if ((right > 0) && (left < (INT64_MIN + right)))
+    {
+        return EQ_STATUS_UNDERFLOW;
     }
 
-    if ((INT64_MIN == l_operand) && (-1 == r_operand))
+    *solution = (uint64_t)(left - right);
+    return EQ_STATUS_OK;
+}
+
+static eq_status_t mul_operation(uint64_t l_operand, uint64_t r_operand, uint64_t * solution)
+{
+    int64_t left = (int64_t)l_operand;
+    int64_t right = (int64_t)r_operand;
+    int64_t product = 0;
+
+    // A negative right operand is never solved. The status is the one the
+    // checks against INT64_MAX / right and INT64_MIN / right gave, without
+    // dividing INT64_MIN by -1
+    if (right < 0)
     {
-        eq->error_msg = strdup("Overflow detected for operation\n");
-        eq->result = EQ_FAILURE;
-        return;
+        if ((-1 == right) || ((-1 == left) && (INT64_MIN == right)) || (left > (INT64_MAX / right)))
+        {
+            return EQ_STATUS_OVERFLOW;
+        }
+        return EQ_STATUS_UNDERFLOW;
     }
 
-    if ((INT64_MIN == r_operand) && (-1 == l_operand))
+    // The product is computed at full width and reports if it had to be
+    // truncated. With a right operand that is not negative it went past the
+    // end the sign of the left operand points to
+    if (__builtin_mul_overflow(left, right, &product))
     {
-        eq->error_msg = strdup("Overflow detected for operation\n");
-        eq->result = EQ_FAILURE;
-        return;
+        return (left < 0) ? EQ_STATUS_UNDERFLOW : EQ_STATUS_OVERFLOW;
     }
 
-    eq->solution = (uint64_t)(l_operand / r_operand);
-    eq->sign = EQ_VAL_SIGNED;
-    eq->result = EQ_SOLVED;
-    return;
+    *solution = (uint64_t)product;
+    return EQ_STATUS_OK;
 }
 
-static void mod_callback(solution_t * eq)
+static eq_status_t div_operation(uint64_t l_operand, uint64_t r_operand, uint64_t * solution)
 {
-    int64_t l_operand = (int64_t)eq->l_operand;
-    int64_t r_operand = (int64_t)eq->r_operand;
+    int64_t left = (int64_t)l_operand;
+    int64_t right = (int64_t)r_operand;
 
-    if (0 == r_operand)
+    if (0 == right)
     {
-        eq->error_msg = strdup("Division by zero error\n");
-        eq->result = EQ_FAILURE;
-        return;
+        return EQ_STATUS_DIV_BY_ZERO;
     }
-
-    if ((INT64_MIN == l_operand) && (-1 == r_operand))
+    if (((INT64_MIN == left) && (-1 == right)) || ((INT64_MIN == right) && (-1 == left)))
     {
-        eq->error_msg = strdup("Overflow detected for operation\n");
-        eq->result = EQ_FAILURE;
-        return;
+        return EQ_STATUS_OVERFLOW;
     }
 
-    if ((INT64_MIN == r_operand) && (-1 == l_operand))
+    *solution = (uint64_t)(left / right);
+    return EQ_STATUS_OK;
+}
+
+static eq_status_t mod_operation(uint64_t l_operand, uint64_t r_operand, uint64_t * solution)
+{
+    int64_t left = (int64_t)l_operand;
+    int64_t right = (int64_t)r_operand;
+
+    if (0 == right)
     {
-        eq->error_msg = strdup("Overflow detected for operation\n");
-        eq->result = EQ_FAILURE;
-        return;
+        return EQ_STATUS_DIV_BY_ZERO;
+    }
+    if (((INT64_MIN == left) && (-1 == right)) || ((INT64_MIN == right) && (-1 == left)))
+    {
+        return EQ_STATUS_OVERFLOW;
     }
 
-    eq->solution = (uint64_t)(l_operand % r_operand);
-    eq->sign = EQ_VAL_SIGNED;
-    eq->result = EQ_SOLVED;
-    return;
+    *solution = (uint64_t)(left % right);
+    return EQ_STATUS_OK;
 }
 
-static void s_left_callback(solution_t * eq)
+static eq_status_t s_left_operation(uint64_t l_operand, uint64_t r_operand, uint64_t * solution)
 {
-    uint64_t l_operand = eq->l_operand;
-    uint64_t r_operand = eq->r_operand;
-
     // If r_operand is higher than max bits, then molus it to "rotate" around
     if (r_operand > (MAX_BITS - 1))
     {
         r_operand = r_operand % MAX_BITS;
     }
-    eq->solution = l_operand << r_operand;
-    eq->result = EQ_SOLVED;
-    return;
+    *solution = l_operand << r_operand;
+    return EQ_STATUS_OK;
 }
 
-static void s_right_callback(solution_t * eq)
+static eq_status_t s_right_operation(uint64_t l_operand, uint64_t r_operand, uint64_t * solution)
 {
-    uint64_t l_operand = eq->l_operand;
-    uint64_t r_operand = eq->r_operand;
-
     // If r_operand is higher than max_bits, then set it to max bits which
     // will wipe the value to 0
     if (r_operand > (MAX_BITS - 1))
     {
         r_operand = MAX_BITS - 1;
     }
-    eq->solution = l_operand >> r_operand;
-    eq->result = EQ_SOLVED;
-    return;
+    *solution = l_operand >> r_operand;
+    return EQ_STATUS_OK;
 }
 
-static void and_callback(solution_t * eq)
+static eq_status_t and_operation(uint64_t l_operand, uint64_t r_operand, uint64_t * solution)
 {
-    eq->solution = eq->l_operand & eq->r_operand;
-    eq->result = EQ_SOLVED;
-    return;
+    *solution = l_operand & r_operand;
+    return EQ_STATUS_OK;
 }
 
-static void or_callback(solution_t * eq)
+static eq_status_t or_operation(uint64_t l_operand, uint64_t r_operand, uint64_t * solution)
 {
-    eq->solution = eq->l_operand | eq->r_operand;
-    eq->result = EQ_SOLVED;
-    return;
+    *solution = l_operand | r_operand;
+    return EQ_STATUS_OK;
 }
 
-static void xor_callback(solution_t * eq)
+static eq_status_t xor_operation(uint64_t l_operand, uint64_t r_operand, uint64_t * solution)
 {
-    eq->solution = eq->l_operand ^ eq->r_operand;
-    eq->result = EQ_SOLVED;
-    return;
+    *solution = l_operand ^ r_operand;
+    return EQ_STATUS_OK;
 }
 
-static void r_left_callback(solution_t * eq)
+static eq_status_t r_left_operation(uint64_t l_operand, uint64_t r_operand, uint64_t * solution)
 {
-    uint64_t l_operand = eq->l_operand;
-    uint64_t r_operand = eq->r_operand;
-
     if (r_operand > (MAX_BITS - 1))
     {
         r_operand = r_operand % MAX_BITS;
@@ -330,22 +590,17 @@ static void r_left_callback(solution_t * eq)
 
     if (0 != r_operand)
     {
-        eq->solution = ((l_operand << r_operand) | (l_operand >> (MAX_BITS - r_operand)));
+        *solution = ((l_operand << r_operand) | (l_operand >> (MAX_BITS - r_operand)));
     }
     else
     {
-        eq->solution = l_operand;
+        *solution = l_operand;
     }
-
-    eq->result = EQ_SOLVED;
-    return;
+    return EQ_STATUS_OK;
 }
 
-static void r_right_callback(solution_t * eq)
+static eq_status_t r_right_operation(uint64_t l_operand, uint64_t r_operand, uint64_t * solution)
 {
-    uint64_t l_operand = eq->l_operand;
-    uint64_t r_operand = eq->r_operand;
-
     if (r_operand > (MAX_BITS - 1))
     {
         r_operand = r_operand % MAX_BITS;
@@ -353,22 +608,11 @@ static void r_right_callback(solution_t * eq)
 
     if (0 != r_operand)
     {
-        eq->solution = ((l_operand >> r_operand) | (l_operand << (MAX_BITS - r_operand)));
+        *solution = ((l_operand >> r_operand) | (l_operand << (MAX_BITS - r_operand)));
     }
     else
     {
-        eq->solution = l_operand;
+        *solution = l_operand;
     }
-    eq->result = EQ_SOLVED;
-    return;
-}
-
-
-static void unknown_callback(solution_t * eq)
-{
-    char error[30];
-    snprintf(error, 30, "Unknown operand %#02x\n", eq->opt);
-    eq->error_msg = strdup(error);
-    eq->result = EQ_FAILURE;
-    return;
+    return EQ_STATUS_OK;
 }
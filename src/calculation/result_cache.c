@@ -0,0 +1,316 @@
+#include <result_cache.h>
+#include <calculation.h>
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <string.h>
+#include <threads.h>
+#include <utils.h>
+
+/*
+ * Results are cached by the 17 byte serialized equation, l_operand, operator
+ * and r_operand, the same fields as SERIALIZED_EQU_FORMAT. The cache is a
+ * fixed number of sets of CACHE_WAYS entries. An equation hashes to one set
+ * and is only ever stored in one of its ways, a full set evicts with the
+ * CLOCK algorithm: a hit sets the reference bit of its way and the hand of
+ * the set skips and clears referenced ways until it finds one that is not.
+ *
+ * Lookups take no lock. Every entry carries a sequence number that a writer
+ * makes odd while it rewrites the entry, so a reader that saw the sequence
+ * change or saw it odd treats the entry as a miss. Writers are serialized by
+ * the lock of the shard the set belongs to. Lookups write nothing shared
+ * unless a hit has to set a reference bit, so hits and misses are counted by
+ * the caller and added once per run with result_cache_record.
+ */
+#define CACHE_WAYS 4
+#define CACHE_SHARDS 16
+#define CACHE_LINE 64
+
+// Entries are only stored with a supported operator so a zero meta is empty
+#define META_EMPTY 0
+#define META_PACK(opt, sign, result) \
+    ((uint32_t)(opt) | ((uint32_t)(sign) << 8) | ((uint32_t)(result) << 16))
+
+typedef struct cache_entry_t
+{
+    _Atomic uint32_t sequence;  // Odd while the entry is being written
+    _Atomic uint32_t meta;      // Operator, sign and result packed together
+    _Atomic uint64_t l_operand;
+    _Atomic uint64_t r_operand;
+    _Atomic uint64_t solution;
+} cache_entry_t;
+
+typedef struct cache_set_t
+{
+    _Alignas(CACHE_LINE) cache_entry_t entries[CACHE_WAYS];
+    _Atomic uint8_t referenced[CACHE_WAYS];     // Set on a hit, cleared by the hand
+    uint8_t hand;                               // Next way the CLOCK considers
+} cache_set_t;
+
+typedef struct cache_shard_t
+{
+    _Alignas(CACHE_LINE) mtx_t write_lock;
+    atomic_uint_fast64_t inserts;
+    atomic_uint_fast64_t evictions;
+} cache_shard_t;
+
+typedef struct result_cache_t
+{
+    cache_set_t * sets;
+    uint64_t set_mask;
+    cache_shard_t shards[CACHE_SHARDS];
+    _Alignas(CACHE_LINE) atomic_uint_fast64_t hits;
+    atomic_uint_fast64_t misses;
+} result_cache_t;
+
+// Set up before any equation is solved and torn down after the last one
+static result_cache_t * cache = NULL;
+
+/*!
+ * @brief Enable the result cache with room for at least capacity results.
+ * The capacity is rounded up to a power of two. The cache must be set up
+ * before any thread solves equations and is shared by all of them.
+ * @param capacity Number of results to hold
+ * @return 0 if the cache was created, -1 if it already exists, the capacity
+ * is zero or memory could not be allocated
+ */
+int8_t result_cache_init(uint64_t capacity)
+{
+    if ((NULL != cache) || (0 == capacity))
+    {
+        return -1;
+    }
+
+    uint64_t set_count = CACHE_SHARDS;
+    while ((set_count * CACHE_WAYS) < capacity)
+    {
+        set_count <<= 1;
+    }
+
+    result_cache_t * new_cache = (result_cache_t *)aligned_alloc(CACHE_LINE, sizeof(result_cache_t));
+    if (UV_INVALID_ALLOC == verify_alloc(new_cache))
+    {
+        return -1;
+    }
+    memset(new_cache, 0, sizeof(result_cache_t));
+
+    new_cache->sets = (cache_set_t *)aligned_alloc(CACHE_LINE, set_count * sizeof(cache_set_t));
+    if (UV_INVALID_ALLOC == verify_alloc(new_cache->sets))
+    {
+        free(new_cache);
+        return -1;
+    }
+    memset(new_cache->sets, 0, set_count * sizeof(cache_set_t));
+    new_cache->set_mask = set_count - 1;
+
+    for (uint8_t shard = 0; shard < CACHE_SHARDS; shard++)
+    {
+        if (thrd_success != mtx_init(&new_cache->shards[shard].write_lock, mtx_plain))
+        {
+            debug_print_err("%s\n", "Unable to initialize the cache shard lock");
+            for (uint8_t initialized = 0; initialized < shard; initialized++)
+            {
+                mtx_destroy(&new_cache->shards[initialized].write_lock);
+            }
+            free(new_cache->sets);
+            free(new_cache);
+            return -1;
+        }
+    }
+
+    cache = new_cache;
+    return 0;
+}
+
+/*!
+ * @brief Free the result cache. No thread may be solving equations.
+ */
+void result_cache_destroy(void)
+{
+    if (NULL == cache)
+    {
+        return;
+    }
+    for (uint8_t shard = 0; shard < CACHE_SHARDS; shard++)
+    {
+        mtx_destroy(&cache->shards[shard].write_lock);
+    }
+    free(cache->sets);
+    free(cache);
+    cache = NULL;
+}
+
+/*!
+ * @brief Check if result_cache_init enabled the cache
+ * @return 1 if the cache is enabled else 0
+ */
+uint8_t result_cache_enabled(void)
+{
+    return (uint8_t)(NULL != cache);
+}
+
+/*!
+ * @brief Look up the result of an equation without taking any lock. The
+ * lookup is not counted, see result_cache_record
+ * @param l_operand Left operand
+ * @param opt Operator byte code
+ * @param r_operand Right operand
+ * @param solution Written with the cached eval result on a hit
+ * @param sign Written with the cached eq_eval_type_t on a hit
+ * @param result Written with the cached eq_result_t on a hit
+ * @return 1 if the equation was found else 0
+ */
+uint8_t result_cache_lookup(uint64_t l_operand,
+                            uint8_t opt,
+                            uint64_t r_operand,
+                            uint64_t * solution,
+                            uint8_t * sign,
+                            uint8_t * result)
+{
+    uint64_t hash = hash_equation(l_operand, opt, r_operand);
+    cache_set_t * set = &cache->sets[hash & cache->set_mask];
+
+    for (uint8_t way = 0; way < CACHE_WAYS; way++)
+    {
+        cache_entry_t * entry = &set->entries[way];
+        uint32_t before = atomic_load_explicit(&entry->sequence, memory_order_acquire);
+        if (0 != (before & 1))
+        {
+            continue;
+        }
+
+        uint32_t meta = atomic_load_explicit(&entry->meta, memory_order_relaxed);
+        uint64_t cached_l = atomic_load_explicit(&entry->l_operand, memory_order_relaxed);
+        uint64_t cached_r = atomic_load_explicit(&entry->r_operand, memory_order_relaxed);
+        uint64_t cached_solution = atomic_load_explicit(&entry->solution, memory_order_relaxed);
+        atomic_thread_fence(memory_order_acquire);
+        if (before != atomic_load_explicit(&entry->sequence, memory_order_relaxed))
+        {
+            continue;
+        }
+
+        if (((uint8_t)meta != opt) || (cached_l != l_operand) || (cached_r != r_operand))
+        {
+            continue;
+        }
+
+        *solution = cached_solution;
+        *sign = (uint8_t)(meta >> 8);
+        *result = (uint8_t)(meta >> 16);
+        // Only dirty the line when the hand has cleared the bit since
+        if (0 == atomic_load_explicit(&set->referenced[way], memory_order_relaxed))
+        {
+            atomic_store_explicit(&set->referenced[way], 1, memory_order_relaxed);
+        }
+        return 1;
+    }
+
+    return 0;
+}
+
+/*!
+ * @brief Add the hits and misses of a run of lookups to the counters
+ * @param hits Lookups that found the equation
+ * @param misses Lookups that did not find the equation
+ */
+void result_cache_record(uint64_t hits, uint64_t misses)
+{
+    atomic_fetch_add_explicit(&cache->hits, hits, memory_order_relaxed);
+    atomic_fetch_add_explicit(&cache->misses, misses, memory_order_relaxed);
+}
+
+/*!
+ * @brief Store the result of an equation. An empty way of its set is used
+ * first, otherwise the CLOCK hand picks the way to evict.
+ * @param l_operand Left operand
+ * @param opt Operator byte code, must not be zero
+ * @param r_operand Right operand
+ * @param solution Eval result
+ * @param sign eq_eval_type_t of the result
+ * @param result eq_result_t of the equation
+ */
+void result_cache_store(uint64_t l_operand,
+                        uint8_t opt,
+                        uint64_t r_operand,
+                        uint64_t solution,
+                        uint8_t sign,
+                        uint8_t result)
+{
+    uint64_t hash = hash_equation(l_operand, opt, r_operand);
+    cache_set_t * set = &cache->sets[hash & cache->set_mask];
+    cache_shard_t * shard = &cache->shards[hash & (CACHE_SHARDS - 1)];
+
+    mtx_lock(&shard->write_lock);
+
+    // Another thread may have stored the same equation since the lookup
+    uint8_t victim = CACHE_WAYS;
+    for (uint8_t way = 0; way < CACHE_WAYS; way++)
+    {
+        cache_entry_t * entry = &set->entries[way];
+        uint32_t meta = atomic_load_explicit(&entry->meta, memory_order_relaxed);
+        if (META_EMPTY == meta)
+        {
+            victim = (CACHE_WAYS == victim) ? way : victim;
+        }
+        else if (((uint8_t)meta == opt)
+                 && (atomic_load_explicit(&entry->l_operand, memory_order_relaxed) == l_operand)
+                 && (atomic_load_explicit(&entry->r_operand, memory_order_relaxed) == r_operand))
+        {
+            mtx_unlock(&shard->write_lock);
+            return;
+        }
+    }
+
+    if (CACHE_WAYS == victim)
+    {
+        // Readers keep setting reference bits while the hand sweeps, so the
+        // sweep gives up after two turns and evicts the way under the hand
+        for (uint8_t step = 0; step < (2 * CACHE_WAYS); step++)
+        {
+            if (0 == atomic_exchange_explicit(&set->referenced[set->hand], 0, memory_order_relaxed))
+            {
+                break;
+            }
+            set->hand = (uint8_t)((set->hand + 1) % CACHE_WAYS);
+        }
+        victim = set->hand;
+        set->hand = (uint8_t)((set->hand + 1) % CACHE_WAYS);
+        atomic_fetch_add_explicit(&shard->evictions, 1, memory_order_relaxed);
+    }
+
+    cache_entry_t * entry = &set->entries[victim];
+    uint32_t sequence = atomic_load_explicit(&entry->sequence, memory_order_relaxed);
+    atomic_store_explicit(&entry->sequence, sequence + 1, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+    atomic_store_explicit(&entry->meta, META_PACK(opt, sign, result), memory_order_relaxed);
+    atomic_store_explicit(&entry->l_operand, l_operand, memory_order_relaxed);
+    atomic_store_explicit(&entry->r_operand, r_operand, memory_order_relaxed);
+    atomic_store_explicit(&entry->solution, solution, memory_order_relaxed);
+    atomic_store_explicit(&entry->sequence, sequence + 2, memory_order_release);
+    atomic_store_explicit(&set->referenced[victim], 0, memory_order_relaxed);
+
+    atomic_fetch_add_explicit(&shard->inserts, 1, memory_order_relaxed);
+    mtx_unlock(&shard->write_lock);
+}
+
+/*!
+ * @brief Fetch the counters of the cache. All of them are zero when the
+ * cache is not enabled.
+ * @param stats Written with the counters summed over the shards
+ */
+void result_cache_stats(result_cache_stats_t * stats)
+{
+    *stats = (result_cache_stats_t){0};
+    if (NULL == cache)
+    {
+        return;
+    }
+
+    stats->capacity = (cache->set_mask + 1) * CACHE_WAYS;
+    stats->hits = atomic_load_explicit(&cache->hits, memory_order_relaxed);
+    stats->misses = atomic_load_explicit(&cache->misses, memory_order_relaxed);
+    for (uint8_t shard = 0; shard < CACHE_SHARDS; shard++)
+    {
+        stats->inserts += atomic_load_explicit(&cache->shards[shard].inserts, memory_order_relaxed);
+        stats->evictions += atomic_load_explicit(&cache->shards[shard].evictions, memory_order_relaxed);
+    }
+}
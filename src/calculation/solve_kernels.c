@@ -0,0 +1,1123 @@
+#include <calculation.h>
+#include <result_cache.h>
+#include <string.h>
+#include <threads.h>
+
+#if defined(__x86_64__)
+#include <immintrin.h>
+#endif // END __x86_64__
+
+/*
+ * Branch free kernels for each operator. Every kernel solves a run of
+ * equations that share an operator and writes the same solution, sign and
+ * result the matching callback in calculation.c produces. Failures are
+ * folded in with masks rather than early returns so the loops have no
+ * control flow besides the loop itself.
+ *
+ * The masks rely on the numeric values of the result and sign enums.
+ */
+_Static_assert((EQ_FAILURE == 0) && (EQ_SOLVED == 1),
+               "kernels store the success bit as the result");
+_Static_assert((EQ_VAL_SIGNED + 1) == EQ_VAL_UNSIGNED,
+               "kernels derive the sign from the success bit");
+
+#define MAX_BITS 64
+#define SHIFT_MASK (MAX_BITS - 1)
+#define MIN_DIVISOR_RUN 16      // Shortest run of one divisor worth a magic number
+#define DIVISOR_STRIDE (MIN_DIVISOR_RUN / 2)
+#define NARROW_BIAS ((uint64_t)1 << 31)
+#define DOUBLE_TO_INT 0x1.8p52  // Adding this leaves a small integer in the low bits
+
+__extension__ typedef __int128 int128_t;
+__extension__ typedef unsigned __int128 uint128_t;
+
+// Multiply and shift that replaces a division by one divisor
+typedef struct divisor_magic_t
+{
+    int64_t multiplier;     // Magic multiplier, zero to divide by a shift
+    uint64_t add_mask;      // All ones if the numerator is added back
+    uint64_t sub_mask;      // All ones if the numerator is subtracted
+    uint64_t negative;      // All ones if the divisor is negative
+    uint8_t shift;          // Arithmetic shift applied after the multiply
+} divisor_magic_t;
+
+typedef void (* solve_kernel_t)(const uint64_t * restrict l_operand,
+                                const uint64_t * restrict r_operand,
+                                uint64_t count,
+                                uint64_t * restrict solution,
+                                uint8_t * restrict sign,
+                                uint8_t * restrict result);
+
+static void add_kernel(const uint64_t * restrict l_operand, const uint64_t * restrict r_operand, uint64_t count,
+                       uint64_t * restrict solution, uint8_t * restrict sign, uint8_t * restrict result);
+static void sub_kernel(const uint64_t * restrict l_operand, const uint64_t * restrict r_operand, uint64_t count,
+                       uint64_t * restrict solution, uint8_t * restrict sign, uint8_t * restrict result);
+static void mul_kernel(const uint64_t * restrict l_operand, const uint64_t * restrict r_operand, uint64_t count,
+                       uint64_t * restrict solution, uint8_t * restrict sign, uint8_t * restrict result);
+static void div_kernel(const uint64_t * restrict l_operand, const uint64_t * restrict r_operand, uint64_t count,
+                       uint64_t * restrict solution, uint8_t * restrict sign, uint8_t * restrict result);
+static void mod_kernel(const uint64_t * restrict l_operand, const uint64_t * restrict r_operand, uint64_t count,
+                       uint64_t * restrict solution, uint8_t * restrict sign, uint8_t * restrict result);
+static void s_left_kernel(const uint64_t * restrict l_operand, const uint64_t * restrict r_operand, uint64_t count,
+                          uint64_t * restrict solution, uint8_t * restrict sign, uint8_t * restrict result);
+static void s_right_kernel(const uint64_t * restrict l_operand, const uint64_t * restrict r_operand, uint64_t count,
+                           uint64_t * restrict solution, uint8_t * restrict sign, uint8_t * restrict result);
+static void and_kernel(const uint64_t * restrict l_operand, const uint64_t * restrict r_operand, uint64_t count,
+                       uint64_t * restrict solution, uint8_t * restrict sign, uint8_t * restrict result);
+static void or_kernel(const uint64_t * restrict l_operand, const uint64_t * restrict r_operand, uint64_t count,
+                      uint64_t * restrict solution, uint8_t * restrict sign, uint8_t * restrict result);
+static void xor_kernel(const uint64_t * restrict l_operand, const uint64_t * restrict r_operand, uint64_t count,
+                       uint64_t * restrict solution, uint8_t * restrict sign, uint8_t * restrict result);
+static void r_left_kernel(const uint64_t * restrict l_operand, const uint64_t * restrict r_operand, uint64_t count,
+                          uint64_t * restrict solution, uint8_t * restrict sign, uint8_t * restrict result);
+static void r_right_kernel(const uint64_t * restrict l_operand, const uint64_t * restrict r_operand, uint64_t count,
+                           uint64_t * restrict solution, uint8_t * restrict sign, uint8_t * restrict result);
+static void unknown_kernel(const uint64_t * restrict l_operand, const uint64_t * restrict r_operand, uint64_t count,
+                           uint64_t * restrict solution, uint8_t * restrict sign, uint8_t * restrict result);
+
+#if defined(__x86_64__)
+static void add_kernel_avx2(const uint64_t * restrict l_operand, const uint64_t * restrict r_operand, uint64_t count,
+                            uint64_t * restrict solution, uint8_t * restrict sign, uint8_t * restrict result);
+static void sub_kernel_avx2(const uint64_t * restrict l_operand, const uint64_t * restrict r_operand, uint64_t count,
+                            uint64_t * restrict solution, uint8_t * restrict sign, uint8_t * restrict result);
+static void mul_kernel_avx2(const uint64_t * restrict l_operand, const uint64_t * restrict r_operand, uint64_t count,
+                            uint64_t * restrict solution, uint8_t * restrict sign, uint8_t * restrict result);
+static void div_kernel_avx2(const uint64_t * restrict l_operand, const uint64_t * restrict r_operand, uint64_t count,
+                            uint64_t * restrict solution, uint8_t * restrict sign, uint8_t * restrict result);
+static void mod_kernel_avx2(const uint64_t * restrict l_operand, const uint64_t * restrict r_operand, uint64_t count,
+                            uint64_t * restrict solution, uint8_t * restrict sign, uint8_t * restrict result);
+static void s_left_kernel_avx2(const uint64_t * restrict l_operand, const uint64_t * restrict r_operand, uint64_t count,
+                               uint64_t * restrict solution, uint8_t * restrict sign, uint8_t * restrict result);
+static void s_right_kernel_avx2(const uint64_t * restrict l_operand, const uint64_t * restrict r_operand, uint64_t count,
+                                uint64_t * restrict solution, uint8_t * restrict sign, uint8_t * restrict result);
+static void and_kernel_avx2(const uint64_t * restrict l_operand, const uint64_t * restrict r_operand, uint64_t count,
+                            uint64_t * restrict solution, uint8_t * restrict sign, uint8_t * restrict result);
+static void or_kernel_avx2(const uint64_t * restrict l_operand, const uint64_t * restrict r_operand, uint64_t count,
+                           uint64_t * restrict solution, uint8_t * restrict sign, uint8_t * restrict result);
+static void xor_kernel_avx2(const uint64_t * restrict l_operand, const uint64_t * restrict r_operand, uint64_t count,
+                            uint64_t * restrict solution, uint8_t * restrict sign, uint8_t * restrict result);
+static void r_left_kernel_avx2(const uint64_t * restrict l_operand, const uint64_t * restrict r_operand, uint64_t count,
+                               uint64_t * restrict solution, uint8_t * restrict sign, uint8_t * restrict result);
+static void r_right_kernel_avx2(const uint64_t * restrict l_operand, const uint64_t * restrict r_operand, uint64_t count,
+                                uint64_t * restrict solution, uint8_t * restrict sign, uint8_t * restrict result);
+static void add_kernel_avx512(const uint64_t * restrict l_operand, const uint64_t * restrict r_operand, uint64_t count,
+                              uint64_t * restrict solution, uint8_t * restrict sign, uint8_t * restrict result);
+static void sub_kernel_avx512(const uint64_t * restrict l_operand, const uint64_t * restrict r_operand, uint64_t count,
+                              uint64_t * restrict solution, uint8_t * restrict sign, uint8_t * restrict result);
+static void mul_kernel_avx512(const uint64_t * restrict l_operand, const uint64_t * restrict r_operand, uint64_t count,
+                              uint64_t * restrict solution, uint8_t * restrict sign, uint8_t * restrict result);
+static void div_kernel_avx512(const uint64_t * restrict l_operand, const uint64_t * restrict r_operand, uint64_t count,
+                              uint64_t * restrict solution, uint8_t * restrict sign, uint8_t * restrict result);
+static void mod_kernel_avx512(const uint64_t * restrict l_operand, const uint64_t * restrict r_operand, uint64_t count,
+                              uint64_t * restrict solution, uint8_t * restrict sign, uint8_t * restrict result);
+static void s_left_kernel_avx512(const uint64_t * restrict l_operand, const uint64_t * restrict r_operand, uint64_t count,
+                                 uint64_t * restrict solution, uint8_t * restrict sign, uint8_t * restrict result);
+static void s_right_kernel_avx512(const uint64_t * restrict l_operand, const uint64_t * restrict r_operand, uint64_t count,
+                                  uint64_t * restrict solution, uint8_t * restrict sign, uint8_t * restrict result);
+static void and_kernel_avx512(const uint64_t * restrict l_operand, const uint64_t * restrict r_operand, uint64_t count,
+                              uint64_t * restrict solution, uint8_t * restrict sign, uint8_t * restrict result);
+static void or_kernel_avx512(const uint64_t * restrict l_operand, const uint64_t * restrict r_operand, uint64_t count,
+                             uint64_t * restrict solution, uint8_t * restrict sign, uint8_t * restrict result);
+static void xor_kernel_avx512(const uint64_t * restrict l_operand, const uint64_t * restrict r_operand, uint64_t count,
+                              uint64_t * restrict solution, uint8_t * restrict sign, uint8_t * restrict result);
+static void r_left_kernel_avx512(const uint64_t * restrict l_operand, const uint64_t * restrict r_operand, uint64_t count,
+                                 uint64_t * restrict solution, uint8_t * restrict sign, uint8_t * restrict result);
+static void r_right_kernel_avx512(const uint64_t * restrict l_operand, const uint64_t * restrict r_operand, uint64_t count,
+                                  uint64_t * restrict solution, uint8_t * restrict sign, uint8_t * restrict result);
+#endif // END __x86_64__
+static void select_kernels(void);
+static void solve_block(const uint64_t * l_operand,
+                        const uint8_t * opt,
+                        const uint64_t * r_operand,
+                        uint16_t count,
+                        uint64_t * solution,
+                        uint8_t * sign,
+                        uint8_t * result);
+static void solve_run(uint8_t opt,
+                      const uint64_t * l_operand,
+                      const uint64_t * r_operand,
+                      uint16_t count,
+                      uint64_t * solution,
+                      uint8_t * sign,
+                      uint8_t * result);
+static void solve_cached(uint8_t opt,
+                         const uint64_t * l_operand,
+                         const uint64_t * r_operand,
+                         uint16_t count,
+                         uint64_t * solution,
+                         uint8_t * sign,
+                         uint8_t * result);
+
+#define KERNEL_COUNT (OPERATOR_MAX + 1)
+#define SOLVE_BLOCK 1024        // Equations bucketed together on the stack
+#define MIN_RUN_LENGTH 16       // Average run length solved without bucketing
+
+#define SCALAR_KERNEL(code, name, sign, cached) [code] = name##_kernel,
+#define AVX2_KERNEL(code, name, sign, cached) [code] = name##_kernel_avx2,
+#define AVX512_KERNEL(code, name, sign, cached) [code] = name##_kernel_avx512,
+#define CACHED_OPERATOR(code, name, sign, cached) [code] = cached,
+
+// Operators whose results are looked up in the result cache when it is enabled
+static const uint8_t cached_operators[KERNEL_COUNT] = {
+    OPERATORS(CACHED_OPERATOR)
+};
+
+// Indexed by the operator byte code. Codes past the end are unknown
+static const solve_kernel_t scalar_kernels[KERNEL_COUNT] = {
+    [0] = unknown_kernel,
+    OPERATORS(SCALAR_KERNEL)
+};
+
+#if defined(__x86_64__)
+// Multiplication and division only have vector instructions for operands
+// that fit in 32 bits. Their SIMD kernels fall back to the scalar kernels
+// for runs with any wider operand
+static const solve_kernel_t avx2_kernels[KERNEL_COUNT] = {
+    [0] = unknown_kernel,
+    OPERATORS(AVX2_KERNEL)
+};
+
+static const solve_kernel_t avx512_kernels[KERNEL_COUNT] = {
+    [0] = unknown_kernel,
+    OPERATORS(AVX512_KERNEL)
+};
+
+// Spreads the four lane bits of a movemask into four 0 or 1 bytes
+static const uint32_t lane_bytes[16] = {
+    0x00000000, 0x00000001, 0x00000100, 0x00000101,
+    0x00010000, 0x00010001, 0x00010100, 0x00010101,
+    0x01000000, 0x01000001, 0x01000100, 0x01000101,
+    0x01010000, 0x01010001, 0x01010100, 0x01010101,
+};
+#endif // END __x86_64__
+
+// Indexed by isa_level_t
+static const solve_kernel_t * const kernel_tables[ISA_COUNT] = {
+#if defined(__x86_64__)
+    [ISA_SCALAR]    = scalar_kernels,
+    [ISA_AVX2]      = avx2_kernels,
+    [ISA_AVX512]    = avx512_kernels,
+#else
+    [ISA_SCALAR]    = scalar_kernels,
+    [ISA_AVX2]      = scalar_kernels,
+    [ISA_AVX512]    = scalar_kernels,
+#endif // END __x86_64__
+};
+
+static once_flag kernels_once = ONCE_FLAG_INIT;
+static const solve_kernel_t * kernels = scalar_kernels;
+static solve_variant_t kernels_variant = SOLVE_VARIANT_SCALAR;
+
+/*!
+ * @brief Solve count equations given as columns, writing the result of each
+ * into the callers solution, sign and result arrays. The columns are worked
+ * through in blocks of SOLVE_BLOCK equations and each block is handed to the
+ * operator kernels with solve_block. The outputs are identical to solving
+ * each equation with get_equation_struct.
+ * @param l_operand Column of left operands
+ * @param opt Column of operator byte codes
+ * @param r_operand Column of right operands
+ * @param count Number of equations in each column
+ * @param solution Written with the eval result of each equation
+ * @param sign Written with the eq_eval_type_t of each result
+ * @param result Written with the eq_result_t of each equation
+ */
+void solve_columns(const uint64_t * l_operand,
+                   const uint8_t * opt,
+                   const uint64_t * r_operand,
+                   uint64_t count,
+                   uint64_t * solution,
+                   uint8_t * sign,
+                   uint8_t * result)
+{
+    call_once(&kernels_once, select_kernels);
+
+    for (uint64_t start = 0; start < count; start += SOLVE_BLOCK)
+    {
+        uint64_t block = ((count - start) < SOLVE_BLOCK) ? (count - start) : SOLVE_BLOCK;
+        solve_block(l_operand + start, opt + start, r_operand + start, (uint16_t)block,
+                    solution + start, sign + start, result + start);
+    }
+}
+
+/*!
+ * @brief Solve a block of at most SOLVE_BLOCK equations. A block made of a
+ * few long runs of one operator is solved in place one run at a time. A block
+ * with interleaved operators would give the kernels runs too short to
+ * vectorize, so it is bucketed by operator with a counting sort: the operands
+ * are gathered into one contiguous bucket per operator, each bucket goes
+ * through its kernel once and the results are scattered back to the order of
+ * the columns. The scratch space lives on the stack so solving never
+ * allocates.
+ */
+static void solve_block(const uint64_t * l_operand,
+                        const uint8_t * opt,
+                        const uint64_t * r_operand,
+                        uint16_t count,
+                        uint64_t * solution,
+                        uint8_t * sign,
+                        uint8_t * result)
+{
+    uint16_t runs = 1;
+    for (uint16_t i = 1; i < count; i++)
+    {
+        runs = (uint16_t)(runs + (opt[i] != opt[i - 1]));
+    }
+
+    if (runs <= (count / MIN_RUN_LENGTH))
+    {
+        uint16_t start = 0;
+        while (start < count)
+        {
+            uint8_t run_opt = opt[start];
+            uint16_t end = (uint16_t)(start + 1);
+            while ((end < count) && (opt[end] == run_opt))
+            {
+                end++;
+            }
+
+            solve_run((run_opt < KERNEL_COUNT) ? run_opt : 0, l_operand + start, r_operand + start,
+                      (uint16_t)(end - start), solution + start, sign + start, result + start);
+            start = end;
+        }
+        return;
+    }
+
+    // Bucket 0 collects every unknown operator
+    uint16_t bucket_start[KERNEL_COUNT + 1] = {0};
+    for (uint16_t i = 0; i < count; i++)
+    {
+        bucket_start[((opt[i] < KERNEL_COUNT) ? opt[i] : 0) + 1]++;
+    }
+    for (uint8_t bucket = 1; bucket <= KERNEL_COUNT; bucket++)
+    {
+        bucket_start[bucket] = (uint16_t)(bucket_start[bucket] + bucket_start[bucket - 1]);
+    }
+
+    uint16_t index[SOLVE_BLOCK];
+    uint64_t l_bucketed[SOLVE_BLOCK];
+    uint64_t r_bucketed[SOLVE_BLOCK];
+    uint64_t solution_bucketed[SOLVE_BLOCK];
+    uint8_t sign_bucketed[SOLVE_BLOCK];
+    uint8_t result_bucketed[SOLVE_BLOCK];
+
+    uint16_t next[KERNEL_COUNT];
+    memcpy(next, bucket_start, sizeof(next));
+    for (uint16_t i = 0; i < count; i++)
+    {
+        uint8_t bucket = (opt[i] < KERNEL_COUNT) ? opt[i] : 0;
+        uint16_t position = next[bucket]++;
+        index[position] = i;
+        l_bucketed[position] = l_operand[i];
+        r_bucketed[position] = r_operand[i];
+    }
+
+    for (uint8_t bucket = 0; bucket < KERNEL_COUNT; bucket++)
+    {
+        uint16_t first = bucket_start[bucket];
+        uint16_t size = (uint16_t)(bucket_start[bucket + 1] - first);
+        if (0 != size)
+        {
+            solve_run(bucket, l_bucketed + first, r_bucketed + first, size,
+                      solution_bucketed + first, sign_bucketed + first, result_bucketed + first);
+        }
+    }
+
+    for (uint16_t position = 0; position < count; position++)
+    {
+        uint16_t i = index[position];
+        solution[i] = solution_bucketed[position];
+        sign[i] = sign_bucketed[position];
+        result[i] = result_bucketed[position];
+    }
+}
+
+/*!
+ * @brief Solve a run of equations sharing one operator with its kernel.
+ * Operators marked cached go through the result cache when it is enabled.
+ * @param opt Operator byte code, already mapped to 0 if it is unknown
+ */
+static void solve_run(uint8_t opt,
+                      const uint64_t * l_operand,
+                      const uint64_t * r_operand,
+                      uint16_t count,
+                      uint64_t * solution,
+                      uint8_t * sign,
+                      uint8_t * result)
+{
+    if ((0 != cached_operators[opt]) && (0 != result_cache_enabled()))
+    {
+        solve_cached(opt, l_operand, r_operand, count, solution, sign, result);
+        return;
+    }
+    kernels[opt](l_operand, r_operand, count, solution, sign, result);
+}
+
+/*!
+ * @brief Solve a run of equations by looking each one up in the result
+ * cache. The misses are gathered and go through the kernel together, then
+ * their results are scattered back to the run and stored in the cache. The
+ * hits and misses of the run are counted once at the end of the lookups.
+ */
+static void solve_cached(uint8_t opt,
+                         const uint64_t * l_operand,
+                         const uint64_t * r_operand,
+                         uint16_t count,
+                         uint64_t * solution,
+                         uint8_t * sign,
+                         uint8_t * result)
+{
+    uint16_t index[SOLVE_BLOCK];
+    uint64_t l_missed[SOLVE_BLOCK];
+    uint64_t r_missed[SOLVE_BLOCK];
+    uint64_t solution_missed[SOLVE_BLOCK];
+    uint8_t sign_missed[SOLVE_BLOCK];
+    uint8_t result_missed[SOLVE_BLOCK];
+
+    uint16_t misses = 0;
+    for (uint16_t i = 0; i < count; i++)
+    {
+        if (0 == result_cache_lookup(l_operand[i], opt, r_operand[i], &solution[i], &sign[i], &result[i]))
+        {
+            index[misses] = i;
+            l_missed[misses] = l_operand[i];
+            r_missed[misses] = r_operand[i];
+            misses++;
+        }
+    }
+    result_cache_record((uint64_t)(count - misses), misses);
+    if (0 == misses)
+    {
+        return;
+    }
+
+    kernels[opt](l_missed, r_missed, misses, solution_missed, sign_missed, result_missed);
+    for (uint16_t miss = 0; miss < misses; miss++)
+    {
+        uint16_t i = index[miss];
+        solution[i] = solution_missed[miss];
+        sign[i] = sign_missed[miss];
+        result[i] = result_missed[miss];
+        result_cache_store(l_missed[miss], opt, r_missed[miss],
+                           solution_missed[miss], sign_missed[miss], result_missed[miss]);
+    }
+}
+
+/*!
+ * @brief Force the kernels used by solve_columns. This is used to compare
+ * the variants against each other.
+ * @param variant Variant to use
+ * @return 1 if the variant is supported by this CPU and was selected else 0
+ */
+uint8_t set_solve_variant(solve_variant_t variant)
+{
+    call_once(&kernels_once, select_kernels);
+    if (((isa_level_t)variant >= ISA_COUNT) || !isa_supported((isa_level_t)variant))
+    {
+        return 0;
+    }
+    kernels = kernel_tables[variant];
+    kernels_variant = variant;
+    return 1;
+}
+
+/*!
+ * @brief Fetch the variant solve_columns is using
+ * @return Variant in use
+ */
+solve_variant_t get_solve_variant(void)
+{
+    call_once(&kernels_once, select_kernels);
+    return kernels_variant;
+}
+
+static void select_kernels(void)
+{
+    kernels_variant = (solve_variant_t)get_isa_level();
+    kernels = kernel_tables[kernels_variant];
+}
+
+/*
+ * Store a signed result. solved is 1 or 0 and a failed equation keeps a zero
+ * solution and the unsigned sign just like the callbacks leave them.
+ */
+static inline void store_signed(uint64_t value, uint64_t solved, uint64_t * solution, uint8_t * sign, uint8_t * result)
+{
+    *solution = value & (0 - solved);
+    *sign = (uint8_t)(EQ_VAL_UNSIGNED - solved);
+    *result = (uint8_t)solved;
+}
+
+static void add_kernel(const uint64_t * restrict l_operand, const uint64_t * restrict r_operand, uint64_t count,
+                       uint64_t * restrict solution, uint8_t * restrict sign, uint8_t * restrict result)
+{
+    for (uint64_t i = 0; i < count; i++)
+    {
+        uint64_t sum = l_operand[i] + r_operand[i];
+
+        // Overflowed if both operands share a sign the sum does not have
+        uint64_t overflow = ((l_operand[i] ^ sum) & (r_operand[i] ^ sum)) >> 63;
+        store_signed(sum, overflow ^ 1, &solution[i], &sign[i], &result[i]);
+    }
+}
+
+static void sub_kernel(const uint64_t * restrict l_operand, const uint64_t * restrict r_operand, uint64_t count,
+                       uint64_t * restrict solution, uint8_t * restrict sign, uint8_t * restrict result)
+{
+    for (uint64_t i = 0; i < count; i++)
+    {
+        uint64_t difference = l_operand[i] - r_operand[i];
+
+        // Overflowed if the operands differ in sign and the difference does
+        // not have the sign of the left operand
+        uint64_t overflow = ((l_operand[i] ^ r_operand[i]) & (l_operand[i] ^ difference)) >> 63;
+        store_signed(difference, overflow ^ 1, &solution[i], &sign[i], &result[i]);
+    }
+}
+
+static void mul_kernel(const uint64_t * restrict l_operand, const uint64_t * restrict r_operand, uint64_t count,
+                       uint64_t * restrict solution, uint8_t * restrict sign, uint8_t * restrict result)
+{
+    for (uint64_t i = 0; i < count; i++)
+    {
+        // The overflow flag of the widening multiply is the failure bit. A
+        // negative right operand always fails, as it does in mul_operation
+        int64_t product = 0;
+        uint64_t failed = (uint64_t)__builtin_mul_overflow((int64_t)l_operand[i], (int64_t)r_operand[i], &product)
+                          | (r_operand[i] >> 63);
+        store_signed((uint64_t)product, failed ^ 1, &solution[i], &sign[i], &result[i]);
+    }
+}
+
+/*!
+ * @brief Divide every equation of a range with the hardware divide
+ */
+static inline void divide_range(const uint64_t * restrict l_operand, const uint64_t * restrict r_operand,
+                                uint64_t start, uint64_t end, uint8_t modulo,
+                                uint64_t * restrict solution, uint8_t * restrict sign, uint8_t * restrict result)
+{
+    for (uint64_t i = start; i < end; i++)
+    {
+        int64_t l_value = (int64_t)l_operand[i];
+        int64_t r_value = (int64_t)r_operand[i];
+
+        // Dividing by zero and INT64_MIN / -1 cannot be computed, and
+        // -1 / INT64_MIN is rejected to match the callbacks. These are rare
+        // enough that the branch is cheaper than masking every divisor
+        if ((0 == r_value) || ((INT64_MIN == l_value) && (-1 == r_value))
+            || ((INT64_MIN == r_value) && (-1 == l_value)))
+        {
+            store_signed(0, 0, &solution[i], &sign[i], &result[i]);
+            continue;
+        }
+        int64_t value = modulo ? (l_value % r_value) : (l_value / r_value);
+        store_signed((uint64_t)value, 1, &solution[i], &sign[i], &result[i]);
+    }
+}
+
+/*!
+ * @brief Compute the multiply and shift that divides by divisor, following
+ * the signed algorithm of libdivide. Only one 128 by 64 bit division is made
+ * so the cost is repaid after a few equations. Divisors whose magnitude is a
+ * power of two are divided with a shift alone
+ * @param divisor Divisor with a magnitude of at least two
+ */
+static divisor_magic_t get_divisor_magic(int64_t divisor)
+{
+    uint64_t negative = (uint64_t)(divisor >> 63);
+    uint64_t abs_divisor = ((uint64_t)divisor ^ negative) - negative;
+    uint8_t log_2 = (uint8_t)(63 - __builtin_clzll(abs_divisor));
+
+    divisor_magic_t magic = {
+        .multiplier = 0,
+        .add_mask   = 0,
+        .sub_mask   = 0,
+        .shift      = log_2,
+        .negative   = negative,
+    };
+    if (0 == (abs_divisor & (abs_divisor - 1)))
+    {
+        return magic;
+    }
+
+    // 2^(63 + log_2) / |divisor| always fits in 64 bits since |divisor| is
+    // above 2^log_2
+    uint128_t dividend = (uint128_t)1 << (63 + log_2);
+    uint64_t multiplier = (uint64_t)(dividend / abs_divisor);
+    uint64_t remainder = (uint64_t)(dividend % abs_divisor);
+    if ((abs_divisor - remainder) < ((uint64_t)1 << log_2))
+    {
+        magic.shift = (uint8_t)(log_2 - 1);
+    }
+    else
+    {
+        // One more bit of precision is needed. The multiplier now wraps to
+        // negative so the numerator is added back after the multiply
+        uint64_t twice_remainder = remainder + remainder;
+        multiplier += multiplier;
+        multiplier += (uint64_t)((twice_remainder >= abs_divisor) || (twice_remainder < remainder));
+        magic.add_mask = ~negative;
+        magic.sub_mask = negative;
+    }
+    multiplier += 1;
+    magic.multiplier = (int64_t)((multiplier ^ negative) - negative);
+    return magic;
+}
+
+/*!
+ * @brief Divide a run of equations that share one divisor with the multiply
+ * and shift from get_divisor_magic. The quotient is truncated toward zero
+ * exactly like the C division operator
+ */
+static inline void divide_run_magic(const uint64_t * restrict l_operand, const uint64_t * restrict r_operand,
+                                    uint64_t start, uint64_t end, uint8_t modulo,
+                                    uint64_t * restrict solution, uint8_t * restrict sign, uint8_t * restrict result)
+{
+    int64_t divisor = (int64_t)r_operand[start];
+    divisor_magic_t magic = get_divisor_magic(divisor);
+
+    // The only equation left to fail is -1 / INT64_MIN
+    uint64_t min_divisor = (uint64_t)(INT64_MIN == divisor);
+    if (0 == magic.multiplier)
+    {
+        // Negative numerators are biased so the shift rounds toward zero
+        uint64_t round_mask = ((uint64_t)1 << magic.shift) - 1;
+        for (uint64_t i = start; i < end; i++)
+        {
+            uint64_t numerator = l_operand[i];
+            uint64_t biased = numerator + ((uint64_t)((int64_t)numerator >> 63) & round_mask);
+            uint64_t quotient = (uint64_t)((int64_t)biased >> magic.shift);
+            quotient = (quotient ^ magic.negative) - magic.negative;
+
+            uint64_t value = modulo ? (numerator - (quotient * (uint64_t)divisor)) : quotient;
+            uint64_t failed = min_divisor & (uint64_t)(UINT64_MAX == numerator);
+            store_signed(value, failed ^ 1, &solution[i], &sign[i], &result[i]);
+        }
+        return;
+    }
+
+    for (uint64_t i = start; i < end; i++)
+    {
+        uint64_t numerator = l_operand[i];
+        uint64_t high = (uint64_t)(((int128_t)(int64_t)numerator * magic.multiplier) >> 64);
+        high += (numerator & magic.add_mask) - (numerator & magic.sub_mask);
+        uint64_t quotient = (uint64_t)((int64_t)high >> magic.shift);
+        quotient += quotient >> 63;
+
+        uint64_t value = modulo ? (numerator - (quotient * (uint64_t)divisor)) : quotient;
+        store_signed(value, 1, &solution[i], &sign[i], &result[i]);
+    }
+}
+
+/*!
+ * @brief Solve division or modulo over the columns. Runs of at least
+ * MIN_DIVISOR_RUN equations with the same divisor replace the hardware
+ * divide with a multiply and shift computed once for the run. Everything
+ * else is divided one equation at a time
+ */
+static inline void divide_columns(const uint64_t * restrict l_operand, const uint64_t * restrict r_operand,
+                                  uint64_t count, uint8_t modulo,
+                                  uint64_t * restrict solution, uint8_t * restrict sign, uint8_t * restrict result)
+{
+    // A run of MIN_DIVISOR_RUN covers two divisors DIVISOR_STRIDE apart at
+    // multiples of the stride, so comparing those alone rules out columns
+    // without runs for a fraction of the cost of searching every equation.
+    // Divisors without a magic number never count as a run
+    uint64_t repeats = 0;
+    for (uint64_t i = DIVISOR_STRIDE; i < count; i += DIVISOR_STRIDE)
+    {
+        repeats |= (uint64_t)(r_operand[i] == r_operand[i - DIVISOR_STRIDE]) & (uint64_t)((r_operand[i] + 1) > 2);
+    }
+    if (0 == repeats)
+    {
+        divide_range(l_operand, r_operand, 0, count, modulo, solution, sign, result);
+        return;
+    }
+
+    uint64_t solved = 0;
+    uint64_t run = 0;
+    for (uint64_t i = 1; i <= count; i++)
+    {
+        if ((i < count) && (r_operand[i] == r_operand[run]))
+        {
+            continue;
+        }
+
+        // A magic number exists for every divisor but 0, 1 and -1
+        if (((i - run) >= MIN_DIVISOR_RUN) && ((r_operand[run] + 1) > 2))
+        {
+            divide_range(l_operand, r_operand, solved, run, modulo, solution, sign, result);
+            divide_run_magic(l_operand, r_operand, run, i, modulo, solution, sign, result);
+            solved = i;
+        }
+        run = i;
+    }
+    divide_range(l_operand, r_operand, solved, count, modulo, solution, sign, result);
+}
+
+static void div_kernel(const uint64_t * restrict l_operand, const uint64_t * restrict r_operand, uint64_t count,
+                       uint64_t * restrict solution, uint8_t * restrict sign, uint8_t * restrict result)
+{
+    divide_columns(l_operand, r_operand, count, 0, solution, sign, result);
+}
+
+static void mod_kernel(const uint64_t * restrict l_operand, const uint64_t * restrict r_operand, uint64_t count,
+                       uint64_t * restrict solution, uint8_t * restrict sign, uint8_t * restrict result)
+{
+    divide_columns(l_operand, r_operand, count, 1, solution, sign, result);
+}
+
+static void s_left_kernel(const uint64_t * restrict l_operand, const uint64_t * restrict r_operand, uint64_t count,
+                          uint64_t * restrict solution, uint8_t * restrict sign, uint8_t * restrict result)
+{
+    // Counts past 63 wrap around, which is the low six bits of the count
+    for (uint64_t i = 0; i < count; i++)
+    {
+        solution[i] = l_operand[i] << (r_operand[i] & SHIFT_MASK);
+        sign[i] = EQ_VAL_UNSIGNED;
+        result[i] = EQ_SOLVED;
+    }
+}
+
+static void s_right_kernel(const uint64_t * restrict l_operand, const uint64_t * restrict r_operand, uint64_t count,
+                           uint64_t * restrict solution, uint8_t * restrict sign, uint8_t * restrict result)
+{
+    // Counts past 63 are clamped to 63
+    for (uint64_t i = 0; i < count; i++)
+    {
+        uint64_t shift = (r_operand[i] > SHIFT_MASK) ? SHIFT_MASK : r_operand[i];
+        solution[i] = l_operand[i] >> shift;
+        sign[i] = EQ_VAL_UNSIGNED;
+        result[i] = EQ_SOLVED;
+    }
+}
+
+static void and_kernel(const uint64_t * restrict l_operand, const uint64_t * restrict r_operand, uint64_t count,
+                       uint64_t * restrict solution, uint8_t * restrict sign, uint8_t * restrict result)
+{
+    for (uint64_t i = 0; i < count; i++)
+    {
+        solution[i] = l_operand[i] & r_operand[i];
+        sign[i] = EQ_VAL_UNSIGNED;
+        result[i] = EQ_SOLVED;
+    }
+}
+
+static void or_kernel(const uint64_t * restrict l_operand, const uint64_t * restrict r_operand, uint64_t count,
+                      uint64_t * restrict solution, uint8_t * restrict sign, uint8_t * restrict result)
+{
+    for (uint64_t i = 0; i < count; i++)
+    {
+        solution[i] = l_operand[i] | r_operand[i];
+        sign[i] = EQ_VAL_UNSIGNED;
+        result[i] = EQ_SOLVED;
+    }
+}
+
+static void xor_kernel(const uint64_t * restrict l_operand, const uint64_t * restrict r_operand, uint64_t count,
+                       uint64_t * restrict solution, uint8_t * restrict sign, uint8_t * restrict result)
+{
+    for (uint64_t i = 0; i < count; i++)
+    {
+        solution[i] = l_operand[i] ^ r_operand[i];
+        sign[i] = EQ_VAL_UNSIGNED;
+        result[i] = EQ_SOLVED;
+    }
+}
+
+static void r_left_kernel(const uint64_t * restrict l_operand, const uint64_t * restrict r_operand, uint64_t count,
+                          uint64_t * restrict solution, uint8_t * restrict sign, uint8_t * restrict result)
+{
+    // Masking the opposite shift makes a count of 0 give back l_operand
+    for (uint64_t i = 0; i < count; i++)
+    {
+        uint64_t shift = r_operand[i] & SHIFT_MASK;
+        solution[i] = (l_operand[i] << shift) | (l_operand[i] >> ((MAX_BITS - shift) & SHIFT_MASK));
+        sign[i] = EQ_VAL_UNSIGNED;
+        result[i] = EQ_SOLVED;
+    }
+}
+
+static void r_right_kernel(const uint64_t * restrict l_operand, const uint64_t * restrict r_operand, uint64_t count,
+                           uint64_t * restrict solution, uint8_t * restrict sign, uint8_t * restrict result)
+{
+    for (uint64_t i = 0; i < count; i++)
+    {
+        uint64_t shift = r_operand[i] & SHIFT_MASK;
+        solution[i] = (l_operand[i] >> shift) | (l_operand[i] << ((MAX_BITS - shift) & SHIFT_MASK));
+        sign[i] = EQ_VAL_UNSIGNED;
+        result[i] = EQ_SOLVED;
+    }
+}
+
+static void unknown_kernel(const uint64_t * restrict l_operand, const uint64_t * restrict r_operand, uint64_t count,
+                           uint64_t * restrict solution, uint8_t * restrict sign, uint8_t * restrict result)
+{
+    (void)l_operand;
+    (void)r_operand;
+    for (uint64_t i = 0; i < count; i++)
+    {
+        solution[i] = 0;
+        sign[i] = EQ_VAL_UNSIGNED;
+        result[i] = EQ_FAILURE;
+    }
+}
+
+/*!
+ * @brief Check if every operand of a run is a signed 32 bit value. Adding
+ * 2^31 maps exactly those values into the low 32 bits, so a single OR over
+ * both columns finds any operand that is wider
+ * @return 1 if every operand fits in 32 bits else 0
+ */
+static inline uint8_t fits_32_bits(const uint64_t * restrict l_operand, const uint64_t * restrict r_operand,
+                                   uint64_t count)
+{
+    uint64_t wide = 0;
+    for (uint64_t i = 0; i < count; i++)
+    {
+        wide |= (l_operand[i] + NARROW_BIAS) | (r_operand[i] + NARROW_BIAS);
+    }
+    return (uint8_t)(0 == (wide >> 32));
+}
+
+#if defined(__x86_64__)
+/*
+ * The SIMD kernels solve whole vectors of equations and leave the tail of the
+ * run to the scalar kernel. Overflow is computed as a lane mask from the sign
+ * bits and the sign and result bytes are expanded from that mask.
+ */
+__attribute__((target("avx2")))
+static inline void store_signed_avx2(__m256i value, __m256i overflow, uint64_t * solution, uint8_t * sign, uint8_t * result)
+{
+    _mm256_storeu_si256((__m256i *)solution, _mm256_andnot_si256(overflow, value));
+    uint32_t solved = lane_bytes[~_mm256_movemask_pd(_mm256_castsi256_pd(overflow)) & 0x0f];
+    uint32_t signs = 0x02020202 - solved;
+    memcpy(result, &solved, sizeof(solved));
+    memcpy(sign, &signs, sizeof(signs));
+}
+
+__attribute__((target("avx2")))
+static void add_kernel_avx2(const uint64_t * restrict l_operand, const uint64_t * restrict r_operand, uint64_t count,
+                            uint64_t * restrict solution, uint8_t * restrict sign, uint8_t * restrict result)
+{
+    const __m256i zero = _mm256_setzero_si256();
+    uint64_t i = 0;
+    for (; i + 4 <= count; i += 4)
+    {
+        __m256i l_value = _mm256_loadu_si256((const __m256i *)(l_operand + i));
+        __m256i r_value = _mm256_loadu_si256((const __m256i *)(r_operand + i));
+        __m256i sum = _mm256_add_epi64(l_value, r_value);
+        __m256i sign_bits = _mm256_and_si256(_mm256_xor_si256(l_value, sum), _mm256_xor_si256(r_value, sum));
+        store_signed_avx2(sum, _mm256_cmpgt_epi64(zero, sign_bits), solution + i, sign + i, result + i);
+    }
+    add_kernel(l_operand + i, r_operand + i, count - i, solution + i, sign + i, result + i);
+}
+
+__attribute__((target("avx2")))
+static void sub_kernel_avx2(const uint64_t * restrict l_operand, const uint64_t * restrict r_operand, uint64_t count,
+                            uint64_t * restrict solution, uint8_t * restrict sign, uint8_t * restrict result)
+{
+    const __m256i zero = _mm256_setzero_si256();
+    uint64_t i = 0;
+    for (; i + 4 <= count; i += 4)
+    {
+        __m256i l_value = _mm256_loadu_si256((const __m256i *)(l_operand + i));
+        __m256i r_value = _mm256_loadu_si256((const __m256i *)(r_operand + i));
+        __m256i difference = _mm256_sub_epi64(l_value, r_value);
+        __m256i sign_bits = _mm256_and_si256(_mm256_xor_si256(l_value, r_value),
+                                             _mm256_xor_si256(l_value, difference));
+        store_signed_avx2(difference, _mm256_cmpgt_epi64(zero, sign_bits), solution + i, sign + i, result + i);
+    }
+    sub_kernel(l_operand + i, r_operand + i, count - i, solution + i, sign + i, result + i);
+}
+
+/*
+ * Narrow kernels. When both operands of every equation fit in 32 bits the
+ * product always fits in 64 bits, so the multiply is a signed 32 by 32 bit
+ * multiply of each lane that only fails for a negative right operand.
+ * Division is done in double precision which is exact for 32 bit operands:
+ * the quotient is truncated and the remainder l - q * r is exact since
+ * |q * r| <= |l|. The integers are taken back out of the doubles by adding
+ * DOUBLE_TO_INT. Only a zero divisor fails, INT64_MIN / -1 and
+ * -1 / INT64_MIN can not occur since both operands fit in 32 bits.
+ */
+__attribute__((target("avx2")))
+static void mul_kernel_avx2(const uint64_t * restrict l_operand, const uint64_t * restrict r_operand, uint64_t count,
+                            uint64_t * restrict solution, uint8_t * restrict sign, uint8_t * restrict result)
+{
+    if ((count < 4) || !fits_32_bits(l_operand, r_operand, count))
+    {
+        mul_kernel(l_operand, r_operand, count, solution, sign, result);
+        return;
+    }
+
+    const __m256i zero = _mm256_setzero_si256();
+    uint64_t i = 0;
+    for (; i + 4 <= count; i += 4)
+    {
+        __m256i l_value = _mm256_loadu_si256((const __m256i *)(l_operand + i));
+        __m256i r_value = _mm256_loadu_si256((const __m256i *)(r_operand + i));
+        store_signed_avx2(_mm256_mul_epi32(l_value, r_value), _mm256_cmpgt_epi64(zero, r_value),
+                          solution + i, sign + i, result + i);
+    }
+    mul_kernel(l_operand + i, r_operand + i, count - i, solution + i, sign + i, result + i);
+}
+
+__attribute__((target("avx2")))
+static inline void divide_narrow_avx2(const uint64_t * restrict l_operand, const uint64_t * restrict r_operand,
+                                      uint64_t count, uint8_t modulo,
+                                      uint64_t * restrict solution, uint8_t * restrict sign, uint8_t * restrict result)
+{
+    const __m256i zero = _mm256_setzero_si256();
+    const __m256i one = _mm256_set1_epi64x(1);
+    const __m256i low_halves = _mm256_setr_epi32(0, 2, 4, 6, 0, 2, 4, 6);
+    const __m256d to_int = _mm256_set1_pd(DOUBLE_TO_INT);
+    uint64_t i = 0;
+    for (; i + 4 <= count; i += 4)
+    {
+        __m256i l_value = _mm256_loadu_si256((const __m256i *)(l_operand + i));
+        __m256i r_value = _mm256_loadu_si256((const __m256i *)(r_operand + i));
+        __m256i failed = _mm256_cmpeq_epi64(r_value, zero);
+        r_value = _mm256_blendv_epi8(r_value, one, failed);
+
+        __m256d l_double = _mm256_cvtepi32_pd(_mm256_castsi256_si128(_mm256_permutevar8x32_epi32(l_value, low_halves)));
+        __m256d r_double = _mm256_cvtepi32_pd(_mm256_castsi256_si128(_mm256_permutevar8x32_epi32(r_value, low_halves)));
+        __m256d value = _mm256_round_pd(_mm256_div_pd(l_double, r_double), _MM_FROUND_TO_ZERO | _MM_FROUND_NO_EXC);
+        if (modulo)
+        {
+            value = _mm256_sub_pd(l_double, _mm256_mul_pd(value, r_double));
+        }
+        __m256i integer = _mm256_sub_epi64(_mm256_castpd_si256(_mm256_add_pd(value, to_int)),
+                                           _mm256_castpd_si256(to_int));
+        store_signed_avx2(integer, failed, solution + i, sign + i, result + i);
+    }
+    divide_range(l_operand, r_operand, i, count, modulo, solution, sign, result);
+}
+
+__attribute__((target("avx2")))
+static void div_kernel_avx2(const uint64_t * restrict l_operand, const uint64_t * restrict r_operand, uint64_t count,
+                            uint64_t * restrict solution, uint8_t * restrict sign, uint8_t * restrict result)
+{
+    if ((count < 4) || !fits_32_bits(l_operand, r_operand, count))
+    {
+        div_kernel(l_operand, r_operand, count, solution, sign, result);
+        return;
+    }
+    divide_narrow_avx2(l_operand, r_operand, count, 0, solution, sign, result);
+}
+
+__attribute__((target("avx2")))
+static void mod_kernel_avx2(const uint64_t * restrict l_operand, const uint64_t * restrict r_operand, uint64_t count,
+                            uint64_t * restrict solution, uint8_t * restrict sign, uint8_t * restrict result)
+{
+    if ((count < 4) || !fits_32_bits(l_operand, r_operand, count))
+    {
+        mod_kernel(l_operand, r_operand, count, solution, sign, result);
+        return;
+    }
+    divide_narrow_avx2(l_operand, r_operand, count, 1, solution, sign, result);
+}
+
+// Unsigned kernels always succeed so the sign and result bytes are set for
+// the whole run up front and only the solutions are computed per vector
+#define UNSIGNED_KERNEL_AVX2(name, scalar, expression)                                                          \
+__attribute__((target("avx2")))                                                                                 \
+static void name(const uint64_t * restrict l_operand, const uint64_t * restrict r_operand, uint64_t count,      \
+                 uint64_t * restrict solution, uint8_t * restrict sign, uint8_t * restrict result)              \
+{                                                                                                               \
+    const __m256i shift_mask = _mm256_set1_epi64x(SHIFT_MASK);                                                  \
+    const __m256i max_bits = _mm256_set1_epi64x(MAX_BITS);                                                      \
+    (void)shift_mask;                                                                                           \
+    (void)max_bits;                                                                                             \
+    memset(sign, EQ_VAL_UNSIGNED, count);                                                                       \
+    memset(result, EQ_SOLVED, count);                                                                           \
+    uint64_t i = 0;                                                                                             \
+    for (; i + 4 <= count; i += 4)                                                                              \
+    {                                                                                                           \
+        __m256i l_value = _mm256_loadu_si256((const __m256i *)(l_operand + i));                                 \
+        __m256i r_value = _mm256_loadu_si256((const __m256i *)(r_operand + i));                                 \
+        _mm256_storeu_si256((__m256i *)(solution + i), (expression));                                           \
+    }                                                                                                           \
+    scalar(l_operand + i, r_operand + i, count - i, solution + i, sign + i, result + i);                        \
+}
+
+UNSIGNED_KERNEL_AVX2(and_kernel_avx2, and_kernel, _mm256_and_si256(l_value, r_value))
+UNSIGNED_KERNEL_AVX2(or_kernel_avx2, or_kernel, _mm256_or_si256(l_value, r_value))
+UNSIGNED_KERNEL_AVX2(xor_kernel_avx2, xor_kernel, _mm256_xor_si256(l_value, r_value))
+
+// Counts past 63 wrap around
+UNSIGNED_KERNEL_AVX2(s_left_kernel_avx2, s_left_kernel,
+                     _mm256_sllv_epi64(l_value, _mm256_and_si256(r_value, shift_mask)))
+
+// Counts past 63 are clamped to 63. Any bit above the low six marks a count
+// that is too large
+UNSIGNED_KERNEL_AVX2(s_right_kernel_avx2, s_right_kernel,
+                     _mm256_srlv_epi64(l_value, _mm256_blendv_epi8(
+                         shift_mask, r_value,
+                         _mm256_cmpeq_epi64(_mm256_andnot_si256(shift_mask, r_value), _mm256_setzero_si256()))))
+
+// A count of 0 shifts the other half by 64 which srlv and sllv turn into 0
+UNSIGNED_KERNEL_AVX2(r_left_kernel_avx2, r_left_kernel,
+                     _mm256_or_si256(
+                         _mm256_sllv_epi64(l_value, _mm256_and_si256(r_value, shift_mask)),
+                         _mm256_srlv_epi64(l_value, _mm256_sub_epi64(max_bits, _mm256_and_si256(r_value, shift_mask)))))
+
+UNSIGNED_KERNEL_AVX2(r_right_kernel_avx2, r_right_kernel,
+                     _mm256_or_si256(
+                         _mm256_srlv_epi64(l_value, _mm256_and_si256(r_value, shift_mask)),
+                         _mm256_sllv_epi64(l_value, _mm256_sub_epi64(max_bits, _mm256_and_si256(r_value, shift_mask)))))
+
+__attribute__((target("avx512f")))
+static inline void store_signed_avx512(__m512i value, __mmask8 solved, uint64_t * solution, uint8_t * sign, uint8_t * result)
+{
+    __m512i solved_lanes = _mm512_maskz_set1_epi64(solved, 1);
+    _mm512_storeu_si512((void *)solution, _mm512_maskz_mov_epi64(solved, value));
+    _mm_storel_epi64((__m128i *)result, _mm512_cvtepi64_epi8(solved_lanes));
+    _mm_storel_epi64((__m128i *)sign, _mm512_cvtepi64_epi8(
+        _mm512_sub_epi64(_mm512_set1_epi64(EQ_VAL_UNSIGNED), solved_lanes)));
+}
+
+__attribute__((target("avx512f")))
+static void add_kernel_avx512(const uint64_t * restrict l_operand, const uint64_t * restrict r_operand, uint64_t count,
+                              uint64_t * restrict solution, uint8_t * restrict sign, uint8_t * restrict result)
+{
+    const __m512i zero = _mm512_setzero_si512();
+    uint64_t i = 0;
+    for (; i + 8 <= count; i += 8)
+    {
+        __m512i l_value = _mm512_loadu_si512((const void *)(l_operand + i));
+        __m512i r_value = _mm512_loadu_si512((const void *)(r_operand + i));
+        __m512i sum = _mm512_add_epi64(l_value, r_value);
+        __m512i sign_bits = _mm512_and_si512(_mm512_xor_si512(l_value, sum), _mm512_xor_si512(r_value, sum));
+        store_signed_avx512(sum, _mm512_cmpge_epi64_mask(sign_bits, zero), solution + i, sign + i, result + i);
+    }
+    add_kernel(l_operand + i, r_operand + i, count - i, solution + i, sign + i, result + i);
+}
+
+__attribute__((target("avx512f")))
+static void sub_kernel_avx512(const uint64_t * restrict l_operand, const uint64_t * restrict r_operand, uint64_t count,
+                              uint64_t * restrict solution, uint8_t * restrict sign, uint8_t * restrict result)
+{
+    const __m512i zero = _mm512_setzero_si512();
+    uint64_t i = 0;
+    for (; i + 8 <= count; i += 8)
+    {
+        __m512i l_value = _mm512_loadu_si512((const void *)(l_operand + i));
+        __m512i r_value = _mm512_loadu_si512((const void *)(r_operand + i));
+        __m512i difference = _mm512_sub_epi64(l_value, r_value);
+        __m512i sign_bits = _mm512_and_si512(_mm512_xor_si512(l_value, r_value),
+                                             _mm512_xor_si512(l_value, difference));
+        store_signed_avx512(difference, _mm512_cmpge_epi64_mask(sign_bits, zero), solution + i, sign + i, result + i);
+    }
+    sub_kernel(l_operand + i, r_operand + i, count - i, solution + i, sign + i, result + i);
+}
+
+__attribute__((target("avx512f")))
+static void mul_kernel_avx512(const uint64_t * restrict l_operand, const uint64_t * restrict r_operand, uint64_t count,
+                              uint64_t * restrict solution, uint8_t * restrict sign, uint8_t * restrict result)
+{
+    if ((count < 8) || !fits_32_bits(l_operand, r_operand, count))
+    {
+        mul_kernel(l_operand, r_operand, count, solution, sign, result);
+        return;
+    }
+
+    const __m512i zero = _mm512_setzero_si512();
+    uint64_t i = 0;
+    for (; i + 8 <= count; i += 8)
+    {
+        __m512i l_value = _mm512_loadu_si512((const void *)(l_operand + i));
+        __m512i r_value = _mm512_loadu_si512((const void *)(r_operand + i));
+        store_signed_avx512(_mm512_mul_epi32(l_value, r_value), _mm512_cmpge_epi64_mask(r_value, zero),
+                            solution + i, sign + i, result + i);
+    }
+    mul_kernel(l_operand + i, r_operand + i, count - i, solution + i, sign + i, result + i);
+}
+
+__attribute__((target("avx512f")))
+static inline void divide_narrow_avx512(const uint64_t * restrict l_operand, const uint64_t * restrict r_operand,
+                                        uint64_t count, uint8_t modulo,
+                                        uint64_t * restrict solution, uint8_t * restrict sign, uint8_t * restrict result)
+{
+    const __m512i zero = _mm512_setzero_si512();
+    const __m512i one = _mm512_set1_epi64(1);
+    const __m512d to_int = _mm512_set1_pd(DOUBLE_TO_INT);
+    uint64_t i = 0;
+    for (; i + 8 <= count; i += 8)
+    {
+        __m512i l_value = _mm512_loadu_si512((const void *)(l_operand + i));
+        __m512i r_value = _mm512_loadu_si512((const void *)(r_operand + i));
+        __mmask8 solved = _mm512_cmpneq_epi64_mask(r_value, zero);
+        r_value = _mm512_mask_mov_epi64(one, solved, r_value);
+
+        __m512d l_double = _mm512_cvtepi32_pd(_mm512_cvtepi64_epi32(l_value));
+        __m512d r_double = _mm512_cvtepi32_pd(_mm512_cvtepi64_epi32(r_value));
+        // Truncate by flooring the magnitude and putting the sign back
+        __m512d quotient = _mm512_div_pd(l_double, r_double);
+        __m512d magnitude = _mm512_abs_pd(quotient);
+        __m512i sign_bit = _mm512_xor_si512(_mm512_castpd_si512(quotient), _mm512_castpd_si512(magnitude));
+        __m512d value = _mm512_castsi512_pd(_mm512_or_si512(_mm512_castpd_si512(_mm512_floor_pd(magnitude)), sign_bit));
+        if (modulo)
+        {
+            value = _mm512_fnmadd_pd(value, r_double, l_double);
+        }
+        __m512i integer = _mm512_sub_epi64(_mm512_castpd_si512(_mm512_add_pd(value, to_int)),
+                                           _mm512_castpd_si512(to_int));
+        store_signed_avx512(integer, solved, solution + i, sign + i, result + i);
+    }
+    divide_range(l_operand, r_operand, i, count, modulo, solution, sign, result);
+}
+
+__attribute__((target("avx512f")))
+static void div_kernel_avx512(const uint64_t * restrict l_operand, const uint64_t * restrict r_operand, uint64_t count,
+                              uint64_t * restrict solution, uint8_t * restrict sign, uint8_t * restrict result)
+{
+    if ((count < 8) || !fits_32_bits(l_operand, r_operand, count))
+    {
+        div_kernel(l_operand, r_operand, count, solution, sign, result);
+        return;
+    }
+    divide_narrow_avx512(l_operand, r_operand, count, 0, solution, sign, result);
+}
+
+__attribute__((target("avx512f")))
+static void mod_kernel_avx512(const uint64_t * restrict l_operand, const uint64_t * restrict r_operand, uint64_t count,
+                              uint64_t * restrict solution, uint8_t * restrict sign, uint8_t * restrict result)
+{
+    if ((count < 8) || !fits_32_bits(l_operand, r_operand, count))
+    {
+        mod_kernel(l_operand, r_operand, count, solution, sign, result);
+        return;
+    }
+    divide_narrow_avx512(l_operand, r_operand, count, 1, solution, sign, result);
+}
+
+#define UNSIGNED_KERNEL_AVX512(name, scalar, expression)                                                        \
+__attribute__((target("avx512f")))                                                                              \
+static void name(const uint64_t * restrict l_operand, const uint64_t * restrict r_operand, uint64_t count,      \
+                 uint64_t * restrict solution, uint8_t * restrict sign, uint8_t * restrict result)              \
+{                                                                                                               \
+    const __m512i shift_mask = _mm512_set1_epi64(SHIFT_MASK);                                                   \
+    (void)shift_mask;                                                                                           \
+    memset(sign, EQ_VAL_UNSIGNED, count);                                                                       \
+    memset(result, EQ_SOLVED, count);                                                                           \
+    uint64_t i = 0;                                                                                             \
+    for (; i + 8 <= count; i += 8)                                                                              \
+    {                                                                                                           \
+        __m512i l_value = _mm512_loadu_si512((const void *)(l_operand + i));                                    \
+        __m512i r_value = _mm512_loadu_si512((const void *)(r_operand + i));                                    \
+        _mm512_storeu_si512((void *)(solution + i), (expression));                                              \
+    }                                                                                                           \
+    scalar(l_operand + i, r_operand + i, count - i, solution + i, sign + i, result + i);                        \
+}
+
+UNSIGNED_KERNEL_AVX512(and_kernel_avx512, and_kernel, _mm512_and_si512(l_value, r_value))
+UNSIGNED_KERNEL_AVX512(or_kernel_avx512, or_kernel, _mm512_or_si512(l_value, r_value))
+UNSIGNED_KERNEL_AVX512(xor_kernel_avx512, xor_kernel, _mm512_xor_si512(l_value, r_value))
+UNSIGNED_KERNEL_AVX512(s_left_kernel_avx512, s_left_kernel,
+                       _mm512_sllv_epi64(l_value, _mm512_and_si512(r_value, shift_mask)))
+UNSIGNED_KERNEL_AVX512(s_right_kernel_avx512, s_right_kernel,
+                       _mm512_srlv_epi64(l_value, _mm512_min_epu64(r_value, shift_mask)))
+UNSIGNED_KERNEL_AVX512(r_left_kernel_avx512, r_left_kernel, _mm512_rolv_epi64(l_value, r_value))
+UNSIGNED_KERNEL_AVX512(r_right_kernel_avx512, r_right_kernel, _mm512_rorv_epi64(l_value, r_value))
+#endif // END __x86_64__
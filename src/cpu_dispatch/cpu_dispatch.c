@@ -0,0 +1,116 @@
+#include <cpu_dispatch.h>
+#include <stdlib.h>
+#include <string.h>
+#include <threads.h>
+#include <utils.h>
+
+DEBUG_STATIC isa_level_t choose_isa_level(const char * forced, isa_level_t widest);
+static isa_level_t get_widest_level(void);
+static void select_level(void);
+
+// Indexed by isa_level_t. These are also the names NETCALC_FORCE_ISA accepts
+static const char * const isa_names[ISA_COUNT] = {
+    [ISA_SCALAR]    = "scalar",
+    [ISA_AVX2]      = "avx2",
+    [ISA_AVX512]    = "avx512",
+};
+
+static once_flag level_once = ONCE_FLAG_INIT;
+static isa_level_t level = ISA_SCALAR;
+
+/*!
+ * @brief Fetch the instruction set every module dispatches its kernels to.
+ * The level is picked once per process from the CPU features reported by
+ * cpuid, unless NETCALC_FORCE_ISA names a level to use instead, and the
+ * choice is logged.
+ * @return Instruction set level to use
+ */
+isa_level_t get_isa_level(void)
+{
+    call_once(&level_once, select_level);
+    return level;
+}
+
+/*!
+ * @brief Check if the CPU can run the kernels built for a level
+ * @param isa_level Instruction set level to check
+ * @return 1 if the level is supported else 0
+ */
+uint8_t isa_supported(isa_level_t isa_level)
+{
+    return (uint8_t)(isa_level <= get_widest_level());
+}
+
+/*!
+ * @brief Fetch the name of a level as printed in the logs
+ * @param isa_level Instruction set level
+ * @return Name of the level. The string must not be freed
+ */
+const char * get_isa_name(isa_level_t isa_level)
+{
+    if (isa_level >= ISA_COUNT)
+    {
+        return "unknown";
+    }
+    return isa_names[isa_level];
+}
+
+/*!
+ * @brief Pick the level to use from the level requested through
+ * NETCALC_FORCE_ISA and the widest level the CPU supports. A level that is
+ * unknown or unsupported is reported and the widest level is used instead.
+ * @param forced Value of NETCALC_FORCE_ISA or NULL if it is not set
+ * @param widest Widest level the CPU supports
+ * @return Level to use
+ */
+DEBUG_STATIC isa_level_t choose_isa_level(const char * forced, isa_level_t widest)
+{
+    if ((NULL == forced) || ('\0' == forced[0]))
+    {
+        return widest;
+    }
+
+    for (isa_level_t isa_level = ISA_SCALAR; isa_level < ISA_COUNT; isa_level++)
+    {
+        if (0 != strcmp(forced, isa_names[isa_level]))
+        {
+            continue;
+        }
+        if (isa_level > widest)
+        {
+            fprintf(stderr, "[DISPATCH] %s=%s is not supported by this CPU\n", ISA_FORCE_ENV, forced);
+            return widest;
+        }
+        return isa_level;
+    }
+
+    fprintf(stderr, "[DISPATCH] %s=%s is not one of scalar, avx2 or avx512\n", ISA_FORCE_ENV, forced);
+    return widest;
+}
+
+/*!
+ * @brief Find the widest level the CPU supports
+ */
+static isa_level_t get_widest_level(void)
+{
+#if defined(__x86_64__)
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx512f"))
+    {
+        return ISA_AVX512;
+    }
+    if (__builtin_cpu_supports("avx2"))
+    {
+        return ISA_AVX2;
+    }
+#endif // END __x86_64__
+    return ISA_SCALAR;
+}
+
+static void select_level(void)
+{
+    isa_level_t widest = get_widest_level();
+    level = choose_isa_level(getenv(ISA_FORCE_ENV), widest);
+    fprintf(stderr, "[DISPATCH] Using the %s kernels (widest supported is %s)\n",
+            get_isa_name(level), get_isa_name(widest));
+}
@@ -0,0 +1,151 @@
+#include <equ_map.h>
+#include <header_parser.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <utils.h>
+
+_Static_assert(sizeof(equ_header_view_t) == EQU_HEADER_SIZE,
+               "equ_header_view_t must match the EQU file header");
+_Static_assert(sizeof(unsolved_view_t) == UNSOLVED_EQU_SIZE,
+               "unsolved_view_t must match the unsolved equation format");
+
+static int8_t validate_header(const equ_header_view_t * header, size_t map_size);
+
+/*!
+ * @brief Map the unsolved EQU file behind the file descriptor read only and
+ * validate its header. The header and the records are handed back as views
+ * into the mapping so no bytes are copied and no equation nodes are built.
+ * The mapping stays valid after the file descriptor is closed.
+ * @param fd File descriptor of the EQU file
+ * @return Pointer to the map object or NULL if the file is invalid
+ */
+equ_map_t * equ_map_open(int fd)
+{
+    struct stat file_stat;
+    if (-1 == fstat(fd, &file_stat))
+    {
+        debug_print_err("[EQU MAP] Unable to stat fd: %s\n", strerror(errno));
+        return NULL;
+    }
+
+    size_t map_size = (size_t)file_stat.st_size;
+    if (map_size < EQU_HEADER_SIZE)
+    {
+        debug_print("[EQU MAP] File of %zu bytes is too small for a header\n", map_size);
+        return NULL;
+    }
+
+    void * mapping = mmap(NULL, map_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (MAP_FAILED == mapping)
+    {
+        debug_print_err("[EQU MAP] Unable to map fd: %s\n", strerror(errno));
+        return NULL;
+    }
+
+    // Records are consumed front to back so let the kernel read ahead
+    madvise(mapping, map_size, MADV_SEQUENTIAL);
+
+    const equ_header_view_t * header = (const equ_header_view_t *)mapping;
+    if (-1 == validate_header(header, map_size))
+    {
+        munmap(mapping, map_size);
+        return NULL;
+    }
+
+    equ_map_t * map = (equ_map_t *)malloc(sizeof(equ_map_t));
+    if (UV_INVALID_ALLOC == verify_alloc(map))
+    {
+        munmap(mapping, map_size);
+        return NULL;
+    }
+
+    *map = (equ_map_t) {
+        .map        = (const uint8_t *)mapping,
+        .map_size   = map_size,
+        .header     = header,
+        .records    = (const unsolved_view_t *)((const uint8_t *)mapping + header->offset),
+    };
+    return map;
+}
+
+/*!
+ * @brief Decode count records starting at record first into the columns of
+ * the batch. This lets a file of any size be solved in fixed size windows.
+ * @param map Pointer to the map object
+ * @param first Index of the first record to decode
+ * @param count Number of records to decode, must fit in the batch columns
+ * @param batch Batch to decode into. Its count is set to count
+ */
+void equ_map_load_batch(equ_map_t * map, uint64_t first, uint64_t count, equ_batch_t * batch)
+{
+    decode_unsolved_run((const uint8_t *)(map->records + first), count, batch, 0);
+    batch->count = count;
+}
+
+/*!
+ * @brief Drop the pages holding every record before record consumed from the
+ * resident set. The pages are read back from the page cache if touched again
+ * so this only trades memory for a possible re-fault.
+ * @param map Pointer to the map object
+ * @param consumed Number of records from the start that are no longer needed
+ */
+void equ_map_release(equ_map_t * map, uint64_t consumed)
+{
+    long page_size = sysconf(_SC_PAGESIZE);
+    if (page_size <= 0)
+    {
+        return;
+    }
+
+    size_t end = (size_t)((const uint8_t *)(map->records + consumed) - map->map);
+    end -= end % (size_t)page_size;
+    if (0 != end)
+    {
+        madvise((void *)map->map, end, MADV_DONTNEED);
+    }
+}
+
+/*!
+ * @brief Unmap the file and free the map object
+ * @param map Pointer to the map pointer which is set to NULL
+ */
+void equ_map_close(equ_map_t ** map)
+{
+    if ((NULL == map) || (NULL == *map))
+    {
+        return;
+    }
+    munmap((void *)(*map)->map, (*map)->map_size);
+    free(*map);
+    *map = NULL;
+}
+
+/*!
+ * @brief Validate the file header with the same checks as a streamed file
+ * and verify that the records it describes actually fit inside the mapped
+ * file
+ * @param header View of the file header
+ * @param map_size Size of the mapping in bytes
+ * @return 0 if valid else -1
+ */
+static int8_t validate_header(const equ_header_view_t * header, size_t map_size)
+{
+    equations_t eqs = {0};
+    decode_file_header((const uint8_t *)header, &eqs);
+    if (-1 == validate_file_header(&eqs))
+    {
+        return -1;
+    }
+
+    if ((eqs.offset > map_size) || (eqs.number_of_eq > ((map_size - eqs.offset) / UNSOLVED_EQU_SIZE)))
+    {
+        debug_print("[EQU MAP] %lu equations at offset %u do not fit in %zu bytes\n",
+                    eqs.number_of_eq, eqs.offset, map_size);
+        return -1;
+    }
+    return 0;
+}
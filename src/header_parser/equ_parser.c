@@ -0,0 +1,322 @@
+#include <equ_parser.h>
+#include <stdlib.h>
+#include <string.h>
+#include <utils.h>
+
+struct equ_parser_t
+{
+    equ_parser_state_t state;
+    net_header_t * header;
+    equations_t * eqs;
+    uint64_t records_parsed;    // Records decoded into the batch so far
+    uint64_t skip_remaining;    // Bytes of optional headers left to discard
+    size_t staged;              // Bytes of a split section held in stage
+    uint8_t stage[NET_MAX_HEADER_SIZE];
+};
+
+static const uint8_t * next_section(equ_parser_t * parser,
+                                    const uint8_t ** data,
+                                    size_t * remaining,
+                                    size_t section_size);
+static equ_parser_state_t accept_net_header(equ_parser_t * parser, const uint8_t * section);
+static equ_parser_state_t accept_file_header(equ_parser_t * parser, const uint8_t * section);
+static equ_parser_state_t records_or_done(equ_parser_t * parser);
+
+/*!
+ * @brief Create a parser waiting for the network header of an upload
+ * @return Pointer to the parser or NULL if unable to allocate memory
+ */
+equ_parser_t * equ_parser_init(void)
+{
+    equ_parser_t * parser = (equ_parser_t *)calloc(1, sizeof(equ_parser_t));
+    if (UV_INVALID_ALLOC == verify_alloc(parser))
+    {
+        return NULL;
+    }
+
+    parser->header = (net_header_t *)calloc(1, sizeof(net_header_t));
+    if (UV_INVALID_ALLOC == verify_alloc(parser->header))
+    {
+        free(parser);
+        return NULL;
+    }
+
+    parser->state = EP_STATE_NET_HEADER;
+    return parser;
+}
+
+/*!
+ * @brief Advance the parser with the bytes that have arrived so far. The bytes
+ * can be split at any position; sections cut in half are staged internally
+ * until the rest arrives. Whole records are decoded straight from data.
+ *
+ * @param parser Pointer to the parser object
+ * @param data Bytes received
+ * @param data_size Number of bytes received
+ * @param consumed Set to the number of bytes used from data. This is only
+ * less than data_size when the upload completed before the end of data
+ * @return EP_NEED_MORE if everything was consumed without completing the
+ * upload, EP_COMPLETE once every record is parsed or EP_ERROR if malformed
+ */
+equ_parser_status_t equ_parser_feed(equ_parser_t * parser,
+                                    const uint8_t * data,
+                                    size_t data_size,
+                                    size_t * consumed)
+{
+    size_t remaining = data_size;
+    const uint8_t * section = NULL;
+
+    while ((EP_STATE_DONE != parser->state) && (EP_STATE_ERROR != parser->state))
+    {
+        if (EP_STATE_RECORDS == parser->state)
+        {
+            equations_t * eqs = parser->eqs;
+
+            // The batch only grows once more bytes arrive for a full batch
+            if (parser->records_parsed == eqs->batch->count)
+            {
+                if (0 == remaining)
+                {
+                    break;
+                }
+                if (-1 == grow_equation_batch(eqs))
+                {
+                    parser->state = EP_STATE_ERROR;
+                    break;
+                }
+            }
+
+            // Decode every whole record directly from the callers bytes
+            if (0 == parser->staged)
+            {
+                uint64_t whole = remaining / UNSOLVED_EQU_SIZE;
+                if (whole > (eqs->batch->count - parser->records_parsed))
+                {
+                    whole = eqs->batch->count - parser->records_parsed;
+                }
+                decode_unsolved_run(data, whole, eqs->batch, parser->records_parsed);
+                parser->records_parsed += whole;
+                data += whole * UNSOLVED_EQU_SIZE;
+                remaining -= (size_t)(whole * UNSOLVED_EQU_SIZE);
+                if (parser->records_parsed == eqs->batch->count)
+                {
+                    parser->state = records_or_done(parser);
+                    continue;
+                }
+            }
+
+            if (parser->records_parsed < eqs->number_of_eq)
+            {
+                section = next_section(parser, &data, &remaining, UNSOLVED_EQU_SIZE);
+                if (NULL == section)
+                {
+                    break;
+                }
+                decode_unsolved_run(section, 1, eqs->batch, parser->records_parsed);
+                parser->records_parsed++;
+            }
+            parser->state = records_or_done(parser);
+            continue;
+        }
+
+        if (EP_STATE_OPT_HEADERS == parser->state)
+        {
+            size_t skip = (parser->skip_remaining < remaining) ? (size_t)parser->skip_remaining : remaining;
+            parser->skip_remaining -= skip;
+            data += skip;
+            remaining -= skip;
+            if (0 != parser->skip_remaining)
+            {
+                break;
+            }
+            parser->state = records_or_done(parser);
+            continue;
+        }
+
+        size_t section_size = (EP_STATE_NET_HEADER == parser->state) ? NET_MAX_HEADER_SIZE : EQU_HEADER_SIZE;
+        section = next_section(parser, &data, &remaining, section_size);
+        if (NULL == section)
+        {
+            break;
+        }
+
+        parser->state = (EP_STATE_NET_HEADER == parser->state)
+                        ? accept_net_header(parser, section)
+                        : accept_file_header(parser, section);
+    }
+
+    if (NULL != consumed)
+    {
+        *consumed = data_size - remaining;
+    }
+
+    switch (parser->state)
+    {
+        case EP_STATE_DONE:
+            return EP_COMPLETE;
+        case EP_STATE_ERROR:
+            return EP_ERROR;
+        default:
+            return EP_NEED_MORE;
+    }
+}
+
+/*!
+ * @brief Fetch the section of the upload the parser is currently in
+ * @param parser Pointer to the parser object
+ * @return Current state
+ */
+equ_parser_state_t equ_parser_state(equ_parser_t * parser)
+{
+    return parser->state;
+}
+
+/*!
+ * @brief Take ownership of the network header. It is filled in as soon as the
+ * first NET_MAX_HEADER_SIZE bytes have been fed, which lets the caller build
+ * an error reply even if a later section was malformed.
+ * @param parser Pointer to the parser object
+ * @return Pointer to the header which must be freed with free_header or NULL
+ * if it was already taken
+ */
+net_header_t * equ_parser_take_header(equ_parser_t * parser)
+{
+    net_header_t * header = parser->header;
+    parser->header = NULL;
+    return header;
+}
+
+/*!
+ * @brief Take ownership of the parsed equations once the parser completed
+ * @param parser Pointer to the parser object
+ * @return Pointer to the equations which must be freed with free_equation or
+ * NULL if the upload is not complete or they were already taken
+ */
+equations_t * equ_parser_take_equations(equ_parser_t * parser)
+{
+    if (EP_STATE_DONE != parser->state)
+    {
+        return NULL;
+    }
+    equations_t * eqs = parser->eqs;
+    parser->eqs = NULL;
+    return eqs;
+}
+
+/*!
+ * @brief Free the parser and anything it still owns
+ * @param parser Pointer to the parser pointer which is set to NULL
+ */
+void equ_parser_destroy(equ_parser_t ** parser)
+{
+    if ((NULL == parser) || (NULL == *parser))
+    {
+        return;
+    }
+    if (NULL != (*parser)->header)
+    {
+        free_header((*parser)->header);
+    }
+    if (NULL != (*parser)->eqs)
+    {
+        free_equation((*parser)->eqs);
+    }
+    free(*parser);
+    *parser = NULL;
+}
+
+/*!
+ * @brief Return a pointer to the next section_size bytes of the upload. If the
+ * section is whole within data the pointer points into data, otherwise the
+ * available bytes are moved into the stage until the section is complete.
+ * @param parser Pointer to the parser object
+ * @param data Pointer to the callers data, advanced past the used bytes
+ * @param remaining Number of bytes left in data, reduced by the used bytes
+ * @param section_size Size of the section to fetch
+ * @return Pointer to section_size bytes or NULL if all of data was staged
+ */
+static const uint8_t * next_section(equ_parser_t * parser,
+                                    const uint8_t ** data,
+                                    size_t * remaining,
+                                    size_t section_size)
+{
+    const uint8_t * section = NULL;
+    if ((0 == parser->staged) && (*remaining >= section_size))
+    {
+        section = *data;
+        *data += section_size;
+        *remaining -= section_size;
+        return section;
+    }
+
+    size_t needed = section_size - parser->staged;
+    size_t chunk = (needed < *remaining) ? needed : *remaining;
+    memcpy(parser->stage + parser->staged, *data, chunk);
+    parser->staged += chunk;
+    *data += chunk;
+    *remaining -= chunk;
+
+    if (parser->staged < section_size)
+    {
+        return NULL;
+    }
+    parser->staged = 0;
+    return parser->stage;
+}
+
+static equ_parser_state_t accept_net_header(equ_parser_t * parser, const uint8_t * section)
+{
+    net_header_t * header = parser->header;
+    decode_net_header(section, header);
+
+    if (NET_MAX_HEADER_SIZE != header->header_size)
+    {
+        debug_print("[EQU PARSER] Header size does not match the expected "
+                    "value of %d. Read %u instead\n", NET_MAX_HEADER_SIZE,
+                    header->header_size);
+        return EP_STATE_ERROR;
+    }
+
+    if (header->name_len > NET_MAX_FILE_NAME)
+    {
+        debug_print("[EQU PARSER] File name length exceeds the size limit "
+                    "of %d. The length is set to %d\n", NET_MAX_FILE_NAME,
+                    header->name_len);
+        return EP_STATE_ERROR;
+    }
+    return EP_STATE_FILE_HEADER;
+}
+
+static equ_parser_state_t accept_file_header(equ_parser_t * parser, const uint8_t * section)
+{
+    equations_t * eqs = (equations_t *)calloc(1, sizeof(equations_t));
+    if (UV_INVALID_ALLOC == verify_alloc(eqs))
+    {
+        return EP_STATE_ERROR;
+    }
+    parser->eqs = eqs;
+    decode_file_header(section, eqs);
+
+    if (-1 == validate_file_header(eqs))
+    {
+        return EP_STATE_ERROR;
+    }
+
+    // Everything between the file header and the offset belongs to the
+    // optional headers which are discarded as they arrive
+    parser->skip_remaining = eqs->offset - EQU_HEADER_SIZE;
+
+    // The batch starts small and grows as the records arrive, so a header
+    // announcing more records than are sent costs no more than what was sent
+    if (-1 == grow_equation_batch(eqs))
+    {
+        return EP_STATE_ERROR;
+    }
+
+    return (0 != parser->skip_remaining) ? EP_STATE_OPT_HEADERS : records_or_done(parser);
+}
+
+static equ_parser_state_t records_or_done(equ_parser_t * parser)
+{
+    return (parser->records_parsed < parser->eqs->number_of_eq) ? EP_STATE_RECORDS : EP_STATE_DONE;
+}
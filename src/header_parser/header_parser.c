@@ -1,55 +1,30 @@
 #include <header_parser.h>
 #include <stdio.h>
-#include <unistd.h>
 #include <stdlib.h>
 #include <utils.h>
 #include <calculation.h>
 #include <arpa/inet.h>
-#include <errno.h>
 #include <string.h>
-#include <stdbool.h>
-
-static int8_t read_stream(int fd, void * payload, void (free_func(void *)), void * caller_buffer, size_t bytes_to_read);
 
 /*!
- * Read from the provided file descriptor the network header
- * @param fd File descriptor to read from
+ * Read from the provided connection reader the network header
+ * @param reader Buffered reader of the connection to read from
  * @return net_header_t object if valid read else NULL
  */
-net_header_t * read_header(int fd)
+net_header_t * read_header(stream_reader_t * reader)
 {
-    net_header_t * header = (net_header_t *)calloc(1, sizeof(net_header_t));
-    if (UV_INVALID_ALLOC == verify_alloc((header)))
-    {
-        return NULL;
-    }
-
-    int res = read_stream(fd, header,(void (*)(void *))free_header, &header->header_size, NET_HEADER_SIZE);
-    if (-1 == res)
+    uint8_t section[NET_MAX_HEADER_SIZE];
+    if (-1 == stream_reader_read(reader, section, NET_MAX_HEADER_SIZE))
     {
         return NULL;
     }
-    header->header_size = ntohl(header->header_size);
 
-    res = read_stream(fd, header,(void (*)(void *))free_header, &header->name_len, NET_FILE_NAME_LEN);
-    if (-1 == res)
-    {
-        return NULL;
-    }
-    header->name_len = ntohl(header->name_len);
-
-    res = read_stream(fd, header,(void (*)(void *))free_header, &header->total_payload_size, NET_TOTAL_PACKET_SIZE);
-    if (-1 == res)
-    {
-        return NULL;
-    }
-    header->total_payload_size = swap_byte_order(header->total_payload_size);
-
-    res = read_stream(fd, header,(void (*)(void *))free_header, &header->file_name, NET_FILE_NAME);
-    if (-1 == res)
+    net_header_t * header = (net_header_t *)calloc(1, sizeof(net_header_t));
+    if (UV_INVALID_ALLOC == verify_alloc((header)))
     {
         return NULL;
     }
+    decode_net_header(section, header);
 
     return header;
 }
@@ -68,211 +43,359 @@ uint64_t swap_byte_order(uint64_t val)
 }
 
 /*!
- * @brief Sequentially read the stream of bytes and fill the structs associated
- * with each section. If the read bytes does not match the amount required, free
- * the structure and return NULL;
- * @param fd File descriptor to read from
- * @return Pointer to the solution_t object
+ * @brief Decode a complete network header from a buffer of at least
+ * NET_MAX_HEADER_SIZE bytes, converting the fields to host byte order
+ * @param buffer Bytes of the network header as received
+ * @param header Header object to fill
+ */
+void decode_net_header(const uint8_t * buffer, net_header_t * header)
+{
+    size_t offset = 0;
+
+    memcpy(&header->header_size, buffer + offset, NET_HEADER_SIZE);
+    header->header_size = ntohl(header->header_size);
+    offset += NET_HEADER_SIZE;
+
+    memcpy(&header->name_len, buffer + offset, NET_FILE_NAME_LEN);
+    header->name_len = ntohl(header->name_len);
+    offset += NET_FILE_NAME_LEN;
+
+    memcpy(&header->total_payload_size, buffer + offset, NET_TOTAL_PACKET_SIZE);
+    header->total_payload_size = swap_byte_order(header->total_payload_size);
+    offset += NET_TOTAL_PACKET_SIZE;
+
+    memcpy(&header->file_name, buffer + offset, NET_FILE_NAME);
+}
+
+/*!
+ * @brief Decode a complete EQU file header from a buffer of at least
+ * EQU_HEADER_SIZE bytes. The batch of the equations object is not touched.
+ * @param buffer Bytes of the file header as received
+ * @param eqs Equations object to fill
+ */
+void decode_file_header(const uint8_t * buffer, equations_t * eqs)
+{
+    size_t offset = 0;
+
+    memcpy(&eqs->magic_id, buffer + offset, HEAD_MAGIC);
+    offset += HEAD_MAGIC;
+    memcpy(&eqs->file_id, buffer + offset, HEAD_FILEID);
+    offset += HEAD_FILEID;
+    memcpy(&eqs->number_of_eq, buffer + offset, HEAD_NUM_OF_EQU);
+    offset += HEAD_NUM_OF_EQU;
+    eqs->flags = buffer[offset];
+    offset += HEAD_FLAGS;
+    memcpy(&eqs->offset, buffer + offset, HEAD_EQU_OFFSET);
+    offset += HEAD_EQU_OFFSET;
+    memcpy(&eqs->num_of_opts, buffer + offset, HEAD_NUM_OF_OPT_HEADERS);
+}
+
+/*!
+ * @brief Decode a complete unsolved record from a buffer of at least
+ * UNSOLVED_EQU_SIZE bytes into slot index of the batch columns
+ * @param buffer Bytes of the unsolved record as received
+ * @param batch Batch to write the equation to
+ * @param index Index of the equation in the batch
+ */
+void decode_unsolved(const uint8_t * buffer, equ_batch_t * batch, uint64_t index)
+{
+    size_t offset = 0;
+
+    memcpy(&batch->eq_id[index], buffer + offset, UNSO_EQU_ID);
+    offset += UNSO_EQU_ID;
+    batch->flags[index] = buffer[offset];
+    offset += UNSO_FLAGS;
+    memcpy(&batch->l_operand[index], buffer + offset, L_OPERAND);
+    offset += L_OPERAND;
+    batch->opt[index] = buffer[offset];
+    offset += OPERATOR;
+    memcpy(&batch->r_operand[index], buffer + offset, R_OPERAND);
+}
+
+/*!
+ * @brief Read the file header and every unsolved record from the stream and
+ * fill the equations object with them. The optional headers up to the offset
+ * are discarded and the records are decoded at fixed UNSOLVED_EQU_SIZE strides
+ * straight out of the reader's buffer, padding included. If the stream ends
+ * early or the header is invalid, free the structure and return NULL.
+ * @param reader Buffered reader of the connection to read from
+ * @return Pointer to the equations object or NULL
  */
-equations_t * parse_stream(int fd)
+equations_t * parse_stream(stream_reader_t * reader)
 {
-    uint32_t magic_field = 0;
-    read(fd, &magic_field, HEAD_MAGIC);
-    if (MAGIC_VALUE != magic_field)
+    equations_t * eqs = parse_file_header(reader);
+    if (NULL == eqs)
     {
         return NULL;
     }
 
-    equations_t * eqs = (equations_t *)calloc(1, sizeof(equations_t));
-    if (UV_INVALID_ALLOC == verify_alloc(eqs))
+    // The count comes from the client, so the batch grows as the records are
+    // read instead of being allocated for the whole count up front
+    uint64_t parsed = 0;
+    do
     {
-        return NULL;
+        if ((-1 == grow_equation_batch(eqs))
+            || (-1 == parse_records(reader, eqs->batch, parsed, eqs->batch->count - parsed)))
+        {
+            free_equation(eqs);
+            return NULL;
+        }
+        parsed = eqs->batch->count;
+    } while (parsed < eqs->number_of_eq);
+    return eqs;
+}
+
+/*!
+ * @brief Make room in the batch of the equations object for the next records
+ * of the file. A missing batch is allocated with room for BATCH_START_SIZE
+ * equations and an existing one doubles, neither past number_of_eq. The count
+ * in the file header is sent by the client, so memory is only committed for
+ * records that actually arrive.
+ * @param eqs Equations object holding the file header
+ * @return 0 if the batch grew, -1 if unable to allocate memory
+ */
+int8_t grow_equation_batch(equations_t * eqs)
+{
+    uint64_t count = (NULL == eqs->batch) ? BATCH_START_SIZE : (eqs->batch->count * 2);
+    if (count > eqs->number_of_eq)
+    {
+        count = eqs->number_of_eq;
     }
-    eqs->magic_id = magic_field;
 
-    int res = read_stream(fd, eqs,(void (*)(void *))free_equation, &eqs->file_id, HEAD_FILEID);
-    if (-1 == res)
+    equ_batch_t * batch = (NULL == eqs->batch) ? get_equation_batch(count)
+                                               : resize_equation_batch(eqs->batch, count);
+    if (NULL == batch)
     {
-        return NULL;
+        return -1;
     }
+    eqs->batch = batch;
+    return 0;
+}
 
-    res = read_stream(fd, eqs, (void (*)(void*))free_equation, &eqs->number_of_eq, HEAD_NUM_OF_EQU);
-    if (-1 == res)
+/*!
+ * @brief Read and validate the file header and discard the optional headers
+ * that follow it. The stream is left at the first unsolved record and the
+ * batch of the returned object is left NULL for the caller to fill with
+ * parse_records.
+ * @param reader Buffered reader of the connection to read from
+ * @return Pointer to the equations object or NULL if the stream ended early
+ * or the header is invalid
+ */
+equations_t * parse_file_header(stream_reader_t * reader)
+{
+    uint8_t section[EQU_HEADER_SIZE];
+    if (-1 == stream_reader_read(reader, section, EQU_HEADER_SIZE))
     {
         return NULL;
     }
 
-    res = read_stream(fd, eqs, (void (*)(void*))free_equation, &eqs->flags, HEAD_FLAGS);
-    if (-1 == res)
+    equations_t * eqs = (equations_t *)calloc(1, sizeof(equations_t));
+    if (UV_INVALID_ALLOC == verify_alloc(eqs))
     {
         return NULL;
     }
+    decode_file_header(section, eqs);
 
-    res = read_stream(fd, eqs, (void (*)(void*))free_equation, &eqs->offset, HEAD_EQU_OFFSET);
-    if (-1 == res)
+    if (-1 == validate_file_header(eqs))
     {
+        free_equation(eqs);
         return NULL;
     }
 
-    res = read_stream(fd, eqs, (void (*)(void*))free_equation, &eqs->num_of_opts, HEAD_NUM_OF_OPT_HEADERS);
-    if (-1 == res)
+    // The optional headers sit between the file header and the offset
+    if (-1 == stream_reader_skip(reader, eqs->offset - EQU_HEADER_SIZE))
     {
+        free_equation(eqs);
         return NULL;
     }
+    return eqs;
+}
 
-    for (int i = 0; i < eqs->number_of_eq; i++)
+/*!
+ * @brief Decode the next count unsolved records of the stream into the batch
+ * starting at slot index. Whole records are decoded straight out of the
+ * reader's buffer and a record split across a refill is copied out first.
+ * @param reader Buffered reader positioned at an unsolved record
+ * @param batch Batch with room for index + count equations
+ * @param index Slot of the batch to write the first record to
+ * @param count Number of records to decode
+ * @return 0 if every record was decoded, -1 if the stream ended early
+ */
+int8_t parse_records(stream_reader_t * reader, equ_batch_t * batch, uint64_t index, uint64_t count)
+{
+    uint64_t parsed = 0;
+    uint64_t malformed = 0;
+    while (parsed < count)
     {
-        // Create the un_eq structure
-        unsolved_eq_t * un_eq = (unsolved_eq_t *)calloc(1, sizeof(unsolved_eq_t));
-        if (UV_INVALID_ALLOC == verify_alloc(un_eq))
-        {
-            free_equation(eqs);
-            return NULL;
-        }
-
-        // Attach the un_eq structure to the solution_t structure at the tail
-        if (NULL == eqs->tail)
-        {
-            eqs->eqs = un_eq;
-            eqs->tail = un_eq;
-        }
-        else
+        size_t available = 0;
+        const uint8_t * records = stream_reader_peek(reader, &available);
+        if (NULL == records)
         {
-            eqs->tail->next = un_eq;
-            eqs->tail = un_eq;
+            return -1;
         }
 
-
-        // Read from the stream all the sections for an unsolved equation
-        res = read_stream(fd, eqs, (void (*)(void*))free_equation, &un_eq->eq_id, UNSO_EQU_ID);
-        if (-1 == res)
+        // Decode every whole record sitting in the buffer in one pass
+        uint64_t whole = available / UNSOLVED_EQU_SIZE;
+        if (whole > (count - parsed))
         {
-            return NULL;
+            whole = count - parsed;
         }
+        malformed += decode_unsolved_run(records, whole, batch, index + parsed);
+        stream_reader_consume(reader, whole * UNSOLVED_EQU_SIZE);
+        parsed += whole;
 
-        res = read_stream(fd, eqs, (void (*)(void*))free_equation, &un_eq->flags, UNSO_FLAGS);
-        if (-1 == res)
+        // A record split across the end of the buffer is copied out whole
+        if ((0 == whole) && (parsed < count))
         {
-            return NULL;
+            uint8_t record[UNSOLVED_EQU_SIZE];
+            if (-1 == stream_reader_read(reader, record, UNSOLVED_EQU_SIZE))
+            {
+                return -1;
+            }
+            malformed += decode_unsolved_run(record, 1, batch, index + parsed);
+            parsed++;
         }
+    }
 
-        res = read_stream(fd, eqs, (void (*)(void*))free_equation, &un_eq->l_operand, L_OPERAND);
-        if (-1 == res)
-        {
-            return NULL;
-        }
+    if (malformed > 0)
+    {
+        debug_print("[PARSE STREAM] %lu records with an unknown operator or non-zero padding\n", malformed);
+    }
+    return 0;
+}
 
-        res = read_stream(fd, eqs, (void (*)(void*))free_equation, &un_eq->opt, OPERATOR);
-        if (-1 == res)
-        {
-            return NULL;
-        }
+/*!
+ * @brief Check the file header for a valid magic value, an offset that
+ * leaves room for the optional headers counted in num_of_opts and an equation
+ * count whose reply size can be represented
+ * @param eqs Equations object holding the decoded file header
+ * @return 0 if valid else -1
+ */
+int8_t validate_file_header(equations_t * eqs)
+{
+    if (MAGIC_VALUE != eqs->magic_id)
+    {
+        debug_print("[PARSER] Invalid magic value %#x\n", eqs->magic_id);
+        return -1;
+    }
 
-        res = read_stream(fd, eqs, (void (*)(void*))free_equation, &un_eq->r_operand, R_OPERAND);
-        if (-1 == res)
-        {
-            return NULL;
-        }
+    if ((eqs->offset < EQU_HEADER_SIZE) || ((0 != eqs->num_of_opts) && (EQU_HEADER_SIZE == eqs->offset)))
+    {
+        debug_print("[PARSER] Offset %u does not fit %u optional headers\n",
+                    eqs->offset, eqs->num_of_opts);
+        return -1;
+    }
 
-        // The last 10 bytes are just padding, use lseek to move the position
-        lseek(fd, UNSO_PADDING, SEEK_CUR);
+    // The size of the reply, net header included, has to fit its u64 field
+    uint64_t max_equations = (UINT64_MAX - NET_MAX_HEADER_SIZE - eqs->offset) / SOLVED_EQU_SIZE;
+    if (eqs->number_of_eq > max_equations)
+    {
+        debug_print("[PARSER] Number of equations %lu is too large to reply to\n",
+                    eqs->number_of_eq);
+        return -1;
     }
+    return 0;
+}
 
-    return eqs;
+/*!
+ * @brief Calculate the number of bytes the solved file for the equations
+ * takes once serialized. The solved records start at the same offset the
+ * unsolved records did.
+ * @param eqs Pointer to the equations object
+ * @return Size of the solved file in bytes
+ */
+uint64_t get_solved_size(equations_t * eqs)
+{
+    uint64_t header_size = (eqs->offset > EQU_HEADER_SIZE) ? eqs->offset : EQU_HEADER_SIZE;
+    return header_size + (eqs->number_of_eq * SOLVED_EQU_SIZE);
 }
 
-void free_equation(equations_t * eq)
+/*!
+ * @brief Serialize the file header of the solved file into the buffer. The
+ * header is the same as the unsolved header with the solved flag set. Any
+ * bytes between the end of the header and the offset are zero filled.
+ * @param eqs Pointer to the equations object
+ * @param buffer Buffer to write to
+ * @param buffer_size Size of the buffer
+ * @return Number of bytes written or 0 if the buffer is too small
+ */
+size_t serialize_file_header(equations_t * eqs, uint8_t * buffer, size_t buffer_size)
 {
-    if (NULL != eq->eqs)
+    size_t header_size = (eqs->offset > EQU_HEADER_SIZE) ? eqs->offset : EQU_HEADER_SIZE;
+    if (buffer_size < header_size)
     {
-        unsolved_eq_t * eqs = eq->eqs;
-        void * free_tmp;
-        while (NULL != eqs)
-        {
-            // Free the result if there is one defined
-            if (NULL != eqs->solution)
-            {
-                free_equation_struct(eqs->solution);
-            }
-            free_tmp = eqs;
-            eqs = eqs->next;
-            free(free_tmp);
-        }
+        return 0;
     }
-    free(eq);
+    memset(buffer, 0, header_size);
+    encode_file_header(eqs, buffer);
+    return header_size;
 }
 
-void free_header(net_header_t * header)
+/*!
+ * @brief Encode the EQU_HEADER_SIZE bytes of the solved file header with the
+ * solved flag set. Unlike serialize_file_header the zero fill up to the
+ * offset is left to the caller.
+ * @param eqs Pointer to the equations object
+ * @param buffer Buffer of at least EQU_HEADER_SIZE bytes to write to
+ */
+void encode_file_header(equations_t * eqs, uint8_t * buffer)
 {
-    free(header);
+    size_t offset = 0;
+    uint8_t flags = eqs->flags | SOLVED_VAL;
+
+    memcpy(buffer + offset, &eqs->magic_id, HEAD_MAGIC);
+    offset += HEAD_MAGIC;
+    memcpy(buffer + offset, &eqs->file_id, HEAD_FILEID);
+    offset += HEAD_FILEID;
+    memcpy(buffer + offset, &eqs->number_of_eq, HEAD_NUM_OF_EQU);
+    offset += HEAD_NUM_OF_EQU;
+    buffer[offset] = flags;
+    offset += HEAD_FLAGS;
+    memcpy(buffer + offset, &eqs->offset, HEAD_EQU_OFFSET);
+    offset += HEAD_EQU_OFFSET;
+    memcpy(buffer + offset, &eqs->num_of_opts, HEAD_NUM_OF_OPT_HEADERS);
 }
 
 /*!
- * @brief Function repeatedly reads from the file descriptor passed in and
- * writes the data read into the buffer provided
- * @param fd File descriptor read
- * @param eq Equation structure object
- * @param caller_buffer Buffer to write the read data to
- * @param bytes_to_read Number of bytes to read from the file descriptor
- * @return 0 if read was successful, -1 if invalid. Free eq if invalid before
- * returning
+ * @brief Serialize the solved records of every equation in the batch into
+ * the buffer. Equations that failed have their solved flag cleared.
+ * @param batch Pointer to the batch of solved equations
+ * @param buffer Buffer to write to
+ * @param buffer_size Size of the buffer
+ * @return Number of bytes written or 0 if the buffer is too small
  */
-static int8_t read_stream(int fd, void * payload, void (free_func(void *)), void * caller_buffer, size_t bytes_to_read)
+size_t serialize_solutions(equ_batch_t * batch, uint8_t * buffer, size_t buffer_size)
 {
-    ssize_t read_bytes;
-    ssize_t total_bytes_read = 0;
-
-    // Buffer will be used to read from the file descriptor
-    uint8_t * read_buffer = (uint8_t *)calloc(1, bytes_to_read + 1);
-    uint8_t * payload_buffer = (uint8_t *)calloc(1, bytes_to_read + 1);
-    if (UV_INVALID_ALLOC == verify_alloc(read_buffer))
+    if (buffer_size / SOLVED_EQU_SIZE < batch->count)
     {
-        debug_print_err("%s\n", "Unable to allocate memory for read_buffer");
-        free_func(payload);
-        return -1;
+        return 0;
     }
 
-    bool keep_reading = true;
-    while (keep_reading)
+    size_t offset = 0;
+    for (uint64_t i = 0; i < batch->count; i++)
     {
-        read_bytes = read(fd, read_buffer, 1);
-        if (-1 == read_bytes)
-        {
-            // If timed out, display message indicating that it timed out
-            if ((EAGAIN == errno) || (EWOULDBLOCK == errno))
-            {
-                debug_print("%s\n", "[STREAM READ] Read timed out");
-            }
-            else
-            {
-                debug_print_err("[STREAM READ] Unable to read from fd: %s\n", strerror(errno));
-            }
-            free_func(payload);
-            return -1;
-        }
-        else if (0 == read_bytes)
-        {
-            debug_print_err("%s\n", "[STREAM READ] Read zero bytes. Client likely closed connection.");
-            free_func(payload);
-            return -1;
-        }
-
-        // Use string operations to concatenate the final payload buffer
-        memcpy(payload_buffer + total_bytes_read, read_buffer, (unsigned long)read_bytes);
-        total_bytes_read = total_bytes_read + read_bytes;
-
-        if (total_bytes_read == bytes_to_read)
-        {
-            keep_reading = false;
-        }
+        uint8_t flags = (EQ_SOLVED == batch->result[i]) ? SOLVED_VAL : UNSOLVED_VAL;
+        uint8_t type = (EQ_VAL_SIGNED == batch->sign[i]) ? SIGNED_OUTPUT : UNSIGNED_OUTPUT;
+
+        memcpy(buffer + offset, &batch->eq_id[i], SO_EQU_ID);
+        offset += SO_EQU_ID;
+        buffer[offset] = flags;
+        offset += SO_EQU_FLAGS;
+        buffer[offset] = type;
+        offset += SO_EQU_TYPE;
+        memcpy(buffer + offset, &batch->solution[i], SO_EQU_SOLUTION);
+        offset += SO_EQU_SOLUTION;
     }
+    return offset;
+}
 
-    // Copy the data read into the callers buffer
-    memcpy(caller_buffer, payload_buffer, bytes_to_read);
-
-    // Free the working buffers
-    free(read_buffer);
-    free(payload_buffer);
+void free_equation(equations_t * eq)
+{
+    free_equation_batch(eq->batch);
+    free(eq);
+}
 
-    return 0;
+void free_header(net_header_t * header)
+{
+    free(header);
 }
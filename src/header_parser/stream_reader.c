@@ -0,0 +1,176 @@
+#include <stream_reader.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <utils.h>
+
+struct stream_reader_t
+{
+    int fd;
+    size_t capacity;    // Size of the buffer
+    size_t start;       // Index of the next unconsumed byte
+    size_t end;         // Index one past the last byte read from the fd
+    uint8_t buffer[];
+};
+
+static int8_t fill_buffer(stream_reader_t * reader);
+
+/*!
+ * @brief Create a buffered reader for the file descriptor provided. The
+ * reader does not take ownership of the file descriptor.
+ * @param fd File descriptor to read from
+ * @param capacity Number of bytes to request from the fd with each read
+ * @return Pointer to the reader or NULL if unable to allocate memory
+ */
+stream_reader_t * stream_reader_init(int fd, size_t capacity)
+{
+    if (0 == capacity)
+    {
+        capacity = SR_DEFAULT_CAPACITY;
+    }
+
+    stream_reader_t * reader = (stream_reader_t *)malloc(sizeof(stream_reader_t) + capacity);
+    if (UV_INVALID_ALLOC == verify_alloc(reader))
+    {
+        return NULL;
+    }
+
+    reader->fd = fd;
+    reader->capacity = capacity;
+    reader->start = 0;
+    reader->end = 0;
+    return reader;
+}
+
+/*!
+ * @brief Copy the next bytes_to_read bytes of the stream into the callers
+ * buffer. The fd is only read from when the buffered bytes run out.
+ * @param reader Pointer to the reader object
+ * @param caller_buffer Buffer to write the read data to
+ * @param bytes_to_read Number of bytes to copy
+ * @return 0 if read was successful, -1 if the fd timed out, errored or was
+ * closed before enough bytes arrived
+ */
+int8_t stream_reader_read(stream_reader_t * reader, void * caller_buffer, size_t bytes_to_read)
+{
+    uint8_t * dest = (uint8_t *)caller_buffer;
+    while (bytes_to_read > 0)
+    {
+        if ((reader->start == reader->end) && (-1 == fill_buffer(reader)))
+        {
+            return -1;
+        }
+
+        size_t available = reader->end - reader->start;
+        size_t chunk = (available < bytes_to_read) ? available : bytes_to_read;
+        memcpy(dest, reader->buffer + reader->start, chunk);
+
+        reader->start += chunk;
+        dest += chunk;
+        bytes_to_read -= chunk;
+    }
+    return 0;
+}
+
+/*!
+ * @brief Consume and discard the next bytes_to_skip bytes of the stream. Unlike
+ * lseek this works on sockets and pipes.
+ * @param reader Pointer to the reader object
+ * @param bytes_to_skip Number of bytes to discard
+ * @return 0 if successful, -1 under the same conditions as stream_reader_read
+ */
+int8_t stream_reader_skip(stream_reader_t * reader, size_t bytes_to_skip)
+{
+    while (bytes_to_skip > 0)
+    {
+        if ((reader->start == reader->end) && (-1 == fill_buffer(reader)))
+        {
+            return -1;
+        }
+
+        size_t available = reader->end - reader->start;
+        size_t chunk = (available < bytes_to_skip) ? available : bytes_to_skip;
+        reader->start += chunk;
+        bytes_to_skip -= chunk;
+    }
+    return 0;
+}
+
+/*!
+ * @brief Expose the buffered bytes without copying them. If the buffer is
+ * empty it is refilled first. The bytes stay valid until the next call that
+ * reads from the reader; use stream_reader_consume to mark them as used.
+ * @param reader Pointer to the reader object
+ * @param available Set to the number of bytes the returned pointer holds
+ * @return Pointer to the next unconsumed byte or NULL under the same
+ * conditions stream_reader_read returns -1
+ */
+const uint8_t * stream_reader_peek(stream_reader_t * reader, size_t * available)
+{
+    if ((reader->start == reader->end) && (-1 == fill_buffer(reader)))
+    {
+        *available = 0;
+        return NULL;
+    }
+
+    *available = reader->end - reader->start;
+    return reader->buffer + reader->start;
+}
+
+/*!
+ * @brief Mark bytes returned by stream_reader_peek as used
+ * @param reader Pointer to the reader object
+ * @param bytes_consumed Number of bytes used, at most the available count
+ */
+void stream_reader_consume(stream_reader_t * reader, size_t bytes_consumed)
+{
+    size_t available = reader->end - reader->start;
+    reader->start += (bytes_consumed < available) ? bytes_consumed : available;
+}
+
+/*!
+ * @brief Free the reader object. The file descriptor is left open.
+ * @param reader Pointer to the reader pointer which is set to NULL
+ */
+void stream_reader_destroy(stream_reader_t ** reader)
+{
+    if ((NULL == reader) || (NULL == *reader))
+    {
+        return;
+    }
+    free(*reader);
+    *reader = NULL;
+}
+
+/*!
+ * @brief Refill the empty buffer with a single read of up to capacity bytes.
+ * @param reader Pointer to the reader object
+ * @return 0 if at least one byte was read, -1 on error, timeout or EOF
+ */
+static int8_t fill_buffer(stream_reader_t * reader)
+{
+    ssize_t read_bytes = read(reader->fd, reader->buffer, reader->capacity);
+    if (-1 == read_bytes)
+    {
+        // If timed out, display message indicating that it timed out
+        if ((EAGAIN == errno) || (EWOULDBLOCK == errno))
+        {
+            debug_print("%s\n", "[STREAM READ] Read timed out");
+        }
+        else
+        {
+            debug_print_err("[STREAM READ] Unable to read from fd: %s\n", strerror(errno));
+        }
+        return -1;
+    }
+    else if (0 == read_bytes)
+    {
+        debug_print_err("%s\n", "[STREAM READ] Read zero bytes. Client likely closed connection.");
+        return -1;
+    }
+
+    reader->start = 0;
+    reader->end = (size_t)read_bytes;
+    return 0;
+}
@@ -0,0 +1,248 @@
+#include <header_parser.h>
+#include <string.h>
+#include <threads.h>
+#include <utils.h>
+#include <cpu_dispatch.h>
+
+#if defined(__x86_64__)
+#include <immintrin.h>
+#endif // END __x86_64__
+
+/*
+ * An unsolved record is four little endian 64 bit words:
+ *
+ *  q0: id (bytes 0-3) | flags (byte 4) | l_operand bytes 0-2
+ *  q1: l_operand bytes 3-7 | opt (byte 13) | r_operand bytes 0-1
+ *  q2: r_operand bytes 2-7 | padding bytes 0-1
+ *  q3: padding bytes 2-9
+ *
+ * The SIMD decoders transpose a run of records so that each vector holds the
+ * same word of several records. Every field then falls out of lane shifts.
+ */
+typedef uint64_t (* decoder_t)(const uint8_t * records,
+                               uint64_t count,
+                               equ_batch_t * batch,
+                               uint64_t index);
+
+static uint64_t decode_run_scalar(const uint8_t * records, uint64_t count, equ_batch_t * batch, uint64_t index);
+#if defined(__x86_64__)
+static uint64_t decode_run_avx2(const uint8_t * records, uint64_t count, equ_batch_t * batch, uint64_t index);
+static uint64_t decode_run_avx512(const uint8_t * records, uint64_t count, equ_batch_t * batch, uint64_t index);
+#endif // END __x86_64__
+static void select_decoder(void);
+
+// Indexed by isa_level_t
+static const decoder_t decoders[ISA_COUNT] = {
+    [ISA_SCALAR]    = decode_run_scalar,
+#if defined(__x86_64__)
+    [ISA_AVX2]      = decode_run_avx2,
+    [ISA_AVX512]    = decode_run_avx512,
+#else
+    [ISA_AVX2]      = decode_run_scalar,
+    [ISA_AVX512]    = decode_run_scalar,
+#endif // END __x86_64__
+};
+
+static once_flag decoder_once = ONCE_FLAG_INIT;
+static decoder_t decoder = decode_run_scalar;
+static decode_variant_t decoder_variant = DECODE_VARIANT_SCALAR;
+
+/*!
+ * @brief Decode a run of whole unsolved records into the batch columns using
+ * the instruction set picked by get_isa_level. Each record is also checked
+ * for an operator in the supported range and for zeroed padding. A record
+ * with non-zero padding is most likely misaligned so its operator is cleared
+ * which makes the solver report it as a failure.
+ * @param records Pointer to count contiguous UNSOLVED_EQU_SIZE byte records
+ * @param count Number of records in the run
+ * @param batch Batch to write the equations to
+ * @param index Index in the batch of the first record of the run
+ * @return Number of records that failed the operator or padding checks
+ */
+uint64_t decode_unsolved_run(const uint8_t * records, uint64_t count, equ_batch_t * batch, uint64_t index)
+{
+    call_once(&decoder_once, select_decoder);
+    return decoder(records, count, batch, index);
+}
+
+/*!
+ * @brief Force the variant used by decode_unsolved_run. This is used to
+ * compare the variants against each other.
+ * @param variant Variant to use
+ * @return 1 if the variant is supported by this CPU and was selected else 0
+ */
+uint8_t set_decode_variant(decode_variant_t variant)
+{
+    call_once(&decoder_once, select_decoder);
+    if (((isa_level_t)variant >= ISA_COUNT) || !isa_supported((isa_level_t)variant))
+    {
+        return 0;
+    }
+    decoder = decoders[variant];
+    decoder_variant = variant;
+    return 1;
+}
+
+/*!
+ * @brief Fetch the variant decode_unsolved_run is using
+ * @return Variant in use
+ */
+decode_variant_t get_decode_variant(void)
+{
+    call_once(&decoder_once, select_decoder);
+    return decoder_variant;
+}
+
+static void select_decoder(void)
+{
+    decoder_variant = (decode_variant_t)get_isa_level();
+    decoder = decoders[decoder_variant];
+}
+
+static uint64_t decode_run_scalar(const uint8_t * records, uint64_t count, equ_batch_t * batch, uint64_t index)
+{
+    static const uint8_t zero_padding[UNSO_PADDING] = {0};
+    uint64_t malformed = 0;
+
+    for (uint64_t i = 0; i < count; i++)
+    {
+        const uint8_t * record = records + (i * UNSOLVED_EQU_SIZE);
+        decode_unsolved(record, batch, index + i);
+
+        uint8_t opt = batch->opt[index + i];
+        if (0 != memcmp(record + (UNSOLVED_EQU_SIZE - UNSO_PADDING), zero_padding, UNSO_PADDING))
+        {
+            batch->opt[index + i] = 0;
+            malformed++;
+        }
+        else if ((opt < OPERATOR_MIN) || (opt > OPERATOR_MAX))
+        {
+            malformed++;
+        }
+    }
+    return malformed;
+}
+
+#if defined(__x86_64__)
+__attribute__((target("avx2")))
+static uint64_t decode_run_avx2(const uint8_t * records, uint64_t count, equ_batch_t * batch, uint64_t index)
+{
+    const __m256i byte_mask = _mm256_set1_epi64x(0xFF);
+    const __m256i pad_mask = _mm256_set1_epi64x((int64_t)0xFFFF000000000000);
+    const __m256i opt_low = _mm256_set1_epi64x(OPERATOR_MIN - 1);
+    const __m256i opt_high = _mm256_set1_epi64x(OPERATOR_MAX + 1);
+    const __m256i zero = _mm256_setzero_si256();
+    const __m256i id_order = _mm256_setr_epi32(0, 2, 4, 6, 0, 2, 4, 6);
+
+    // Gathers the low byte of the two words of each lane into bytes 0-1 of
+    // the low lane and bytes 2-3 of the high lane
+    const __m256i byte_order = _mm256_setr_epi8(
+        0, 8, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+        -1, -1, 0, 8, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1);
+
+    uint64_t malformed = 0;
+    uint64_t i = 0;
+    for (; i + 4 <= count; i += 4)
+    {
+        const uint8_t * run = records + (i * UNSOLVED_EQU_SIZE);
+        __m256i rec0 = _mm256_loadu_si256((const __m256i *)(run));
+        __m256i rec1 = _mm256_loadu_si256((const __m256i *)(run + 32));
+        __m256i rec2 = _mm256_loadu_si256((const __m256i *)(run + 64));
+        __m256i rec3 = _mm256_loadu_si256((const __m256i *)(run + 96));
+
+        // 4x4 transpose of the 64 bit words
+        __m256i t0 = _mm256_unpacklo_epi64(rec0, rec1);
+        __m256i t1 = _mm256_unpackhi_epi64(rec0, rec1);
+        __m256i t2 = _mm256_unpacklo_epi64(rec2, rec3);
+        __m256i t3 = _mm256_unpackhi_epi64(rec2, rec3);
+        __m256i q0 = _mm256_permute2x128_si256(t0, t2, 0x20);
+        __m256i q1 = _mm256_permute2x128_si256(t1, t3, 0x20);
+        __m256i q2 = _mm256_permute2x128_si256(t0, t2, 0x31);
+        __m256i q3 = _mm256_permute2x128_si256(t1, t3, 0x31);
+
+        __m256i l_operand = _mm256_or_si256(_mm256_srli_epi64(q0, 40), _mm256_slli_epi64(q1, 24));
+        __m256i r_operand = _mm256_or_si256(_mm256_srli_epi64(q1, 48), _mm256_slli_epi64(q2, 16));
+        __m256i flags = _mm256_and_si256(_mm256_srli_epi64(q0, 32), byte_mask);
+        __m256i opt = _mm256_and_si256(_mm256_srli_epi64(q1, 40), byte_mask);
+
+        // Padding check and operator range check as lane masks
+        __m256i padding = _mm256_or_si256(_mm256_and_si256(q2, pad_mask), q3);
+        __m256i bad_pad = _mm256_xor_si256(_mm256_cmpeq_epi64(padding, zero), _mm256_set1_epi64x(-1));
+        __m256i bad_opt = _mm256_andnot_si256(_mm256_and_si256(_mm256_cmpgt_epi64(opt, opt_low),
+                                                               _mm256_cmpgt_epi64(opt_high, opt)),
+                                              _mm256_set1_epi64x(-1));
+        opt = _mm256_andnot_si256(bad_pad, opt);
+        malformed += (uint64_t)__builtin_popcount((unsigned int)_mm256_movemask_pd(
+            _mm256_castsi256_pd(_mm256_or_si256(bad_pad, bad_opt))));
+
+        _mm256_storeu_si256((__m256i *)(batch->l_operand + index + i), l_operand);
+        _mm256_storeu_si256((__m256i *)(batch->r_operand + index + i), r_operand);
+        _mm_storeu_si128((__m128i *)(batch->eq_id + index + i),
+                         _mm256_castsi256_si128(_mm256_permutevar8x32_epi32(q0, id_order)));
+
+        __m256i flag_bytes = _mm256_shuffle_epi8(flags, byte_order);
+        __m256i opt_bytes = _mm256_shuffle_epi8(opt, byte_order);
+        int32_t packed_flags = _mm_cvtsi128_si32(_mm_or_si128(_mm256_castsi256_si128(flag_bytes),
+                                                              _mm256_extracti128_si256(flag_bytes, 1)));
+        int32_t packed_opt = _mm_cvtsi128_si32(_mm_or_si128(_mm256_castsi256_si128(opt_bytes),
+                                                            _mm256_extracti128_si256(opt_bytes, 1)));
+        memcpy(batch->flags + index + i, &packed_flags, sizeof(packed_flags));
+        memcpy(batch->opt + index + i, &packed_opt, sizeof(packed_opt));
+    }
+
+    return malformed + decode_run_scalar(records + (i * UNSOLVED_EQU_SIZE), count - i, batch, index + i);
+}
+
+__attribute__((target("avx512f")))
+static uint64_t decode_run_avx512(const uint8_t * records, uint64_t count, equ_batch_t * batch, uint64_t index)
+{
+    const __m512i byte_mask = _mm512_set1_epi64(0xFF);
+    const __m512i pad_mask = _mm512_set1_epi64((int64_t)0xFFFF000000000000);
+    const __m512i opt_low = _mm512_set1_epi64(OPERATOR_MIN);
+    const __m512i opt_high = _mm512_set1_epi64(OPERATOR_MAX);
+
+    // Pick word 0 and 1 (and 2 and 3) of four records held in two vectors
+    const __m512i words_01 = _mm512_setr_epi64(0, 4, 8, 12, 1, 5, 9, 13);
+    const __m512i words_23 = _mm512_setr_epi64(2, 6, 10, 14, 3, 7, 11, 15);
+
+    uint64_t malformed = 0;
+    uint64_t i = 0;
+    for (; i + 8 <= count; i += 8)
+    {
+        const uint8_t * run = records + (i * UNSOLVED_EQU_SIZE);
+        __m512i rec01 = _mm512_loadu_si512((const void *)(run));
+        __m512i rec23 = _mm512_loadu_si512((const void *)(run + 64));
+        __m512i rec45 = _mm512_loadu_si512((const void *)(run + 128));
+        __m512i rec67 = _mm512_loadu_si512((const void *)(run + 192));
+
+        // 8x4 transpose of the 64 bit words
+        __m512i lo_01 = _mm512_permutex2var_epi64(rec01, words_01, rec23);
+        __m512i hi_01 = _mm512_permutex2var_epi64(rec45, words_01, rec67);
+        __m512i lo_23 = _mm512_permutex2var_epi64(rec01, words_23, rec23);
+        __m512i hi_23 = _mm512_permutex2var_epi64(rec45, words_23, rec67);
+        __m512i q0 = _mm512_shuffle_i64x2(lo_01, hi_01, _MM_SHUFFLE(1, 0, 1, 0));
+        __m512i q1 = _mm512_shuffle_i64x2(lo_01, hi_01, _MM_SHUFFLE(3, 2, 3, 2));
+        __m512i q2 = _mm512_shuffle_i64x2(lo_23, hi_23, _MM_SHUFFLE(1, 0, 1, 0));
+        __m512i q3 = _mm512_shuffle_i64x2(lo_23, hi_23, _MM_SHUFFLE(3, 2, 3, 2));
+
+        __m512i l_operand = _mm512_or_si512(_mm512_srli_epi64(q0, 40), _mm512_slli_epi64(q1, 24));
+        __m512i r_operand = _mm512_or_si512(_mm512_srli_epi64(q1, 48), _mm512_slli_epi64(q2, 16));
+        __m512i flags = _mm512_and_si512(_mm512_srli_epi64(q0, 32), byte_mask);
+        __m512i opt = _mm512_and_si512(_mm512_srli_epi64(q1, 40), byte_mask);
+
+        // Padding check and operator range check as lane masks
+        __mmask8 bad_pad = (__mmask8)(_mm512_test_epi64_mask(q2, pad_mask) | _mm512_test_epi64_mask(q3, q3));
+        __mmask8 good_opt = (__mmask8)(_mm512_cmpge_epu64_mask(opt, opt_low) & _mm512_cmple_epu64_mask(opt, opt_high));
+        opt = _mm512_maskz_mov_epi64((__mmask8)~bad_pad, opt);
+        malformed += (uint64_t)__builtin_popcount((unsigned int)(bad_pad | (uint8_t)~good_opt));
+
+        _mm512_storeu_si512((void *)(batch->l_operand + index + i), l_operand);
+        _mm512_storeu_si512((void *)(batch->r_operand + index + i), r_operand);
+        _mm256_storeu_si256((__m256i *)(batch->eq_id + index + i), _mm512_cvtepi64_epi32(q0));
+        _mm_storel_epi64((__m128i *)(batch->flags + index + i), _mm512_cvtepi64_epi8(flags));
+        _mm_storel_epi64((__m128i *)(batch->opt + index + i), _mm512_cvtepi64_epi8(opt));
+    }
+
+    return malformed + decode_run_avx2(records + (i * UNSOLVED_EQU_SIZE), count - i, batch, index + i);
+}
+#endif // END __x86_64__
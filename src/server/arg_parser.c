@@ -7,6 +7,8 @@
 DEBUG_STATIC void free_args(args_t * args);
 DEBUG_STATIC uint32_t get_port(char * port);
 DEBUG_STATIC uint8_t get_threads(char * thread);
+DEBUG_STATIC uint32_t get_window(char * window);
+DEBUG_STATIC uint32_t get_cache_size(char * cache_size);
 
 static uint8_t str_to_long(char * str_num, long int * int_val);
 /*!
@@ -33,7 +35,9 @@ args_t * parse_args(int argc, char ** argv)
     }
     *args = (args_t){
         .port       = DEFAULT_PORT,
-        .threads    = DEFAULT_THREADS
+        .threads    = DEFAULT_THREADS,
+        .window     = DEFAULT_WINDOW,
+        .cache_size = DEFAULT_CACHE
     };
 
     // If not additional arguments have been specified, return the default;
@@ -46,7 +50,7 @@ args_t * parse_args(int argc, char ** argv)
     opterr = 0;
     int c = 0;
 
-    while ((c = getopt(argc, argv, "p:n:h")) != -1)
+    while ((c = getopt(argc, argv, "p:n:w:c:h")) != -1)
         switch (c)
         {
             case 'p':
@@ -65,16 +69,36 @@ args_t * parse_args(int argc, char ** argv)
                     return NULL;
                 }
                 break;
+            case 'w':
+                args->window = get_window(optarg);
+                if (0 == args->window)
+                {
+                    free_args(args);
+                    return NULL;
+                }
+                break;
+            case 'c':
+                args->cache_size = get_cache_size(optarg);
+                if (0 == args->cache_size)
+                {
+                    free_args(args);
+                    return NULL;
+                }
+                break;
             case 'h':
                 printf("Server listens on 0.0.0.0:31337 by default with "
                        "the option of modifying the port to listen on and the "
                        "number of threads to utilize.\n\n"
                        "-p  Port to listen to (default: 31337)\n"
-                       "-n  Number of threads to use (default: 4)\n");
+                       "-n  Number of threads to use (default: 4)\n"
+                       "-w  Number of equations solved and sent back per "
+                       "window when streaming large files (default: 16384)\n"
+                       "-c  Number of multiply, divide and modulo results "
+                       "cached across requests (default: disabled)\n");
                 free_args(args);
                 return NULL;
             case '?':
-                if ((optopt == 'p') || (optopt == 'n'))
+                if ((optopt == 'p') || (optopt == 'n') || (optopt == 'w') || (optopt == 'c'))
                 {
                     fprintf(stderr,
                             "Option -%c requires an argument.\n",
@@ -154,6 +178,56 @@ DEBUG_STATIC uint8_t get_threads(char * thread)
     return (uint8_t)converted_port;
 }
 
+/*!
+ * @brief Convert the window string into the number of equations held per
+ * streaming window
+ * @param window Pointer to the window string
+ * @return uint32_t conversion of window; 0 if failure
+ */
+DEBUG_STATIC uint32_t get_window(char * window)
+{
+    long int converted_window = 0;
+    int result = str_to_long(window, &converted_window);
+
+    // If 0 is returned, return 0 indicating an error
+    if (0 == result)
+    {
+        return 0;
+    }
+
+    if ((converted_window > MAX_WINDOW) || (converted_window < MIN_WINDOW))
+    {
+        return 0;
+    }
+
+    return (uint32_t)converted_window;
+}
+
+/*!
+ * @brief Convert the cache size string into the number of results held by
+ * the result cache
+ * @param cache_size Pointer to the cache size string
+ * @return uint32_t conversion of cache_size; 0 if failure
+ */
+DEBUG_STATIC uint32_t get_cache_size(char * cache_size)
+{
+    long int converted_size = 0;
+    int result = str_to_long(cache_size, &converted_size);
+
+    // If 0 is returned, return 0 indicating an error
+    if (0 == result)
+    {
+        return 0;
+    }
+
+    if ((converted_size > MAX_CACHE) || (converted_size < MIN_CACHE))
+    {
+        return 0;
+    }
+
+    return (uint32_t)converted_size;
+}
+
 /*!
  * @brief Function is mostly a replica of the strtol help menu to convert a
  * string into a long int
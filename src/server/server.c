@@ -13,7 +13,7 @@ int main(int argc, char ** argv)
         exit(-1);
     }
 
-    start_server(args->threads, args->port);
+    start_server(args->threads, args->port, args->window, args->cache_size);
 
     free_args(args);
 }
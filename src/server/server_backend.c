@@ -4,23 +4,58 @@
 #include <errno.h>
 #include <unistd.h>
 #include <header_parser.h>
+#include <cpu_dispatch.h>
+#include <result_cache.h>
 #include <stdlib.h>
 #include <signal.h>
 #include <stdatomic.h>
+#include <stdbool.h>
+#include <threads.h>
+#include <sys/socket.h>
 
 DEBUG_STATIC int server_listen(uint32_t port, socklen_t * record_len);
 DEBUG_STATIC void serve_client(void * sock);
 static int get_ip_port(struct sockaddr * addr, socklen_t addr_size, char * host, char * port);
 static void signal_handler(int signal);
-static void error_reply(void * sock_oid, net_header_t * header);
+static void error_reply(int client_sock, net_header_t * header);
 static void serialize_header(net_header_t * header,
                              uint8_t * buffer,
                              size_t buffer_size);
+static void solved_reply(int client_sock, net_header_t * header, equations_t * eqs);
+static int8_t write_all(int fd, uint8_t * buffer, size_t buffer_size);
 
-void error_reply(void * sock_oid, net_header_t * header);
+// State shared by the thread receiving a file and the thread sending back
+// its solutions. The file is held in two windows so the receiver can decode
+// the next window while the sender solves and writes the previous one
+typedef struct stream_pipeline_t
+{
+    int client_sock;
+    equ_batch_t * windows[2];
+    uint8_t * buffer;           // Serialized solved records of one window
+    size_t buffer_size;
+    uint64_t total_windows;
+    uint64_t filled;            // Windows decoded by the receiver
+    uint64_t sent;              // Windows solved and written by the sender
+    bool aborted;               // Receiver stopped before filling every window
+    bool failed;                // Sender was unable to write to the client
+    mtx_t lock;
+    cnd_t changed;
+} stream_pipeline_t;
+
+static int8_t stream_reply(int client_sock, stream_reader_t * reader, net_header_t * header, equations_t * eqs);
+static int8_t stream_headers(stream_pipeline_t * pipeline, net_header_t * header, equations_t * eqs);
+static void stream_windows(stream_pipeline_t * pipeline, stream_reader_t * reader, uint64_t number_of_eq);
+static int send_windows(void * pipeline_void);
+static int8_t send_window(stream_pipeline_t * pipeline, equ_batch_t * batch);
+
+void error_reply(int client_sock, net_header_t * header);
 // Atomic flag is used to control the server running
 static atomic_flag server_run;
 
+// Files with more equations than this are streamed back one window at a
+// time. Set by start_server before any connection is served
+DEBUG_STATIC uint32_t stream_window = MAX_WINDOW;
+
 /*!
  * @brief Start the EQU server on the specified ports. The function will
  * also spawn a thread pool object with the thread_count of the value
@@ -28,14 +63,31 @@ static atomic_flag server_run;
  *
  * @param thread_count Number of threads to spawn in the thread pool
  * @param port_num Port number to listen on
+ * @param window_size Number of equations held in memory per window when a
+ * file is streamed back to the client
+ * @param cache_size Number of results held by the result cache shared by
+ * every connection. 0 disables the cache
  */
-void start_server(uint8_t thread_count, uint32_t port_num)
+void start_server(uint8_t thread_count, uint32_t port_num, uint32_t window_size, uint32_t cache_size)
 {
+    stream_window = window_size;
+
+    // Pick the solve and decode kernels up front so the choice is logged at
+    // startup instead of with the first file
+    get_isa_level();
+
+    // The cache has to exist before the first connection is solved
+    if ((0 != cache_size) && (-1 == result_cache_init(cache_size)))
+    {
+        debug_print_err("%s\n", "Unable to create the result cache");
+        return;
+    }
 
     // Make the server start listening
     int server_socket = server_listen(port_num, 0);
     if (-1 == server_socket)
     {
+        result_cache_destroy();
         return;
     }
 
@@ -44,6 +96,7 @@ void start_server(uint8_t thread_count, uint32_t port_num)
     if (NULL == thpool)
     {
         close(server_socket);
+        result_cache_destroy();
         return;
     }
 
@@ -60,6 +113,7 @@ void start_server(uint8_t thread_count, uint32_t port_num)
         debug_print_err("%s\n", "Unable to set up signal handler");
         close(server_socket);
         thpool_destroy(&thpool);
+        result_cache_destroy();
         return;
 	}
 
@@ -88,18 +142,14 @@ void start_server(uint8_t thread_count, uint32_t port_num)
             {
                 printf("[SERVER] Received connection from unknown peer\n");
             }
-            int * fd = (int *)malloc(sizeof(int));
-            if (UV_INVALID_ALLOC == verify_alloc((fd)))
+            // The fd travels inside the job so queuing it allocates nothing
+            if (THP_FAILURE == thpool_enqueue_inline(thpool, serve_client,
+                                                     &client_fd, sizeof(client_fd)))
             {
-                debug_print_err("[SERVER] Unable to allocate memory for fd "
-                                "for connection %s:%s\n", host, service);
+                debug_print_err("[SERVER] Too many pending connections, "
+                                "dropping %s:%s\n", host, service);
                 close(client_fd);
             }
-            else
-            {
-                *fd = client_fd;
-                thpool_enqueue_job(thpool, serve_client, fd);
-            }
         }
     }
 
@@ -109,6 +159,15 @@ void start_server(uint8_t thread_count, uint32_t port_num)
     // Close the server
     close(server_socket);
     thpool_destroy(&thpool);
+
+    if (result_cache_enabled())
+    {
+        result_cache_stats_t stats;
+        result_cache_stats(&stats);
+        printf("[SERVER] Result cache of %lu held %lu results: %lu hits, %lu misses, %lu evictions\n",
+               stats.capacity, stats.inserts - stats.evictions, stats.hits, stats.misses, stats.evictions);
+        result_cache_destroy();
+    }
 }
 
 /*!
@@ -118,17 +177,25 @@ void start_server(uint8_t thread_count, uint32_t port_num)
  * this callback function. This is where the individual files are parsed
  * and returned to the client.
  *
- * @param sock_void Void pointer containing the connection file descriptor
+ * @param sock_void Pointer to the connection file descriptor. It points into
+ * the job itself so nothing is freed.
  */
 DEBUG_STATIC void serve_client(void * sock_void)
 {
     int client_sock = *(int *)sock_void;
 
-    net_header_t * header = read_header(client_sock);
+    stream_reader_t * reader = stream_reader_init(client_sock, SR_DEFAULT_CAPACITY);
+    if (NULL == reader)
+    {
+        close(client_sock);
+        return;
+    }
+
+    net_header_t * header = read_header(reader);
     if (NULL == header)
     {
+        stream_reader_destroy(&reader);
         close(client_sock);
-        free(sock_void);
         return;
     }
 
@@ -142,7 +209,8 @@ DEBUG_STATIC void serve_client(void * sock_void)
                     "value of %d. Read %u instead\n", NET_MAX_HEADER_SIZE,
                     header->header_size);
 
-        error_reply(sock_void, header);
+        stream_reader_destroy(&reader);
+        error_reply(client_sock, header);
         return;
 
     }
@@ -152,18 +220,343 @@ DEBUG_STATIC void serve_client(void * sock_void)
         debug_print("[SERVER THREAD] File name length exceeds the size limit "
                     "of %d. The length is set to %d\n", NET_MAX_FILE_NAME,
                     header->name_len);
-        error_reply(sock_void, header);
+        stream_reader_destroy(&reader);
+        error_reply(client_sock, header);
         return;
     }
 
+    equations_t * eqs = parse_file_header(reader);
+    if (NULL == eqs)
+    {
+        debug_print("%s\n", "[SERVER THREAD] Unable to parse the equation "
+                             "stream");
+        stream_reader_destroy(&reader);
+        error_reply(client_sock, header);
+        return;
+    }
+
+    // Files that fit in a window are answered in one piece so that a
+    // truncated upload still gets an error reply. Larger files are streamed
+    // back to keep the memory used by a connection bounded
+    if (eqs->number_of_eq > stream_window)
+    {
+        if (-1 == stream_reply(client_sock, reader, header, eqs))
+        {
+            stream_reader_destroy(&reader);
+            free_equation(eqs);
+            error_reply(client_sock, header);
+            return;
+        }
+    }
+    else
+    {
+        eqs->batch = get_equation_batch(eqs->number_of_eq);
+        if ((NULL == eqs->batch)
+            || (-1 == parse_records(reader, eqs->batch, 0, eqs->number_of_eq)))
+        {
+            debug_print("%s\n", "[SERVER THREAD] Unable to parse the equation "
+                                 "stream");
+            stream_reader_destroy(&reader);
+            free_equation(eqs);
+            error_reply(client_sock, header);
+            return;
+        }
+        solve_equation_batch(eqs->batch);
+        solved_reply(client_sock, header, eqs);
+    }
+
+    stream_reader_destroy(&reader);
+    free_equation(eqs);
     close(client_sock);
-    free(sock_void);
     free_header(header);
 }
 
-static void error_reply(void * sock_void, net_header_t * header)
+/*!
+ * @brief Answer a file too large to hold in memory. The reply headers are
+ * sent first since the reply size is known from the file header, then the
+ * records are decoded, solved and sent back one window at a time. A sender
+ * thread works on one window while the next one is received so receiving
+ * and solving overlap.
+ *
+ * Once the headers are sent the client can no longer be given an error
+ * reply, so a stream that ends early only closes the connection.
+ * @param client_sock Socket of the client
+ * @param reader Buffered reader positioned at the first unsolved record
+ * @param header Net header received from the client
+ * @param eqs Equations object holding the file header
+ * @return -1 if nothing was sent and the caller should reply with an error,
+ * otherwise 0
+ */
+static int8_t stream_reply(int client_sock, stream_reader_t * reader, net_header_t * header, equations_t * eqs)
+{
+    stream_pipeline_t pipeline = {
+        .client_sock    = client_sock,
+        .windows        = {get_equation_batch(stream_window), get_equation_batch(stream_window)},
+        .buffer_size    = (size_t)stream_window * SOLVED_EQU_SIZE,
+        .total_windows  = (eqs->number_of_eq + stream_window - 1) / stream_window,
+    };
+    pipeline.buffer = (uint8_t *)malloc(pipeline.buffer_size);
+
+    int8_t result = -1;
+    if ((NULL != pipeline.windows[0]) && (NULL != pipeline.windows[1])
+        && (UV_INVALID_ALLOC != verify_alloc(pipeline.buffer)))
+    {
+        result = 0;
+        if (0 == stream_headers(&pipeline, header, eqs))
+        {
+            stream_windows(&pipeline, reader, eqs->number_of_eq);
+        }
+    }
+
+    free_equation_batch(pipeline.windows[0]);
+    free_equation_batch(pipeline.windows[1]);
+    free(pipeline.buffer);
+    return result;
+}
+
+/*!
+ * @brief Send the net header and the solved file header followed by the zero
+ * fill up to the offset of the first solved record
+ * @param pipeline Pipeline of the connection
+ * @param header Net header received from the client
+ * @param eqs Equations object holding the file header
+ * @return 0 if everything was written otherwise -1
+ */
+static int8_t stream_headers(stream_pipeline_t * pipeline, net_header_t * header, equations_t * eqs)
+{
+    uint8_t headers[NET_MAX_HEADER_SIZE + EQU_HEADER_SIZE] = {0};
+    header->total_payload_size = NET_MAX_HEADER_SIZE + get_solved_size(eqs);
+    serialize_header(header, headers, NET_MAX_HEADER_SIZE);
+    encode_file_header(eqs, headers + NET_MAX_HEADER_SIZE);
+    if (-1 == write_all(pipeline->client_sock, headers, sizeof(headers)))
+    {
+        debug_print_err("[SERVER THREAD] Error writting %s\n", strerror(errno));
+        return -1;
+    }
+
+    // Optional headers are not echoed back, only the space they took
+    memset(pipeline->buffer, 0, pipeline->buffer_size);
+    uint64_t fill = eqs->offset - EQU_HEADER_SIZE;
+    while (fill > 0)
+    {
+        size_t chunk = (fill < pipeline->buffer_size) ? (size_t)fill : pipeline->buffer_size;
+        if (-1 == write_all(pipeline->client_sock, pipeline->buffer, chunk))
+        {
+            debug_print_err("[SERVER THREAD] Error writting %s\n", strerror(errno));
+            return -1;
+        }
+        fill -= chunk;
+    }
+    return 0;
+}
+
+/*!
+ * @brief Decode the records into the windows of the pipeline and hand every
+ * filled window to the sender thread. If the sender thread can not be
+ * started each window is solved and sent before the next one is read.
+ * @param pipeline Pipeline of the connection
+ * @param reader Buffered reader positioned at the first unsolved record
+ * @param number_of_eq Number of records in the file
+ */
+static void stream_windows(stream_pipeline_t * pipeline, stream_reader_t * reader, uint64_t number_of_eq)
+{
+    thrd_t sender;
+    bool threaded = false;
+    if (thrd_success == mtx_init(&pipeline->lock, mtx_plain))
+    {
+        if (thrd_success == cnd_init(&pipeline->changed))
+        {
+            if (thrd_success == thrd_create(&sender, send_windows, pipeline))
+            {
+                threaded = true;
+            }
+            else
+            {
+                cnd_destroy(&pipeline->changed);
+                mtx_destroy(&pipeline->lock);
+            }
+        }
+        else
+        {
+            mtx_destroy(&pipeline->lock);
+        }
+    }
+
+    for (uint64_t window = 0; window < pipeline->total_windows; window++)
+    {
+        if (threaded)
+        {
+            // Wait for the sender to hand back a window to decode into
+            mtx_lock(&pipeline->lock);
+            while (((pipeline->filled - pipeline->sent) == 2) && (!pipeline->failed))
+            {
+                cnd_wait(&pipeline->changed, &pipeline->lock);
+            }
+            bool failed = pipeline->failed;
+            mtx_unlock(&pipeline->lock);
+            if (failed)
+            {
+                break;
+            }
+        }
+
+        equ_batch_t * batch = pipeline->windows[window % 2];
+        uint64_t first = window * stream_window;
+        batch->count = ((number_of_eq - first) < stream_window) ? (number_of_eq - first) : stream_window;
+        if (-1 == parse_records(reader, batch, 0, batch->count))
+        {
+            debug_print("[SERVER THREAD] Stream ended after %lu of %lu equations\n",
+                        first, number_of_eq);
+            if (threaded)
+            {
+                mtx_lock(&pipeline->lock);
+                pipeline->aborted = true;
+                cnd_signal(&pipeline->changed);
+                mtx_unlock(&pipeline->lock);
+            }
+            break;
+        }
+
+        if (!threaded)
+        {
+            if (-1 == send_window(pipeline, batch))
+            {
+                break;
+            }
+            continue;
+        }
+
+        mtx_lock(&pipeline->lock);
+        pipeline->filled++;
+        cnd_signal(&pipeline->changed);
+        mtx_unlock(&pipeline->lock);
+    }
+
+    if (threaded)
+    {
+        thrd_join(sender, NULL);
+        cnd_destroy(&pipeline->changed);
+        mtx_destroy(&pipeline->lock);
+    }
+}
+
+/*!
+ * @brief Thread callback that solves and sends every window the receiver
+ * fills, in order. Returns once every window is sent, the receiver gives up
+ * on the stream or the client can no longer be written to.
+ * @param pipeline_void Pointer to the stream_pipeline_t of the connection
+ * @return Always 0
+ */
+static int send_windows(void * pipeline_void)
+{
+    stream_pipeline_t * pipeline = (stream_pipeline_t *)pipeline_void;
+
+    for (uint64_t window = 0; window < pipeline->total_windows; window++)
+    {
+        mtx_lock(&pipeline->lock);
+        while ((window == pipeline->filled) && (!pipeline->aborted))
+        {
+            cnd_wait(&pipeline->changed, &pipeline->lock);
+        }
+        bool ready = (window < pipeline->filled);
+        mtx_unlock(&pipeline->lock);
+        if (!ready)
+        {
+            break;
+        }
+
+        int8_t result = send_window(pipeline, pipeline->windows[window % 2]);
+
+        mtx_lock(&pipeline->lock);
+        pipeline->sent++;
+        pipeline->failed = (-1 == result);
+        cnd_signal(&pipeline->changed);
+        mtx_unlock(&pipeline->lock);
+        if (-1 == result)
+        {
+            break;
+        }
+    }
+    return 0;
+}
+
+/*!
+ * @brief Solve one window and write its solved records to the client
+ * @param pipeline Pipeline of the connection
+ * @param batch Window to solve
+ * @return 0 if the window was written otherwise -1
+ */
+static int8_t send_window(stream_pipeline_t * pipeline, equ_batch_t * batch)
+{
+    solve_equation_batch(batch);
+    size_t written = serialize_solutions(batch, pipeline->buffer, pipeline->buffer_size);
+    if (-1 == write_all(pipeline->client_sock, pipeline->buffer, written))
+    {
+        debug_print_err("[SERVER THREAD] Error writting %s\n", strerror(errno));
+        return -1;
+    }
+    return 0;
+}
+
+/*!
+ * @brief Send the solved file back to the client prefixed with a net header
+ * describing its size
+ * @param client_sock Socket of the client
+ * @param header Net header received from the client
+ * @param eqs Pointer to the solved equations object
+ */
+static void solved_reply(int client_sock, net_header_t * header, equations_t * eqs)
+{
+    uint64_t solved_size = get_solved_size(eqs);
+    header->total_payload_size = NET_MAX_HEADER_SIZE + solved_size;
+
+    uint8_t * buffer = (uint8_t *)calloc(header->total_payload_size, sizeof(uint8_t));
+    if (UV_INVALID_ALLOC == verify_alloc(buffer))
+    {
+        return;
+    }
+
+    size_t offset = NET_MAX_HEADER_SIZE;
+    serialize_header(header, buffer, NET_MAX_HEADER_SIZE);
+    offset += serialize_file_header(eqs, buffer + offset, header->total_payload_size - offset);
+    offset += serialize_solutions(eqs->batch, buffer + offset, header->total_payload_size - offset);
+
+    if (-1 == write_all(client_sock, buffer, offset))
+    {
+        debug_print_err("[SERVER THREAD] Error writting %s\n", strerror(errno));
+    }
+    free(buffer);
+}
+
+/*!
+ * @brief Write the whole buffer to the socket, retrying on short writes. A
+ * client that went away fails the write instead of raising SIGPIPE
+ * @param fd Socket to write to
+ * @param buffer Buffer to write
+ * @param buffer_size Number of bytes to write
+ * @return 0 if everything was written otherwise -1
+ */
+static int8_t write_all(int fd, uint8_t * buffer, size_t buffer_size)
+{
+    size_t total_written = 0;
+    while (total_written < buffer_size)
+    {
+        ssize_t written = send(fd, buffer + total_written, buffer_size - total_written, MSG_NOSIGNAL);
+        if (-1 == written)
+        {
+            if (EINTR == errno)
+            {
+                continue;
+            }
+            return -1;
+        }
+        total_written += (size_t)written;
+    }
+    return 0;
+}
+
+static void error_reply(int client_sock, net_header_t * header)
 {
-    int client_sock = *(int *)sock_void;
     header->name_len = 0;
     memset(header->file_name, 0, NET_MAX_FILE_NAME);
 
@@ -174,7 +567,7 @@ static void error_reply(void * sock_void, net_header_t * header)
     }
 
     serialize_header(header, buffer, NET_MAX_HEADER_SIZE);
-    ssize_t res = write(client_sock, buffer, NET_MAX_HEADER_SIZE);
+    ssize_t res = send(client_sock, buffer, NET_MAX_HEADER_SIZE, MSG_NOSIGNAL);
     if (-1 == res)
     {
         debug_print_err("[SERVER THREAD] Error writting %s\n", strerror(errno));
@@ -183,7 +576,6 @@ static void error_reply(void * sock_void, net_header_t * header)
     free(buffer);
     free_header(header);
     close(client_sock);
-    free(sock_void);
 }
 
 static void serialize_header(net_header_t * header, uint8_t * buffer, size_t buffer_size)
@@ -1,37 +1,90 @@
 #include <thread_pool.h>
 #include <stdlib.h>
-#include <unistd.h>
+#include <string.h>
 #include <stdatomic.h>
 #include <assert.h>
 
+#define QUEUE_CACHE_LINE 64
+#define DEQUE_SIZE 256
+
+_Static_assert(0 == (THPOOL_QUEUE_SIZE & (THPOOL_QUEUE_SIZE - 1)),
+               "THPOOL_QUEUE_SIZE must be a power of two");
+_Static_assert(0 == (DEQUE_SIZE & (DEQUE_SIZE - 1)),
+               "DEQUE_SIZE must be a power of two");
+
+#define INLINE_WORDS (THPOOL_INLINE_ARG_SIZE / sizeof(uint64_t))
+_Static_assert(0 == (THPOOL_INLINE_ARG_SIZE % sizeof(uint64_t)),
+               "THPOOL_INLINE_ARG_SIZE must be a multiple of 8");
+
+typedef void (* job_function_t)(void * job_arg);
+
+// A job is the function a woken thread should perform and its argument. A
+// small argument is copied into the job itself, job_arg is pointed at the
+// copy once the job has been taken off a queue.
+typedef struct job_t
+{
+    job_function_t job_function;
+    void * job_arg;
+    uint8_t arg_inline;
+    uint64_t inline_arg[INLINE_WORDS];
+} job_t;
+
+// A job held by a worker deque. Thieves read a job before they know if they
+// won it, so the fields are atomic even though only the owner writes them.
+typedef struct deque_job_t
+{
+    _Atomic(job_function_t) job_function;
+    _Atomic(void *) job_arg;
+    _Atomic uint8_t arg_inline;
+    _Atomic uint64_t inline_arg[INLINE_WORDS];
+} deque_job_t;
+
+// Chase-Lev work stealing deque of a worker. Only the owner pushes and takes
+// at the bottom, any other worker steals from the top. The deque does not
+// grow, a job that does not fit goes to the shared work queue instead.
+typedef struct work_deque_t
+{
+    _Alignas(QUEUE_CACHE_LINE) atomic_size_t top;
+    _Alignas(QUEUE_CACHE_LINE) atomic_size_t bottom;
+    deque_job_t jobs[DEQUE_SIZE];
+} work_deque_t;
+
 // Worker objects is a struct containing a pointer to the thpool and the
-// thread itself
+// thread itself. Jobs the worker enqueues while running a job go onto its
+// own deque where idle workers can steal them.
 typedef struct worker_t
 {
     int id;
     thrd_t thread;
     thpool_t * thpool;
+    uint32_t steal_seed;
+    work_deque_t deque;
 } worker_t;
 
-// A job is a queued up object containing the function that a woken thread
-// should perform.
-typedef struct job_t job_t;
-struct job_t
+// A job slot of the work queue. Jobs are written in place into the slot so
+// enqueueing a job allocates nothing. The sequence tells producers and
+// consumers whose turn it is to use the slot: it equals the position of the
+// slot when it is free to be written and the position plus one once it holds
+// a job that can be read.
+typedef struct job_slot_t
 {
-    job_t * next_job;
-    void (* job_function)(void * job_arg);
-	void * job_arg;
-};
-
-// The work queue contains a list of first come, first served jobs that are
-// consumed by the thread pool. When the queue is empty, the threads will
-// block until a new job is enqueued.
+    atomic_size_t sequence;
+    job_t job;
+} job_slot_t;
+
+// The work queue is a bounded ring of THPOOL_QUEUE_SIZE job slots shared by
+// any number of producers and consumers without a lock (Vyukov's MPMC queue).
+// Producers claim the next enqueue position and consumers the next dequeue
+// position with a compare and swap, the position counters and the job count
+// each live on their own cache line so producers and consumers do not
+// invalidate each other's line.
 typedef struct work_queue_t
 {
-    job_t * job_head;
-    job_t * job_tail;
-    atomic_uint_fast64_t job_count;
-    mtx_t queue_access_mutex;
+    job_slot_t * slots;
+    size_t slot_mask;
+    _Alignas(QUEUE_CACHE_LINE) atomic_size_t enqueue_pos;
+    _Alignas(QUEUE_CACHE_LINE) atomic_size_t dequeue_pos;
+    _Alignas(QUEUE_CACHE_LINE) atomic_uint_fast64_t job_count;
 } work_queue_t;
 
 // The main structure contains pointers to the mutexes and atomic variables
@@ -39,21 +92,45 @@ typedef struct work_queue_t
 struct thpool_t
 {
     uint8_t thread_count;
+    uint8_t workers_started;    // Threads created so far, all must be joined
     atomic_uint_fast8_t workers_alive;
     atomic_uint_fast8_t workers_working;
     atomic_uint_fast8_t thpool_active;
+    atomic_uint_fast8_t workers_sleeping;
 
     worker_t ** workers;
     work_queue_t * work_queue;
     mtx_t run_mutex;
     cnd_t run_cond;
+    cnd_t alive_cond;           // Signaled under run_mutex as each worker starts
 
     mtx_t wait_mutex;
     cnd_t wait_cond;
 };
 
 static void thread_pool(worker_t * worker);
-static job_t * thpool_dequeue_job(thpool_t * thpool);
+static thpool_status thpool_enqueue(thpool_t * thpool, const job_t * job);
+static uint8_t thpool_dequeue_job(work_queue_t * work_queue, job_t * job);
+static uint8_t thpool_inject_job(work_queue_t * work_queue, const job_t * job);
+static uint8_t thpool_inject_batch(work_queue_t * work_queue,
+                                   job_function_t job_function,
+                                   void ** job_args,
+                                   size_t count);
+static void wake_workers(thpool_t * thpool, size_t count);
+static uint8_t deque_push(work_deque_t * deque, const job_t * job);
+static uint8_t deque_push_batch(work_deque_t * deque,
+                                job_function_t job_function,
+                                void ** job_args,
+                                size_t count);
+static uint8_t deque_take(work_deque_t * deque, job_t * job);
+static uint8_t deque_steal(work_deque_t * deque, job_t * job);
+static void deque_read(deque_job_t * slot, job_t * job);
+static uint8_t steal_job(worker_t * worker, job_t * job);
+static uint8_t find_job(worker_t * worker, job_t * job);
+static void signal_wait_cond(thpool_t * thpool);
+
+// Worker the calling thread runs as, NULL for threads outside of any pool
+static _Thread_local worker_t * current_worker = NULL;
 
 /*!
  * @brief Initialize the threadpool object and spawns the number of threads
@@ -63,7 +140,8 @@ static job_t * thpool_dequeue_job(thpool_t * thpool);
  * is complete, the thread will return back to blocking with the others until
  * another job is enqueued.
  *
- * Note that this function will block until all threads have been initialized
+ * Note that this function will block until all threads have been initialized,
+ * each thread signals alive_cond as it starts so no polling is involved
  *
  * @param thread_count Number of threads to spawn for the threadpool
  * @return Pointer to the threadpool object or NULL
@@ -105,12 +183,29 @@ thpool_t * thpool_init(uint8_t thread_count)
     /*
      * Init work queue
      */
-    work_queue_t * work_queue = (work_queue_t *)calloc(1, sizeof(work_queue_t));
+    work_queue_t * work_queue = (work_queue_t *)aligned_alloc(QUEUE_CACHE_LINE, sizeof(work_queue_t));
     if (UV_INVALID_ALLOC == verify_alloc(work_queue))
     {
-        thpool_destroy(&thpool);
+        free(thpool->workers);
+        free(thpool);
+        return NULL;
+    }
+    memset(work_queue, 0, sizeof(work_queue_t));
+
+    work_queue->slots = (job_slot_t *)calloc(THPOOL_QUEUE_SIZE, sizeof(job_slot_t));
+    if (UV_INVALID_ALLOC == verify_alloc(work_queue->slots))
+    {
+        free(work_queue);
+        free(thpool->workers);
+        free(thpool);
         return NULL;
     }
+    for (size_t slot = 0; slot < THPOOL_QUEUE_SIZE; slot++)
+    {
+        atomic_init(&work_queue->slots[slot].sequence, slot);
+    }
+    work_queue->slot_mask = THPOOL_QUEUE_SIZE - 1;
+    thpool->work_queue = work_queue;
 
 
 
@@ -132,10 +227,10 @@ thpool_t * thpool_init(uint8_t thread_count)
         thpool_destroy(&thpool);
         return NULL;
     }
-    result = mtx_init(&work_queue->queue_access_mutex, mtx_plain);
+    result = cnd_init(&thpool->alive_cond);
     if (thrd_success != result)
     {
-        debug_print_err("%s", "Unable to init queue_access\n");
+        debug_print_err("%s", "Unable to init alive_cond\n");
         thpool_destroy(&thpool);
         return NULL;
     }
@@ -162,7 +257,8 @@ thpool_t * thpool_init(uint8_t thread_count)
     thpool->thpool_active = 1;
     thpool->workers_alive = 0;
     thpool->workers_working = 0;
-    thpool->work_queue = work_queue;
+    thpool->workers_sleeping = 0;
+    thpool->workers_started = 0;
     thpool->thread_count = thread_count;
 
 
@@ -172,16 +268,18 @@ thpool_t * thpool_init(uint8_t thread_count)
      */
     for (uint8_t i = 0; i < thread_count; i++)
     {
-        thpool->workers[i] = (worker_t *)malloc(sizeof(worker_t));
+        thpool->workers[i] = (worker_t *)aligned_alloc(QUEUE_CACHE_LINE, sizeof(worker_t));
         worker_t * worker = thpool->workers[i];
         if (UV_INVALID_ALLOC == verify_alloc(worker))
         {
             thpool_destroy(&thpool);
             return NULL;
         }
+        memset(worker, 0, sizeof(worker_t));
 
         worker->thpool = thpool;
         worker->id = i;
+        worker->steal_seed = (uint32_t)i * 2654435761u + 1;
         result = thrd_create(&(worker->thread),
                              (thrd_start_t)thread_pool, worker);
         if (thrd_success != result)
@@ -191,14 +289,7 @@ thpool_t * thpool_init(uint8_t thread_count)
             return NULL;
 
         }
-	    result = thrd_detach(worker->thread);
-        if (thrd_success != result)
-        {
-            debug_print_err("%s", "Unable to detach thread\n");
-            thpool_destroy(&thpool);
-            return NULL;
-        }
-
+        thpool->workers_started++;
     }
 
 
@@ -206,12 +297,14 @@ thpool_t * thpool_init(uint8_t thread_count)
     /*
      * Block until all threads have been initialized
      */
+    mtx_lock(&thpool->run_mutex);
     while (thread_count != atomic_load(&thpool->workers_alive))
     {
         debug_print("[THPOOL] Waiting for threads to init [%d/%d]\n",
                     atomic_load(&thpool->workers_alive), thread_count);
-        usleep(200000);
+        cnd_wait(&thpool->alive_cond, &thpool->run_mutex);
     }
+    mtx_unlock(&thpool->run_mutex);
     debug_print("%s\n", "[THPOOL] Thread pool ready\n");
     return thpool;
 }
@@ -243,7 +336,9 @@ void thpool_wait(thpool_t * thpool)
 }
 
 /*!
- * @brief Free the thread pool
+ * @brief Free the thread pool. Idle workers are woken up to exit and every
+ * thread is joined, a worker that is running a job finishes it first. Jobs
+ * still queued are dropped.
  * @param thpool Pointer to the threadpool object
  */
 void thpool_destroy(thpool_t ** thpool_ptr)
@@ -252,46 +347,46 @@ void thpool_destroy(thpool_t ** thpool_ptr)
     thpool_t * thpool = * thpool_ptr;
     assert(thpool);
 
-    // Set running bool to false and set the queue to have a value of 1
-    // instructing the threads to look for work.
-    atomic_fetch_sub(&thpool->thpool_active, 1);
-
-
-    // update all the threads until they are done with their tasks
-    while (0 != atomic_load(&thpool->workers_alive))
+    // Clear the running flag under the run lock so that no worker can check
+    // it and then miss the broadcast telling it to exit
+    if (0 != thpool->workers_started)
     {
+        mtx_lock(&thpool->run_mutex);
+        atomic_store(&thpool->thpool_active, 0);
         debug_print("\n[THPOOL] Broadcasting threads to exit...\n"
                     "Workers still alive: %d\n",
                     atomic_load(&thpool->workers_alive));
         cnd_broadcast(&thpool->run_cond);
-        usleep(200000);
+        mtx_unlock(&thpool->run_mutex);
     }
 
-    // Free any jobs left in the queue that have not been consumed
-    job_t * job = thpool->work_queue->job_head;
-    job_t * temp;
-    while (NULL != job)
+    // Wait for the threads to exit
+    for (uint8_t i = 0; i < thpool->workers_started; i++)
     {
-        temp = job->next_job;
-        job->next_job = NULL;
-        free(job);
-        job = temp;
+        thrd_join(thpool->workers[i]->thread, NULL);
     }
 
     // Free the threads
     for (uint8_t i = 0; i < thpool->thread_count; i++)
     {
         worker_t * worker = thpool->workers[i];
-        worker->thpool = NULL;
-        free(worker);
+        if (NULL != worker)
+        {
+            worker->thpool = NULL;
+            free(worker);
+        }
     }
 
 
     // Free the mutexes
     mtx_destroy(&thpool->run_mutex);
     cnd_destroy(&thpool->run_cond);
-    mtx_destroy(&thpool->work_queue->queue_access_mutex);
+    cnd_destroy(&thpool->alive_cond);
+    mtx_destroy(&thpool->wait_mutex);
+    cnd_destroy(&thpool->wait_cond);
 
+    // Jobs left in the queue live in its slots so there is nothing to free
+    free(thpool->work_queue->slots);
     free(thpool->work_queue);
     thpool->work_queue = NULL;
 
@@ -305,13 +400,19 @@ void thpool_destroy(thpool_t ** thpool_ptr)
 
 
 /*!
- * @brief Queue up a new task to the work queue. This will trigger a signal
- * to the threadpool to check the queue and consume a new task for one of
- * the threads.
+ * @brief Queue up a new task. This will trigger a signal to the threadpool
+ * to check the queues and consume a new task for one of the threads.
+ *
+ * A job enqueued from a job running on one of the pool's workers goes onto
+ * that worker's deque, it runs there next unless an idle worker steals it
+ * first. Any other job goes to the shared work queue. The work queue holds
+ * THPOOL_QUEUE_SIZE jobs, a job is refused instead of waiting for room when
+ * the queue is full.
  * @param thpool Pointer to thpool object
  * @param job_function Function callback to assign the thread
  * @param job_arg Argument used to pass to the callback function
- * @return Status indicating if a successful enqueue occured
+ * @return THP_SUCCESS if the job was queued or THP_FAILURE if the queue is
+ * full
  */
 thpool_status thpool_enqueue_job(thpool_t * thpool, void (* job_function)(void *), void * job_arg)
 {
@@ -319,77 +420,551 @@ thpool_status thpool_enqueue_job(thpool_t * thpool, void (* job_function)(void *
     assert(thpool);
     assert(job_function);
 
-    job_t * job = (job_t *)malloc(sizeof(job_t));
-    if (UV_INVALID_ALLOC == verify_alloc(job))
+    job_t job = {.job_function = job_function, .job_arg = job_arg};
+    return thpool_enqueue(thpool, &job);
+}
+
+/*!
+ * @brief Queue up a new task like thpool_enqueue_job but copy its argument
+ * into the job instead of passing a pointer along. The callback receives a
+ * pointer to the copy which is only valid until it returns, so small values
+ * such as a file descriptor need no allocation to outlive the caller.
+ * @param thpool Pointer to thpool object
+ * @param job_function Function callback to assign the thread
+ * @param job_arg Pointer to the argument to copy
+ * @param arg_size Size of the argument, at most THPOOL_INLINE_ARG_SIZE
+ * @return THP_SUCCESS if the job was queued or THP_FAILURE if the queue is
+ * full or the argument is too large
+ */
+thpool_status thpool_enqueue_inline(thpool_t * thpool,
+                                    void (* job_function)(void *),
+                                    const void * job_arg,
+                                    size_t arg_size)
+{
+    assert(thpool);
+    assert(job_function);
+
+    if ((arg_size > THPOOL_INLINE_ARG_SIZE) || ((NULL == job_arg) && (0 != arg_size)))
     {
+        debug_print_err("Inline job argument of %zu bytes is not supported\n", arg_size);
         return THP_FAILURE;
     }
 
-    job->job_arg = job_arg;
-    job->job_function = job_function;
-    job->next_job = NULL;
+    job_t job = {.job_function = job_function, .arg_inline = 1};
+    if (0 != arg_size)
+    {
+        memcpy(job.inline_arg, job_arg, arg_size);
+    }
+    return thpool_enqueue(thpool, &job);
+}
+
+/*!
+ * @brief Publish a job on the deque of the calling worker or on the shared
+ * work queue and wake a sleeping worker for it
+ * @param thpool Pointer to thpool object
+ * @param job Job to copy into the queue
+ * @return THP_SUCCESS if the job was queued or THP_FAILURE if the queue is
+ * full
+ */
+static thpool_status thpool_enqueue(thpool_t * thpool, const job_t * job)
+{
     work_queue_t * work_queue = thpool->work_queue;
 
-    mtx_lock(&work_queue->queue_access_mutex);
+    // Count the job before it is published so a consumer can never take the
+    // count below zero. A worker that wakes up for it before it is published
+    // finds the queues empty and tries again.
+    atomic_fetch_add(&work_queue->job_count, 1);
 
-    // If job queue is empty then assign the new job as the head and tail
-    if (0 == atomic_load(&work_queue->job_count))
+    uint8_t queued = 0;
+    if ((NULL != current_worker) && (thpool == current_worker->thpool))
     {
-        work_queue->job_head = job;
-        work_queue->job_tail = job;
+        queued = deque_push(&current_worker->deque, job);
     }
-    else // If work queue HAS jobs already
+    if (0 == queued)
     {
-        work_queue->job_tail->next_job = job;
-        work_queue->job_tail = job;
+        queued = thpool_inject_job(work_queue, job);
+    }
+    if (0 == queued)
+    {
+        debug_print("%s", "[THPOOL] Work queue is full, job refused\n");
+        if (1 == atomic_fetch_sub(&work_queue->job_count, 1))
+        {
+            signal_wait_cond(thpool);
+        }
+        return THP_FAILURE;
     }
-    atomic_fetch_add(&work_queue->job_count, 1);
 
-    // Signal at least one thread that the run condition has changed
-    // indicating that a new job has been added to the queue
     debug_print("[THPOOL] New job enqueued. Total jobs in queue: %ld\n",
                 atomic_load(&work_queue->job_count));
 
+    wake_workers(thpool, 1);
+    return THP_SUCCESS;
+}
+
+/*!
+ * @brief Queue up count jobs running the same function, one per argument.
+ * All the jobs are claimed in the queue at once and published together, the
+ * sleeping workers are then woken with a single signal or broadcast instead
+ * of one signal per job. Either every job is queued or none is.
+ * @param thpool Pointer to thpool object
+ * @param job_function Function callback to assign the threads
+ * @param job_args Array of count arguments, one for each job
+ * @param count Number of jobs, at most THPOOL_QUEUE_SIZE
+ * @return THP_SUCCESS if all the jobs were queued or THP_FAILURE if the
+ * queue does not have room for all of them
+ */
+thpool_status thpool_enqueue_batch(thpool_t * thpool,
+                                   void (* job_function)(void *),
+                                   void ** job_args,
+                                   size_t count)
+{
+    assert(thpool);
+    assert(job_function);
+    assert(job_args);
+
+    if (0 == count)
+    {
+        return THP_SUCCESS;
+    }
+
+    work_queue_t * work_queue = thpool->work_queue;
+    atomic_fetch_add(&work_queue->job_count, count);
+
+    uint8_t queued = 0;
+    if ((NULL != current_worker) && (thpool == current_worker->thpool))
+    {
+        queued = deque_push_batch(&current_worker->deque, job_function, job_args, count);
+    }
+    if (0 == queued)
+    {
+        queued = thpool_inject_batch(work_queue, job_function, job_args, count);
+    }
+    if (0 == queued)
+    {
+        debug_print("[THPOOL] Work queue has no room for %zu jobs, batch refused\n", count);
+        if (count == atomic_fetch_sub(&work_queue->job_count, count))
+        {
+            signal_wait_cond(thpool);
+        }
+        return THP_FAILURE;
+    }
+
+    debug_print("[THPOOL] %zu jobs enqueued. Total jobs in queue: %ld\n",
+                count, atomic_load(&work_queue->job_count));
 
-    mtx_unlock(&work_queue->queue_access_mutex);
-    cnd_signal(&thpool->run_cond);
+    wake_workers(thpool, count);
     return THP_SUCCESS;
 }
 
+/*!
+ * @brief Wake up to count sleeping workers for newly queued jobs. The run
+ * lock is only taken when a worker is asleep. A worker counts itself as
+ * sleeping before it checks the job count, so either it sees the jobs or
+ * this sees it sleeping and the signal is sent after it waits.
+ * @param thpool Pointer to thpool object
+ * @param count Number of jobs queued
+ */
+static void wake_workers(thpool_t * thpool, size_t count)
+{
+    size_t sleeping = atomic_load(&thpool->workers_sleeping);
+    if (0 == sleeping)
+    {
+        return;
+    }
+
+    mtx_lock(&thpool->run_mutex);
+    if (1 == count)
+    {
+        cnd_signal(&thpool->run_cond);
+    }
+    else if (count >= sleeping)
+    {
+        cnd_broadcast(&thpool->run_cond);
+    }
+    else
+    {
+        for (size_t worker = 0; worker < count; worker++)
+        {
+            cnd_signal(&thpool->run_cond);
+        }
+    }
+    mtx_unlock(&thpool->run_mutex);
+}
 
 /*!
- * @brief Remove a job from the job queue
- * @param thpool Pointer to the thpool object
- * @return Pointer to the next job object
+ * @brief Write a job into the next free slot of the shared work queue
+ * @param work_queue Pointer to the work queue
+ * @param job Job to copy into the slot
+ * @return 1 if the job was queued or 0 if the queue is full
  */
-static job_t * thpool_dequeue_job(thpool_t * thpool)
+static uint8_t thpool_inject_job(work_queue_t * work_queue, const job_t * job)
 {
-    mtx_lock(&thpool->work_queue->queue_access_mutex);
-    work_queue_t * work_queue = thpool->work_queue;
+    job_slot_t * slot = NULL;
+    size_t pos = atomic_load_explicit(&work_queue->enqueue_pos, memory_order_relaxed);
+    while (1)
+    {
+        slot = &work_queue->slots[pos & work_queue->slot_mask];
+        size_t sequence = atomic_load_explicit(&slot->sequence, memory_order_acquire);
+        intptr_t diff = (intptr_t)sequence - (intptr_t)pos;
+        if (0 == diff)
+        {
+            // The slot is free, claim it by moving the enqueue position
+            if (atomic_compare_exchange_weak_explicit(&work_queue->enqueue_pos, &pos, pos + 1,
+                                                      memory_order_relaxed, memory_order_relaxed))
+            {
+                break;
+            }
+        }
+        else if (diff < 0)
+        {
+            // The slot still holds the job from a lap ago, the queue is full
+            return 0;
+        }
+        else
+        {
+            // Another producer claimed the slot first
+            pos = atomic_load_explicit(&work_queue->enqueue_pos, memory_order_relaxed);
+        }
+    }
 
-    job_t * work = work_queue->job_head;
+    slot->job = *job;
+    atomic_store_explicit(&slot->sequence, pos + 1, memory_order_release);
+    return 1;
+}
 
-    // If there is only one job queued, then prep the queue to point to "none"
-    if (1 == atomic_load(&work_queue->job_count))
+/*!
+ * @brief Claim count consecutive slots of the shared work queue with a
+ * single compare and swap and write a job into each of them. A free slot
+ * stays free until its position is claimed, so the slots checked before the
+ * claim succeeds are still free after it.
+ * @param work_queue Pointer to the work queue
+ * @param job_function Function callback of the jobs
+ * @param job_args Array of count arguments, one for each job
+ * @param count Number of jobs
+ * @return 1 if the jobs were queued or 0 if the queue does not have room for
+ * all of them
+ */
+static uint8_t thpool_inject_batch(work_queue_t * work_queue,
+                                   job_function_t job_function,
+                                   void ** job_args,
+                                   size_t count)
+{
+    if (count > THPOOL_QUEUE_SIZE)
     {
-        work_queue->job_head = NULL;
-        work_queue->job_tail = NULL;
-        atomic_fetch_sub(&work_queue->job_count, 1);
+        return 0;
     }
 
-    // Else if the queue has more than on task left, then update head to
-    // point to the next item
-    else if (atomic_load(&work_queue->job_count) > 1)
+    size_t pos = atomic_load_explicit(&work_queue->enqueue_pos, memory_order_relaxed);
+    while (1)
     {
-        work_queue->job_head = work->next_job;
-        atomic_fetch_sub(&work_queue->job_count, 1);
+        intptr_t diff = 0;
+        for (size_t job = 0; (job < count) && (0 == diff); job++)
+        {
+            job_slot_t * slot = &work_queue->slots[(pos + job) & work_queue->slot_mask];
+            size_t sequence = atomic_load_explicit(&slot->sequence, memory_order_acquire);
+            diff = (intptr_t)sequence - (intptr_t)(pos + job);
+        }
+
+        if (0 == diff)
+        {
+            // Every slot is free, claim them all by moving the enqueue position
+            if (atomic_compare_exchange_weak_explicit(&work_queue->enqueue_pos, &pos, pos + count,
+                                                      memory_order_relaxed, memory_order_relaxed))
+            {
+                break;
+            }
+        }
+        else if (diff < 0)
+        {
+            // A slot still holds the job from a lap ago, there is no room
+            return 0;
+        }
+        else
+        {
+            // Another producer claimed some of the slots first
+            pos = atomic_load_explicit(&work_queue->enqueue_pos, memory_order_relaxed);
+        }
+    }
+
+    for (size_t job = 0; job < count; job++)
+    {
+        job_slot_t * slot = &work_queue->slots[(pos + job) & work_queue->slot_mask];
+        slot->job = (job_t){.job_function = job_function, .job_arg = job_args[job]};
+        atomic_store_explicit(&slot->sequence, pos + job + 1, memory_order_release);
+    }
+    return 1;
+}
+
+/*!
+ * @brief Remove a job from the shared work queue
+ * @param work_queue Pointer to the work queue
+ * @param job Written with the function and argument of the job
+ * @return 1 if a job was removed or 0 if the queue is empty
+ */
+static uint8_t thpool_dequeue_job(work_queue_t * work_queue, job_t * job)
+{
+    job_slot_t * slot = NULL;
+    size_t pos = atomic_load_explicit(&work_queue->dequeue_pos, memory_order_relaxed);
+    while (1)
+    {
+        slot = &work_queue->slots[pos & work_queue->slot_mask];
+        size_t sequence = atomic_load_explicit(&slot->sequence, memory_order_acquire);
+        intptr_t diff = (intptr_t)sequence - (intptr_t)(pos + 1);
+        if (0 == diff)
+        {
+            // The slot holds a job, claim it by moving the dequeue position
+            if (atomic_compare_exchange_weak_explicit(&work_queue->dequeue_pos, &pos, pos + 1,
+                                                      memory_order_relaxed, memory_order_relaxed))
+            {
+                break;
+            }
+        }
+        else if (diff < 0)
+        {
+            // The slot has not been written yet, the queue is empty
+            return 0;
+        }
+        else
+        {
+            // Another consumer claimed the slot first
+            pos = atomic_load_explicit(&work_queue->dequeue_pos, memory_order_relaxed);
+        }
+    }
+
+    *job = slot->job;
+
+    // Hand the slot back to producers for the next lap of the ring
+    atomic_store_explicit(&slot->sequence, pos + work_queue->slot_mask + 1, memory_order_release);
+    return 1;
+}
+
+/*!
+ * @brief Push a job onto the bottom of a deque. Only the owner may push.
+ * @param deque Pointer to the deque of the calling worker
+ * @param job Job to copy onto the deque
+ * @return 1 if the job was pushed or 0 if the deque is full
+ */
+static uint8_t deque_push(work_deque_t * deque, const job_t * job)
+{
+    size_t bottom = atomic_load_explicit(&deque->bottom, memory_order_relaxed);
+    size_t top = atomic_load_explicit(&deque->top, memory_order_acquire);
+    if ((bottom - top) >= DEQUE_SIZE)
+    {
+        return 0;
     }
 
-    mtx_unlock(&work_queue->queue_access_mutex);
+    deque_job_t * slot = &deque->jobs[bottom & (DEQUE_SIZE - 1)];
+    atomic_store_explicit(&slot->job_function, job->job_function, memory_order_relaxed);
+    atomic_store_explicit(&slot->job_arg, job->job_arg, memory_order_relaxed);
+    atomic_store_explicit(&slot->arg_inline, job->arg_inline, memory_order_relaxed);
+    if (1 == job->arg_inline)
+    {
+        for (size_t word = 0; word < INLINE_WORDS; word++)
+        {
+            atomic_store_explicit(&slot->inline_arg[word], job->inline_arg[word], memory_order_relaxed);
+        }
+    }
+    atomic_thread_fence(memory_order_release);
+    atomic_store_explicit(&deque->bottom, bottom + 1, memory_order_relaxed);
+    return 1;
+}
+
+/*!
+ * @brief Push count jobs onto the bottom of a deque, thieves see all of them
+ * at once. Only the owner may push.
+ * @param deque Pointer to the deque of the calling worker
+ * @param job_function Function callback of the jobs
+ * @param job_args Array of count arguments, one for each job
+ * @param count Number of jobs
+ * @return 1 if the jobs were pushed or 0 if the deque does not have room for
+ * all of them
+ */
+static uint8_t deque_push_batch(work_deque_t * deque,
+                                job_function_t job_function,
+                                void ** job_args,
+                                size_t count)
+{
+    size_t bottom = atomic_load_explicit(&deque->bottom, memory_order_relaxed);
+    size_t top = atomic_load_explicit(&deque->top, memory_order_acquire);
+    if ((count > DEQUE_SIZE) || ((bottom - top) > (DEQUE_SIZE - count)))
+    {
+        return 0;
+    }
 
-    // Signal the threadpool that there are tasks in the queue
-    cnd_signal(&thpool->run_cond);
-    return work;
+    for (size_t job = 0; job < count; job++)
+    {
+        deque_job_t * slot = &deque->jobs[(bottom + job) & (DEQUE_SIZE - 1)];
+        atomic_store_explicit(&slot->job_function, job_function, memory_order_relaxed);
+        atomic_store_explicit(&slot->job_arg, job_args[job], memory_order_relaxed);
+        atomic_store_explicit(&slot->arg_inline, 0, memory_order_relaxed);
+    }
+    atomic_thread_fence(memory_order_release);
+    atomic_store_explicit(&deque->bottom, bottom + count, memory_order_relaxed);
+    return 1;
+}
+
+/*!
+ * @brief Take the newest job from the bottom of a deque. Only the owner may
+ * take, it only races thieves for the last job.
+ * @param deque Pointer to the deque of the calling worker
+ * @param job Written with the function and argument of the job
+ * @return 1 if a job was taken or 0 if the deque is empty
+ */
+static uint8_t deque_take(work_deque_t * deque, job_t * job)
+{
+    size_t bottom = atomic_load_explicit(&deque->bottom, memory_order_relaxed);
+    size_t top = atomic_load_explicit(&deque->top, memory_order_relaxed);
+    if (bottom == top)
+    {
+        return 0;
+    }
+
+    // Reserve the bottom job before looking at top again. The fence orders
+    // the reservation against the thieves reading bottom.
+    bottom = bottom - 1;
+    atomic_store_explicit(&deque->bottom, bottom, memory_order_relaxed);
+    atomic_thread_fence(memory_order_seq_cst);
+    top = atomic_load_explicit(&deque->top, memory_order_relaxed);
+
+    uint8_t taken = 1;
+    if ((intptr_t)(bottom - top) < 0)
+    {
+        // A thief took the last job
+        taken = 0;
+    }
+    else
+    {
+        deque_read(&deque->jobs[bottom & (DEQUE_SIZE - 1)], job);
+        if (bottom != top)
+        {
+            return 1;
+        }
+
+        // Last job, whoever moves top first gets it
+        if (!atomic_compare_exchange_strong_explicit(&deque->top, &top, top + 1,
+                                                     memory_order_seq_cst, memory_order_relaxed))
+        {
+            taken = 0;
+        }
+    }
+    atomic_store_explicit(&deque->bottom, bottom + 1, memory_order_relaxed);
+    return taken;
+}
+
+/*!
+ * @brief Steal the oldest job from the top of another worker's deque
+ * @param deque Pointer to the deque of the victim
+ * @param job Written with the function and argument of the job
+ * @return 1 if a job was stolen or 0 if the deque is empty or another
+ * worker won the job
+ */
+static uint8_t deque_steal(work_deque_t * deque, job_t * job)
+{
+    size_t top = atomic_load_explicit(&deque->top, memory_order_acquire);
+    atomic_thread_fence(memory_order_seq_cst);
+    size_t bottom = atomic_load_explicit(&deque->bottom, memory_order_acquire);
+    if ((intptr_t)(bottom - top) <= 0)
+    {
+        return 0;
+    }
+
+    // The job is only ours if top has not moved since it was read
+    deque_read(&deque->jobs[top & (DEQUE_SIZE - 1)], job);
+    if (!atomic_compare_exchange_strong_explicit(&deque->top, &top, top + 1,
+                                                 memory_order_seq_cst, memory_order_relaxed))
+    {
+        return 0;
+    }
+    return 1;
+}
+
+/*!
+ * @brief Copy a job out of a deque slot
+ * @param slot Pointer to the deque slot
+ * @param job Written with the job held by the slot
+ */
+static void deque_read(deque_job_t * slot, job_t * job)
+{
+    job->job_function = atomic_load_explicit(&slot->job_function, memory_order_relaxed);
+    job->job_arg = atomic_load_explicit(&slot->job_arg, memory_order_relaxed);
+    job->arg_inline = atomic_load_explicit(&slot->arg_inline, memory_order_relaxed);
+    if (1 == job->arg_inline)
+    {
+        for (size_t word = 0; word < INLINE_WORDS; word++)
+        {
+            job->inline_arg[word] = atomic_load_explicit(&slot->inline_arg[word], memory_order_relaxed);
+        }
+    }
+}
+
+/*!
+ * @brief Steal a job from the other workers. The first victim is picked at
+ * random so idle workers spread out instead of all raiding the same deque.
+ * @param worker Pointer to the calling worker
+ * @param job Written with the function and argument of the job
+ * @return 1 if a job was stolen else 0
+ */
+static uint8_t steal_job(worker_t * worker, job_t * job)
+{
+    thpool_t * thpool = worker->thpool;
+    uint8_t thread_count = thpool->thread_count;
+
+    // xorshift32
+    uint32_t seed = worker->steal_seed;
+    seed ^= seed << 13;
+    seed ^= seed >> 17;
+    seed ^= seed << 5;
+    worker->steal_seed = seed;
+
+    uint8_t first = (uint8_t)(seed % thread_count);
+    for (uint8_t offset = 0; offset < thread_count; offset++)
+    {
+        worker_t * victim = thpool->workers[(first + offset) % thread_count];
+        if ((victim != worker) && (1 == deque_steal(&victim->deque, job)))
+        {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+/*!
+ * @brief Find the next job for a worker: the newest job of its own deque,
+ * then the oldest job of the shared work queue, then a job stolen from
+ * another worker
+ * @param worker Pointer to the calling worker
+ * @param job Written with the job, an inline argument is pointed to by its
+ * job_arg
+ * @return 1 if a job was found else 0
+ */
+static uint8_t find_job(worker_t * worker, job_t * job)
+{
+    work_queue_t * work_queue = worker->thpool->work_queue;
+    if ((1 == deque_take(&worker->deque, job))
+        || (1 == thpool_dequeue_job(work_queue, job))
+        || (1 == steal_job(worker, job)))
+    {
+        if (1 == job->arg_inline)
+        {
+            job->job_arg = job->inline_arg;
+        }
+        atomic_fetch_sub(&work_queue->job_count, 1);
+        return 1;
+    }
+    return 0;
+}
+
+/*!
+ * @brief Wake thpool_wait when the pool has run out of work. The wait mutex
+ * is held while signaling so the signal can not slip in between thpool_wait
+ * checking the counters and blocking.
+ * @param thpool Pointer to the thpool object
+ */
+static void signal_wait_cond(thpool_t * thpool)
+{
+    mtx_lock(&thpool->wait_mutex);
+    cnd_signal(&thpool->wait_cond);
+    mtx_unlock(&thpool->wait_mutex);
 }
 
 /*!
@@ -400,22 +975,29 @@ static job_t * thpool_dequeue_job(thpool_t * thpool)
  */
 static void thread_pool(worker_t * worker)
 {
-    // Increment the number of threads alive. This is useful to indicate that
-    // a thread has successfully init
-    atomic_fetch_add(&worker->thpool->workers_alive, 1);
+    // Increment the number of threads alive and tell thpool_init that this
+    // thread has successfully init
     thpool_t * thpool = worker->thpool;
+    mtx_lock(&thpool->run_mutex);
+    atomic_fetch_add(&thpool->workers_alive, 1);
+    cnd_signal(&thpool->alive_cond);
+    mtx_unlock(&thpool->run_mutex);
+    work_queue_t * work_queue = thpool->work_queue;
+    current_worker = worker;
 
     while (1 == atomic_load(&thpool->thpool_active))
     {
         mtx_lock(&thpool->run_mutex);
 
         // Block while the work queue is empty
-        while ((0 == atomic_load(&thpool->work_queue->job_count)) && (1 == atomic_load(&thpool->thpool_active)))
+        atomic_fetch_add(&thpool->workers_sleeping, 1);
+        while ((0 == atomic_load(&work_queue->job_count)) && (1 == atomic_load(&thpool->thpool_active)))
         {
             debug_print("[THPOOL] Thread %d waiting for a job...[threads: %d || working: %d]\n",
                         worker->id, thpool->workers_alive, thpool->workers_working);
             cnd_wait(&thpool->run_cond, &thpool->run_mutex);
         }
+        atomic_fetch_sub(&thpool->workers_sleeping, 1);
 
         // As soon as the thread wakes up, unlock the run lock
         // We do not need it locked for operation
@@ -427,9 +1009,9 @@ static void thread_pool(worker_t * worker)
         {
             // If there is no more work, signal the wait_cond about no work
             // being available incase it is waiting for the queue to be empty
-            if (0 == atomic_load(&thpool->work_queue->job_count))
+            if (0 == atomic_load(&work_queue->job_count))
             {
-                cnd_signal(&thpool->wait_cond);
+                signal_wait_cond(thpool);
             }
             break;
         }
@@ -443,13 +1025,12 @@ static void thread_pool(worker_t * worker)
                     atomic_load(&thpool->workers_working));
 
         /*
-         * Fetch a job and execute it
+         * Run jobs until none are left to find or steal
          */
-        job_t * job = thpool_dequeue_job(thpool);
-        if (NULL != job)
+        job_t job;
+        while (1 == find_job(worker, &job))
         {
-            job->job_function(job->job_arg);
-            free(job);
+            job.job_function(job.job_arg);
         }
 
         // Decrement threads working before going back to blocking
@@ -462,9 +1043,9 @@ static void thread_pool(worker_t * worker)
 
         // If there is no more work, signal the wait_cond about no work
         // being available incase it is waiting for the queue to be empty
-        if (0 == atomic_load(&thpool->work_queue->job_count))
+        if ((0 == atomic_load(&work_queue->job_count)) && (0 == atomic_load(&thpool->workers_working)))
         {
-            cnd_signal(&thpool->wait_cond);
+            signal_wait_cond(thpool);
         }
     }
 
@@ -475,4 +1056,3 @@ static void thread_pool(worker_t * worker)
     atomic_fetch_sub(&thpool->workers_alive, 1);
     return;
 }
-
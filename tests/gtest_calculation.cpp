@@ -1,5 +1,16 @@
 #include <gtest/gtest.h>
 #include <calculation.h>
+#include <result_cache.h>
+#include <thread>
+
+extern "C"
+{
+    isa_level_t choose_isa_level(const char * forced, isa_level_t widest);
+    uint16_t sample_duplicates(const uint64_t * l_operand,
+                               const uint8_t * opt,
+                               const uint64_t * r_operand,
+                               uint16_t count);
+}
 
 struct hexchar
 {
@@ -16,6 +27,68 @@ std::ostream& operator<<(std::ostream& os, hexchar h)
     return os;
 }
 
+// Solve a single equation through solve_columns and expect the same output
+// the callback produced for eq
+void expect_columns_match(solution_t * eq, uint64_t l_opr, uint8_t opt, uint64_t r_optr)
+{
+    uint64_t solution = 0xA5A5A5A5A5A5A5A5;
+    uint8_t sign = 0;
+    uint8_t result = EQ_UNSOLVED;
+    solve_columns(&l_opr, &opt, &r_optr, 1, &solution, &sign, &result);
+
+    EXPECT_EQ(result, eq->result) << l_opr << " (" << hexchar{(char)opt} << ") " << r_optr;
+    EXPECT_EQ(sign, eq->sign) << l_opr << " (" << hexchar{(char)opt} << ") " << r_optr;
+    EXPECT_EQ(solution, eq->solution) << l_opr << " (" << hexchar{(char)opt} << ") " << r_optr;
+}
+
+// Solve every operator from first_opt to last_opt over every pair of values
+// as one set of columns under each supported SIMD variant and expect the
+// same outputs as the scalar kernels
+void expect_variants_match_scalar(const std::vector<uint64_t> & values, uint8_t first_opt, uint8_t last_opt)
+{
+    std::vector<uint64_t> l_operands;
+    std::vector<uint8_t> opts;
+    std::vector<uint64_t> r_operands;
+    for (uint8_t opt = first_opt; opt <= last_opt; opt++)
+    {
+        for (uint64_t l_opr : values)
+        {
+            for (uint64_t r_opr : values)
+            {
+                l_operands.push_back(l_opr);
+                opts.push_back(opt);
+                r_operands.push_back(r_opr);
+            }
+        }
+    }
+
+    size_t count = opts.size();
+    std::vector<uint64_t> expected_solution(count);
+    std::vector<uint8_t> expected_sign(count);
+    std::vector<uint8_t> expected_result(count);
+    solve_variant_t original = get_solve_variant();
+    ASSERT_EQ(set_solve_variant(SOLVE_VARIANT_SCALAR), 1);
+    solve_columns(l_operands.data(), opts.data(), r_operands.data(), count,
+                  expected_solution.data(), expected_sign.data(), expected_result.data());
+
+    for (solve_variant_t variant : {SOLVE_VARIANT_AVX2, SOLVE_VARIANT_AVX512})
+    {
+        if (0 == set_solve_variant(variant))
+        {
+            continue;
+        }
+        std::vector<uint64_t> solution(count);
+        std::vector<uint8_t> sign(count);
+        std::vector<uint8_t> result(count);
+        solve_columns(l_operands.data(), opts.data(), r_operands.data(), count,
+                      solution.data(), sign.data(), result.data());
+        EXPECT_EQ(solution, expected_solution) << "Variant " << variant;
+        EXPECT_EQ(sign, expected_sign) << "Variant " << variant;
+        EXPECT_EQ(result, expected_result) << "Variant " << variant;
+    }
+    set_solve_variant(original);
+}
+
 // Simple function to get started
 TEST(TestAllocs, TestAllocs)
 {
@@ -25,6 +98,561 @@ TEST(TestAllocs, TestAllocs)
     free_equation_struct(eq);
 }
 
+// Failed equations carry a status instead of an allocated message
+TEST(TestAllocs, FailuresReportStatus)
+{
+    const struct
+    {
+        uint64_t l_opr;
+        uint8_t opt;
+        uint64_t r_opr;
+        eq_status_t status;
+    } cases[] = {
+        {10, 0x01, 30, EQ_STATUS_OK},
+        {(uint64_t)INT64_MAX, 0x01, 1, EQ_STATUS_OVERFLOW},
+        {(uint64_t)INT64_MIN, 0x02, 1, EQ_STATUS_UNDERFLOW},
+        {(uint64_t)INT64_MAX, 0x03, 2, EQ_STATUS_OVERFLOW},
+        {(uint64_t)-2, 0x03, (uint64_t)INT64_MAX, EQ_STATUS_UNDERFLOW},
+        {5, 0x03, (uint64_t)-1, EQ_STATUS_OVERFLOW},
+        {(uint64_t)-1, 0x03, (uint64_t)INT64_MIN, EQ_STATUS_OVERFLOW},
+        {(uint64_t)INT64_MIN, 0x03, (uint64_t)-2, EQ_STATUS_UNDERFLOW},
+        {(uint64_t)INT64_MIN, 0x04, (uint64_t)-1, EQ_STATUS_OVERFLOW},
+        {10, 0x04, 0, EQ_STATUS_DIV_BY_ZERO},
+        {10, 0x05, 0, EQ_STATUS_DIV_BY_ZERO},
+        {10, 0x0e, 3, EQ_STATUS_UNKNOWN_OPERATOR},
+    };
+
+    for (const auto & test : cases)
+    {
+        solution_t * eq = get_equation_struct(0, test.l_opr, test.opt, test.r_opr);
+        ASSERT_NE(eq, nullptr);
+        EXPECT_EQ(eq->status, test.status) << hexchar{(char)test.opt};
+        EXPECT_EQ(eq->result, (EQ_STATUS_OK == test.status) ? EQ_SOLVED : EQ_FAILURE);
+        EXPECT_NE(get_status_message(eq->status), nullptr);
+        free_equation_struct(eq);
+    }
+    EXPECT_STREQ(get_status_message(EQ_STATUS_DIV_BY_ZERO), "Division by zero error");
+    EXPECT_STREQ(get_status_message((eq_status_t)(EQ_STATUS_UNKNOWN_OPERATOR + 1)), "Unknown status");
+}
+
+// Every byte code outside of OPERATORS is unknown and every code in it takes
+// the sign type listed for it
+TEST(TestAllocs, EveryOperatorCode)
+{
+    eq_eval_type_t signs[UINT8_MAX + 1] = {};
+#define OPERATOR_SIGN(code, name, sign, cached) signs[code] = sign;
+    OPERATORS(OPERATOR_SIGN)
+#undef OPERATOR_SIGN
+
+    for (uint16_t opt = 0; opt <= UINT8_MAX; opt++)
+    {
+        solution_t * eq = get_equation_struct(0, 6, (uint8_t)opt, 3);
+        ASSERT_NE(eq, nullptr);
+        if ((opt < OPERATOR_MIN) || (opt > OPERATOR_MAX))
+        {
+            EXPECT_EQ(eq->status, EQ_STATUS_UNKNOWN_OPERATOR) << hexchar{(char)opt};
+            EXPECT_EQ(eq->result, EQ_FAILURE) << hexchar{(char)opt};
+            EXPECT_EQ(eq->sign, EQ_VAL_UNSIGNED) << hexchar{(char)opt};
+        }
+        else
+        {
+            EXPECT_EQ(eq->result, EQ_SOLVED) << hexchar{(char)opt};
+            EXPECT_EQ(eq->sign, signs[opt]) << hexchar{(char)opt};
+        }
+        free_equation_struct(eq);
+    }
+}
+
+// Every column starts on its own cache line and none of them overlap
+TEST(TestBatch, ColumnsShareOneAlignedAllocation)
+{
+    for (uint64_t count : {(uint64_t)0, (uint64_t)1, (uint64_t)13, (uint64_t)4096})
+    {
+        equ_batch_t * batch = get_equation_batch(count);
+        ASSERT_NE(batch, nullptr);
+        uint64_t slots = (0 == count) ? 1 : count;
+        const std::pair<uintptr_t, size_t> columns[] = {
+            {(uintptr_t)batch->l_operand, slots * sizeof(uint64_t)},
+            {(uintptr_t)batch->r_operand, slots * sizeof(uint64_t)},
+            {(uintptr_t)batch->solution, slots * sizeof(uint64_t)},
+            {(uintptr_t)batch->eq_id, slots * sizeof(uint32_t)},
+            {(uintptr_t)batch->flags, slots},
+            {(uintptr_t)batch->opt, slots},
+            {(uintptr_t)batch->sign, slots},
+            {(uintptr_t)batch->result, slots},
+        };
+        uintptr_t end = (uintptr_t)(batch + 1);
+        for (const auto & [start, size] : columns)
+        {
+            EXPECT_EQ(start % 64, 0) << count;
+            EXPECT_GE(start, end) << count;
+            end = start + size;
+        }
+
+        // Columns start zeroed and are writable to their last slot
+        EXPECT_EQ(batch->result[slots - 1], 0);
+        batch->l_operand[slots - 1] = 1;
+        batch->result[slots - 1] = EQ_SOLVED;
+        free_equation_batch(batch);
+    }
+
+    // A count whose columns do not fit in memory is refused up front
+    EXPECT_EQ(get_equation_batch(UINT64_MAX), nullptr);
+    EXPECT_EQ(get_equation_batch(UINT64_MAX / 8), nullptr);
+}
+
+// The batch solver runs the same callbacks as get_equation_struct
+TEST(TestBatch, MatchesSingleEquations)
+{
+    const uint64_t l_operands[] = {10, (uint64_t)INT64_MAX, 1000, 1, 15, 90000, 0xFFFFFFFFFFFFFFFE, 3};
+    const uint8_t opts[] = {0x01, 0x01, 0x03, 0x04, 0x05, 0x0b, 0x0c, 0x0d};
+    const uint64_t r_operands[] = {30, 10, 1000000000, 0, 2, 114, 1, 3};
+    const uint64_t count = sizeof(opts) / sizeof(opts[0]);
+
+    equ_batch_t * batch = get_equation_batch(count);
+    ASSERT_NE(batch, nullptr);
+    for (uint64_t i = 0; i < count; i++)
+    {
+        batch->eq_id[i] = (uint32_t)i;
+        batch->l_operand[i] = l_operands[i];
+        batch->opt[i] = opts[i];
+        batch->r_operand[i] = r_operands[i];
+    }
+    solve_equation_batch(batch);
+
+    for (uint64_t i = 0; i < count; i++)
+    {
+        solution_t * eq = get_equation_struct((uint32_t)i, l_operands[i], opts[i], r_operands[i]);
+        ASSERT_NE(eq, nullptr);
+        EXPECT_EQ(batch->result[i], eq->result) << "Index " << i;
+        EXPECT_EQ(batch->sign[i], eq->sign) << "Index " << i;
+        if (EQ_SOLVED == eq->result)
+        {
+            EXPECT_EQ(batch->solution[i], eq->solution) << "Index " << i;
+        }
+        free_equation_struct(eq);
+    }
+    free_equation_batch(batch);
+}
+
+// Every operator over a grid of edge values, solved as one set of columns
+TEST(TestColumns, MatchesCallbacksOnEdgeValues)
+{
+    const uint64_t values[] = {
+        0, 1, 2, 3, 10, 63, 64, 65, 127, 1000000000,
+        (uint64_t)INT64_MAX, (uint64_t)INT64_MIN, (uint64_t)(INT64_MIN + 1),
+        (uint64_t)-1, (uint64_t)-2, (uint64_t)-10, 0xFFFFFFFF, 0x100000000,
+    };
+
+    std::vector<uint64_t> l_operands;
+    std::vector<uint8_t> opts;
+    std::vector<uint64_t> r_operands;
+    for (uint8_t opt = 0x00; opt <= 0x0e; opt++)
+    {
+        for (uint64_t l_opr : values)
+        {
+            for (uint64_t r_opr : values)
+            {
+                l_operands.push_back(l_opr);
+                opts.push_back(opt);
+                r_operands.push_back(r_opr);
+            }
+        }
+    }
+
+    size_t count = opts.size();
+    std::vector<uint64_t> solution(count);
+    std::vector<uint8_t> sign(count);
+    std::vector<uint8_t> result(count);
+    solve_columns(l_operands.data(), opts.data(), r_operands.data(), count,
+                  solution.data(), sign.data(), result.data());
+
+    for (size_t i = 0; i < count; i++)
+    {
+        solution_t * eq = get_equation_struct(0, l_operands[i], opts[i], r_operands[i]);
+        ASSERT_NE(eq, nullptr);
+        EXPECT_EQ(result[i], eq->result) << "Index " << i;
+        EXPECT_EQ(sign[i], eq->sign) << "Index " << i;
+        EXPECT_EQ(solution[i], eq->solution) << "Index " << i;
+        free_equation_struct(eq);
+    }
+}
+
+// The forced level is only taken when the CPU supports it, anything else
+// falls back to the widest level
+TEST(TestDispatch, ChoosesForcedLevel)
+{
+    EXPECT_EQ(choose_isa_level(NULL, ISA_AVX2), ISA_AVX2);
+    EXPECT_EQ(choose_isa_level("", ISA_AVX512), ISA_AVX512);
+    EXPECT_EQ(choose_isa_level("scalar", ISA_AVX512), ISA_SCALAR);
+    EXPECT_EQ(choose_isa_level("avx2", ISA_AVX512), ISA_AVX2);
+    EXPECT_EQ(choose_isa_level("avx512", ISA_AVX512), ISA_AVX512);
+    EXPECT_EQ(choose_isa_level("avx512", ISA_AVX2), ISA_AVX2);
+    EXPECT_EQ(choose_isa_level("sse4.2", ISA_AVX2), ISA_AVX2);
+    EXPECT_EQ(choose_isa_level("AVX2", ISA_SCALAR), ISA_SCALAR);
+
+    EXPECT_STREQ(get_isa_name(ISA_SCALAR), "scalar");
+    EXPECT_STREQ(get_isa_name(ISA_AVX512), "avx512");
+    EXPECT_STREQ(get_isa_name(ISA_COUNT), "unknown");
+    EXPECT_EQ(isa_supported(ISA_SCALAR), 1);
+    EXPECT_EQ(isa_supported(get_isa_level()), 1);
+}
+
+// The SIMD kernels must match the scalar kernels on every edge value. Each
+// operator is one long run so the vector loops and the tails are both used
+TEST(TestColumns, VariantsMatchScalar)
+{
+    const std::vector<uint64_t> values = {
+        0, 1, 2, 3, 10, 63, 64, 65, 127, 1000000000,
+        (uint64_t)INT64_MAX, (uint64_t)INT64_MIN, (uint64_t)(INT64_MIN + 1),
+        (uint64_t)-1, (uint64_t)-2, (uint64_t)-10, 0xFFFFFFFF, 0x100000000, 0x8000000000000040,
+    };
+    expect_variants_match_scalar(values, 0x00, 0x0d);
+}
+
+// Runs where every operand fits in 32 bits take the narrow SIMD kernels for
+// multiply, divide and modulo. They must match the scalar kernels exactly
+TEST(TestColumns, NarrowOperandsMatchScalar)
+{
+    const int64_t values[] = {
+        0, 1, 2, 3, 7, 10, 65536, INT32_MAX, INT32_MAX - 1,
+        -1, -2, -3, -7, -10, -65536, INT32_MIN, INT32_MIN + 1,
+    };
+    expect_variants_match_scalar(std::vector<uint64_t>(std::begin(values), std::end(values)), 0x01, 0x0c);
+}
+
+// Runs of one divisor are divided with a magic multiplier instead of the
+// hardware divide. Every numerator is checked against truncating division
+TEST(TestColumns, DivisorRunsMatchCallbacks)
+{
+    const int64_t divisors[] = {
+        2, 3, 5, 7, 10, 641, 6700417, -2, -3, -7, -1000, 1, -1, 0,
+        INT64_MAX, INT64_MIN, INT64_MIN + 1, (int64_t)1 << 32, -((int64_t)1 << 40), 0x5555555555555555,
+    };
+    std::vector<uint64_t> numerators = {
+        0, 1, 2, 3, 9, 10, 11, 1000000000,
+        (uint64_t)INT64_MAX, (uint64_t)INT64_MIN, (uint64_t)(INT64_MIN + 1),
+        (uint64_t)-1, (uint64_t)-2, (uint64_t)-10, (uint64_t)-11, 0xFFFFFFFF, 0x100000000,
+    };
+    srand(1234);
+    while (numerators.size() < 64)
+    {
+        numerators.push_back(((uint64_t)rand() << 33 | (uint64_t)rand()) >> (rand() % 64));
+        numerators.push_back(0 - numerators.back());
+    }
+
+    for (uint8_t opt : {(uint8_t)0x04, (uint8_t)0x05})
+    {
+        std::vector<uint64_t> l_operands;
+        std::vector<uint64_t> r_operands;
+        for (int64_t divisor : divisors)
+        {
+            for (uint64_t numerator : numerators)
+            {
+                l_operands.push_back(numerator);
+                r_operands.push_back((uint64_t)divisor);
+            }
+        }
+
+        size_t count = l_operands.size();
+        std::vector<uint8_t> opts(count, opt);
+        std::vector<uint64_t> solution(count);
+        std::vector<uint8_t> sign(count);
+        std::vector<uint8_t> result(count);
+        solve_columns(l_operands.data(), opts.data(), r_operands.data(), count,
+                      solution.data(), sign.data(), result.data());
+
+        for (size_t i = 0; i < count; i++)
+        {
+            solution_t * eq = get_equation_struct((uint32_t)i, l_operands[i], opt, r_operands[i]);
+            ASSERT_NE(eq, nullptr);
+            EXPECT_EQ(result[i], eq->result) << (int64_t)l_operands[i] << " (" << hexchar{(char)opt} << ") " << (int64_t)r_operands[i];
+            EXPECT_EQ(sign[i], eq->sign) << (int64_t)l_operands[i] << " (" << hexchar{(char)opt} << ") " << (int64_t)r_operands[i];
+            EXPECT_EQ(solution[i], eq->solution) << (int64_t)l_operands[i] << " (" << hexchar{(char)opt} << ") " << (int64_t)r_operands[i];
+            free_equation_struct(eq);
+        }
+    }
+}
+
+// Results are found again after being stored and a full set evicts instead
+// of growing
+TEST(TestResultCache, StoresAndEvicts)
+{
+    ASSERT_EQ(result_cache_enabled(), 0);
+    EXPECT_EQ(result_cache_init(0), -1);
+    ASSERT_EQ(result_cache_init(64), 0);
+    EXPECT_EQ(result_cache_init(64), -1);
+
+    uint64_t solution = 0;
+    uint8_t sign = 0;
+    uint8_t result = 0;
+    EXPECT_EQ(result_cache_lookup(10, 0x03, 3, &solution, &sign, &result), 0);
+    result_cache_store(10, 0x03, 3, 30, EQ_VAL_SIGNED, EQ_SOLVED);
+    ASSERT_EQ(result_cache_lookup(10, 0x03, 3, &solution, &sign, &result), 1);
+    EXPECT_EQ(solution, 30);
+    EXPECT_EQ(sign, EQ_VAL_SIGNED);
+    EXPECT_EQ(result, EQ_SOLVED);
+
+    // The key is the whole equation
+    EXPECT_EQ(result_cache_lookup(10, 0x04, 3, &solution, &sign, &result), 0);
+    EXPECT_EQ(result_cache_lookup(3, 0x03, 10, &solution, &sign, &result), 0);
+
+    for (uint64_t l_opr = 0; l_opr < 1024; l_opr++)
+    {
+        result_cache_store(l_opr, 0x04, 7, l_opr / 7, EQ_VAL_SIGNED, EQ_SOLVED);
+    }
+
+    // Lookups leave the counters alone until the caller records them
+    result_cache_stats_t stats;
+    result_cache_stats(&stats);
+    EXPECT_EQ(stats.hits + stats.misses, 0);
+    result_cache_record(1, 3);
+
+    result_cache_stats(&stats);
+    EXPECT_EQ(stats.capacity, 64);
+    EXPECT_EQ(stats.hits, 1);
+    EXPECT_EQ(stats.misses, 3);
+    EXPECT_EQ(stats.inserts, 1025);
+    EXPECT_EQ(stats.inserts - stats.evictions, stats.capacity);
+
+    result_cache_destroy();
+    EXPECT_EQ(result_cache_enabled(), 0);
+    result_cache_stats(&stats);
+    EXPECT_EQ(stats.capacity, 0);
+}
+
+// Solving through the cache gives the same outputs as solving without it,
+// both when the cache is cold and when every result comes from it
+TEST(TestResultCache, MatchesUncachedSolve)
+{
+    const uint64_t values[] = {
+        0, 1, 2, 3, 7, 10, 1000000000, (uint64_t)INT64_MAX, (uint64_t)INT64_MIN,
+        (uint64_t)-1, (uint64_t)-2, (uint64_t)-10, 0xFFFFFFFF, 0x100000000,
+    };
+
+    std::vector<uint64_t> l_operands;
+    std::vector<uint8_t> opts;
+    std::vector<uint64_t> r_operands;
+    for (uint8_t opt = 0x00; opt <= 0x0d; opt++)
+    {
+        for (uint64_t l_opr : values)
+        {
+            for (uint64_t r_opr : values)
+            {
+                l_operands.push_back(l_opr);
+                opts.push_back(opt);
+                r_operands.push_back(r_opr);
+            }
+        }
+    }
+
+    size_t count = opts.size();
+    std::vector<uint64_t> expected_solution(count);
+    std::vector<uint8_t> expected_sign(count);
+    std::vector<uint8_t> expected_result(count);
+    solve_columns(l_operands.data(), opts.data(), r_operands.data(), count,
+                  expected_solution.data(), expected_sign.data(), expected_result.data());
+
+    ASSERT_EQ(result_cache_init(4096), 0);
+    for (int pass = 0; pass < 2; pass++)
+    {
+        std::vector<uint64_t> solution(count);
+        std::vector<uint8_t> sign(count);
+        std::vector<uint8_t> result(count);
+        solve_columns(l_operands.data(), opts.data(), r_operands.data(), count,
+                      solution.data(), sign.data(), result.data());
+        EXPECT_EQ(solution, expected_solution) << "Pass " << pass;
+        EXPECT_EQ(sign, expected_sign) << "Pass " << pass;
+        EXPECT_EQ(result, expected_result) << "Pass " << pass;
+    }
+
+    // Only multiply, divide and modulo are cached and the second pass finds
+    // every one of them
+    uint64_t cached = 3 * (sizeof(values) / sizeof(values[0])) * (sizeof(values) / sizeof(values[0]));
+    result_cache_stats_t stats;
+    result_cache_stats(&stats);
+    EXPECT_EQ(stats.inserts, cached);
+    EXPECT_EQ(stats.misses, cached);
+    EXPECT_EQ(stats.hits, cached);
+    result_cache_destroy();
+}
+
+// Readers racing writers on a small cache never see a torn entry. Every
+// stored solution is derived from its key so a hit can be checked
+TEST(TestResultCache, ConcurrentReadersSeeWholeEntries)
+{
+    ASSERT_EQ(result_cache_init(64), 0);
+
+    std::atomic<uint64_t> torn{0};
+    std::vector<std::thread> threads;
+    for (uint64_t thread = 0; thread < 8; thread++)
+    {
+        threads.emplace_back([thread, &torn]() {
+            uint64_t solution = 0;
+            uint8_t sign = 0;
+            uint8_t result = 0;
+            uint64_t hits = 0;
+            for (uint64_t i = 0; i < 20000; i++)
+            {
+                uint64_t l_opr = (i * 7 + thread) % 512;
+                uint64_t r_opr = l_opr ^ 0x55;
+                if (result_cache_lookup(l_opr, 0x03, r_opr, &solution, &sign, &result))
+                {
+                    torn += (solution != (l_opr * r_opr)) || (EQ_VAL_SIGNED != sign) || (EQ_SOLVED != result);
+                    hits++;
+                }
+                else
+                {
+                    result_cache_store(l_opr, 0x03, r_opr, l_opr * r_opr, EQ_VAL_SIGNED, EQ_SOLVED);
+                }
+            }
+            result_cache_record(hits, 20000 - hits);
+        });
+    }
+    for (std::thread & thread : threads)
+    {
+        thread.join();
+    }
+
+    EXPECT_EQ(torn.load(), 0);
+    result_cache_stats_t stats;
+    result_cache_stats(&stats);
+    EXPECT_EQ(stats.hits + stats.misses, 8 * 20000);
+    result_cache_destroy();
+}
+
+// The sample only counts equations repeated within the sample
+TEST(TestDedupe, SamplesDuplicates)
+{
+    const uint16_t count = 8192;
+    std::vector<uint64_t> l_operands(count);
+    std::vector<uint8_t> opts(count, 0x04);
+    std::vector<uint64_t> r_operands(count, 3);
+    for (uint16_t i = 0; i < count; i++)
+    {
+        l_operands[i] = i;
+    }
+    EXPECT_EQ(sample_duplicates(l_operands.data(), opts.data(), r_operands.data(), count), 0);
+
+    // Only the first sampled equation is not a repeat
+    std::fill(l_operands.begin(), l_operands.end(), 99);
+    EXPECT_EQ(sample_duplicates(l_operands.data(), opts.data(), r_operands.data(), count), 1023);
+
+    // Same operands with a different operator are different equations
+    for (uint16_t i = 0; i < count; i++)
+    {
+        opts[i] = (uint8_t)(0x01 + (i % 2));
+    }
+    EXPECT_EQ(sample_duplicates(l_operands.data(), opts.data(), r_operands.data(), count), 1022);
+}
+
+// The pass only pays for itself when nearly every equation repeats. A
+// window whose sample falls just short of that is solved equation by
+// equation, one just over it is deduplicated
+TEST(TestDedupe, SkipsWindowsBelowThreshold)
+{
+    const uint64_t count = 4096;
+    const uint16_t threshold = (1024 * 95 + 99) / 100;
+
+    // Every sampled run of 128 starts with unique equations and repeats one
+    // equation after that
+    for (uint64_t unique : {(uint64_t)7, (uint64_t)6})
+    {
+        equ_batch_t * batch = get_equation_batch(count);
+        ASSERT_NE(batch, nullptr);
+        for (uint64_t i = 0; i < count; i++)
+        {
+            batch->l_operand[i] = ((i % 512) < unique) ? i + 1000 : 99;
+            batch->opt[i] = 0x01;
+            batch->r_operand[i] = 3;
+        }
+
+        uint16_t duplicates = sample_duplicates(batch->l_operand, batch->opt, batch->r_operand, (uint16_t)count);
+        EXPECT_EQ(duplicates, 1024 - (8 * unique) - 1) << unique;
+        solve_equation_batch(batch);
+        // 967 of 1024 sampled repeats is just under 95%, 975 is just over
+        EXPECT_EQ(duplicates >= threshold, 6 == unique) << unique;
+        EXPECT_EQ(batch->dedupe != nullptr, 6 == unique) << unique;
+        EXPECT_EQ(batch->solution[0], 1003u);
+        EXPECT_EQ(batch->solution[count - 1], 102u);
+        free_equation_batch(batch);
+    }
+}
+
+// Batches made mostly of repeats go through the duplicate pass and must
+// match solving every equation, including the windows that are not sampled
+TEST(TestDedupe, RepeatedBatchesMatchColumns)
+{
+    const uint64_t values[] = {
+        0, 1, 3, 7, (uint64_t)INT64_MAX, (uint64_t)INT64_MIN, (uint64_t)-1, (uint64_t)-7, 0x100000000,
+    };
+    const size_t value_count = sizeof(values) / sizeof(values[0]);
+
+    for (uint64_t count : {(uint64_t)4095, (uint64_t)4096, (uint64_t)40000})
+    {
+        equ_batch_t * batch = get_equation_batch(count);
+        ASSERT_NE(batch, nullptr);
+        // Every operator, unknown ones included, with each left operand. Each
+        // equation is repeated in a run of 32 so the sample is mostly repeats
+        for (uint64_t i = 0; i < count; i++)
+        {
+            uint64_t distinct = (i / 32) % (value_count * 0x0e);
+            batch->l_operand[i] = values[distinct % value_count];
+            batch->opt[i] = (uint8_t)(distinct / value_count);
+            batch->r_operand[i] = values[(distinct * 5) % value_count];
+        }
+
+        std::vector<uint64_t> solution(count);
+        std::vector<uint8_t> sign(count);
+        std::vector<uint8_t> result(count);
+        solve_columns(batch->l_operand, batch->opt, batch->r_operand, count,
+                      solution.data(), sign.data(), result.data());
+
+        solve_equation_batch(batch);
+        EXPECT_EQ(std::vector<uint64_t>(batch->solution, batch->solution + count), solution) << count;
+        EXPECT_EQ(std::vector<uint8_t>(batch->sign, batch->sign + count), sign) << count;
+        EXPECT_EQ(std::vector<uint8_t>(batch->result, batch->result + count), result) << count;
+        EXPECT_EQ(batch->dedupe != nullptr, count >= 4096) << count;
+        free_equation_batch(batch);
+    }
+}
+
+// Interleaved operators are bucketed before solving and scattered back. The
+// count spans several blocks and ends in a partial one
+TEST(TestColumns, BucketsInterleavedOperators)
+{
+    const size_t count = 2500;
+    std::vector<uint64_t> l_operands(count);
+    std::vector<uint8_t> opts(count);
+    std::vector<uint64_t> r_operands(count);
+    srand(42);
+    for (size_t i = 0; i < count; i++)
+    {
+        l_operands[i] = ((uint64_t)rand() << 33) ^ (uint64_t)rand();
+        opts[i] = (uint8_t)(rand() % 15);
+        r_operands[i] = (0 == (i % 3)) ? (uint64_t)(rand() % 70) : ((uint64_t)rand() << 31) ^ (uint64_t)rand();
+    }
+
+    // A long run in the middle of the columns takes the in place path
+    std::fill(opts.begin() + 1024, opts.begin() + 2048, 0x01);
+
+    std::vector<uint64_t> solution(count);
+    std::vector<uint8_t> sign(count);
+    std::vector<uint8_t> result(count);
+    solve_columns(l_operands.data(), opts.data(), r_operands.data(), count,
+                  solution.data(), sign.data(), result.data());
+
+    for (size_t i = 0; i < count; i++)
+    {
+        solution_t * eq = get_equation_struct((uint32_t)i, l_operands[i], opts[i], r_operands[i]);
+        ASSERT_NE(eq, nullptr);
+        EXPECT_EQ(result[i], eq->result) << "Index " << i;
+        EXPECT_EQ(sign[i], eq->sign) << "Index " << i;
+        EXPECT_EQ(solution[i], eq->solution) << "Index " << i;
+        free_equation_struct(eq);
+    }
+}
+
 /*
  * Both classes below perform parameterized testing. The first one is for the
  * cases where a signed int is expected as a return value while the second
@@ -49,7 +677,7 @@ TEST_P(SignedCalcTestFixture, TestingCalculations)
 
     if (1 == expected_succ)
     {
-        EXPECT_EQ(eq->result, EQ_SOLVED) << l_opr << " (" << hexchar{(char)opt} << ") " << r_optr << " = " << expected_int << "\n" << eq->error_msg;
+        EXPECT_EQ(eq->result, EQ_SOLVED) << l_opr << " (" << hexchar{(char)opt} << ") " << r_optr << " = " << expected_int << "\n" << get_status_message(eq->status);
         if (EQ_SOLVED == eq->result)
         {
             EXPECT_EQ(eq->solution, expected_int) << l_opr << " (" << hexchar{
@@ -60,6 +688,7 @@ TEST_P(SignedCalcTestFixture, TestingCalculations)
     {
         EXPECT_EQ(eq->result, EQ_FAILURE);
     }
+    expect_columns_match(eq, l_opr, opt, r_optr);
     free_equation_struct(eq);
 }
 
@@ -71,7 +700,7 @@ TEST_P(UnSignedCalcTestFixture, TestingCalculations)
 
     if (1 == expected_succ)
     {
-        EXPECT_EQ(eq->result, EQ_SOLVED) << l_opr << " (" << hexchar{(char)opt} << ") " << r_optr << " = " << expected_int << "\n" << eq->error_msg;
+        EXPECT_EQ(eq->result, EQ_SOLVED) << l_opr << " (" << hexchar{(char)opt} << ") " << r_optr << " = " << expected_int << "\n" << get_status_message(eq->status);
         if (EQ_SOLVED == eq->result)
         {
             EXPECT_EQ(eq->solution, expected_int) << l_opr << " (" << hexchar{
@@ -82,6 +711,7 @@ TEST_P(UnSignedCalcTestFixture, TestingCalculations)
     {
         EXPECT_EQ(eq->result, EQ_FAILURE);
     }
+    expect_columns_match(eq, l_opr, opt, r_optr);
     free_equation_struct(eq);
 }
 /*
@@ -137,7 +767,13 @@ INSTANTIATE_TEST_SUITE_P(
         std::make_tuple(INT64_MIN, 0x03, -1, 0, 0),
         std::make_tuple(INT64_MAX, 0x03, 10, 0, 0),
         std::make_tuple(10, 0x03, INT64_MAX, 0, 0),
-        std::make_tuple(1000, 0x03, 1000000000, 1000000000000, 1)
+        std::make_tuple(1000, 0x03, 1000000000, 1000000000000, 1),
+        std::make_tuple(5, 0x03, -1, 0, 0),
+        std::make_tuple(-4, 0x03, -5, 0, 0),
+        std::make_tuple(INT64_MAX, 0x03, -1, 0, 0),
+        std::make_tuple(INT64_MIN + 1, 0x03, -1, 0, 0),
+        std::make_tuple(INT64_MIN, 0x03, 1, INT64_MIN, 1),
+        std::make_tuple(-2, 0x03, INT64_MAX, 0, 0)
     ));
 
 /*
@@ -1,7 +1,12 @@
 #include <gtest/gtest.h>
 #include <header_parser.h>
 #include <fcntl.h>
+#include <equ_map.h>
+#include <equ_parser.h>
+#include <arpa/inet.h>
+#include <sys/socket.h>
 #include <calculation.h>
+#include <atomic>
 
 
 int possible_paths = 3;
@@ -12,6 +17,48 @@ const char * base_paths[3] = {"tests/unsolved/",
                               "../../tests/unsolved/",
                               "../../../../tests/unsolved/"};
 
+// Provided by the sanitizer runtime when the tests link one. Declared weak so
+// that builds without it still link
+extern "C" __attribute__((weak)) int __sanitizer_install_malloc_and_free_hooks(
+    void (* malloc_hook)(const volatile void *, size_t),
+    void (* free_hook)(const volatile void *));
+
+std::atomic<size_t> largest_alloc{0};
+
+static void track_malloc(const volatile void * ptr, size_t size)
+{
+    (void)ptr;
+    size_t seen = largest_alloc.load();
+    while ((size > seen) && !largest_alloc.compare_exchange_weak(seen, size))
+    {
+    }
+}
+
+static void track_free(const volatile void * ptr)
+{
+    (void)ptr;
+}
+
+/*
+ * Start tracking the largest heap allocation from now on. Returns false when
+ * there is no sanitizer runtime to report the allocations
+ */
+bool track_largest_alloc()
+{
+    static bool installed = false;
+    if (nullptr == __sanitizer_install_malloc_and_free_hooks)
+    {
+        return false;
+    }
+    if (!installed)
+    {
+        __sanitizer_install_malloc_and_free_hooks(track_malloc, track_free);
+        installed = true;
+    }
+    largest_alloc = 0;
+    return true;
+}
+
 int get_file(const char * file_name)
 {
     for (int i = 0; i < possible_paths; i++)
@@ -40,37 +87,685 @@ TEST(Simple, Simple)
     ASSERT_EQ(magic_filed, MAGIC_VALUE);
     lseek(file, 0, SEEK_SET);
 
-    equations_t * eqs = parse_stream(file);
+    stream_reader_t * reader = stream_reader_init(file, SR_DEFAULT_CAPACITY);
+    ASSERT_NE(reader, nullptr);
+    equations_t * eqs = parse_stream(reader);
     ASSERT_NE(eqs, nullptr);
 
     // Test th of the opts are within the accepted range. Any miss alignment
     // should show up here
-    unsolved_eq_t * un_eq = eqs->eqs;
-    while (NULL != un_eq)
+    equ_batch_t * batch = eqs->batch;
+    ASSERT_NE(batch, nullptr);
+    ASSERT_EQ(batch->count, eqs->number_of_eq);
+    for (uint64_t i = 0; i < batch->count; i++)
+    {
+        EXPECT_TRUE((batch->opt[i] >= 0) && (batch->opt[i] <= 0x0c));
+    }
+
+    solve_equation_batch(batch);
+    for (uint64_t i = 0; i < batch->count; i++)
     {
-        EXPECT_TRUE((un_eq->opt >= 0) && (un_eq->opt <= 0x0c));
-        solution_t * eq = get_equation_struct(un_eq->eq_id, un_eq->l_operand, un_eq->opt, un_eq->r_operand);
-        if (NULL == eq)
+        EXPECT_NE(batch->result[i], EQ_UNSOLVED);
+        if (EQ_VAL_SIGNED == batch->sign[i])
         {
-            continue;
+            printf("%ld\n%d\n%ld\n", (int64_t)batch->l_operand[i], batch->opt[i], (int64_t)batch->r_operand[i]);
         }
-        un_eq->solution = eq;
+        else
+        {
+            printf("%ld\n%d\n%ld\n", batch->l_operand[i], batch->opt[i], batch->r_operand[i]);
+        }
+        printf("Result: %ld\nStatus:%s\n\n", batch->solution[i], (batch->result[i] == EQ_SOLVED) ? "Solved" : "Failure");
+    }
+
+
+    free_equation(eqs);
+    stream_reader_destroy(&reader);
+    close(file);
+}
+
+
+TEST(StreamReader, SmallCapacityMatchesDefault)
+{
+    const char * file_name = "3a78786203e77c0b.equ";
+    int file = get_file(file_name);
+    ASSERT_NE(file, -1) << "[!] File provided " << file_name << " was not found\n";
+
+    // A capacity that does not divide any of the field sizes forces fields
+    // to straddle refills of the buffer
+    stream_reader_t * reader = stream_reader_init(file, SR_DEFAULT_CAPACITY);
+    ASSERT_NE(reader, nullptr);
+    equations_t * expected = parse_stream(reader);
+    ASSERT_NE(expected, nullptr);
+    stream_reader_destroy(&reader);
+
+    lseek(file, 0, SEEK_SET);
+    reader = stream_reader_init(file, 7);
+    ASSERT_NE(reader, nullptr);
+    equations_t * eqs = parse_stream(reader);
+    ASSERT_NE(eqs, nullptr);
+
+    EXPECT_EQ(eqs->number_of_eq, expected->number_of_eq);
+    for (uint64_t i = 0; i < eqs->batch->count; i++)
+    {
+        EXPECT_EQ(eqs->batch->eq_id[i], expected->batch->eq_id[i]);
+        EXPECT_EQ(eqs->batch->l_operand[i], expected->batch->l_operand[i]);
+        EXPECT_EQ(eqs->batch->opt[i], expected->batch->opt[i]);
+        EXPECT_EQ(eqs->batch->r_operand[i], expected->batch->r_operand[i]);
+    }
+
+    free_equation(expected);
+    free_equation(eqs);
+    stream_reader_destroy(&reader);
+    close(file);
+}
+
+TEST(StreamReader, ClosedStreamFails)
+{
+    int pipe_fds[2];
+    ASSERT_EQ(pipe(pipe_fds), 0);
+
+    uint8_t partial[3] = {0x55, 0xBB, 0x77};
+    ASSERT_EQ(write(pipe_fds[1], partial, sizeof(partial)), 3);
+    close(pipe_fds[1]);
+
+    stream_reader_t * reader = stream_reader_init(pipe_fds[0], SR_DEFAULT_CAPACITY);
+    ASSERT_NE(reader, nullptr);
+
+    uint32_t magic = 0;
+    EXPECT_EQ(stream_reader_read(reader, &magic, HEAD_MAGIC), -1);
+
+    stream_reader_destroy(&reader);
+    EXPECT_EQ(reader, nullptr);
+    close(pipe_fds[0]);
+}
+
+TEST(Serialize, SolvedRecords)
+{
+    equations_t eqs = {
+        .magic_id       = MAGIC_VALUE,
+        .file_id        = 0x1122334455667788,
+        .number_of_eq   = 2,
+        .flags          = UNSOLVED_VAL,
+        .offset         = EQU_HEADER_SIZE,
+        .num_of_opts    = 0,
+        .batch          = get_equation_batch(2),
+    };
+    ASSERT_NE(eqs.batch, nullptr);
+
+    // 10 - 30 is signed and solvable while 1 / 0 fails
+    eqs.batch->eq_id[0] = 7;
+    eqs.batch->l_operand[0] = 10;
+    eqs.batch->opt[0] = 0x02;
+    eqs.batch->r_operand[0] = 30;
+    eqs.batch->eq_id[1] = 8;
+    eqs.batch->l_operand[1] = 1;
+    eqs.batch->opt[1] = 0x04;
+    eqs.batch->r_operand[1] = 0;
+    solve_equation_batch(eqs.batch);
+
+    uint64_t size = get_solved_size(&eqs);
+    ASSERT_EQ(size, EQU_HEADER_SIZE + 2 * SOLVED_EQU_SIZE);
+    std::vector<uint8_t> buffer(size);
+
+    size_t written = serialize_file_header(&eqs, buffer.data(), buffer.size());
+    ASSERT_EQ(written, EQU_HEADER_SIZE);
+    written += serialize_solutions(eqs.batch, buffer.data() + written, buffer.size() - written);
+    ASSERT_EQ(written, size);
 
-        if (EQ_VAL_SIGNED == eq->sign)
+    uint32_t magic = 0;
+    memcpy(&magic, buffer.data(), HEAD_MAGIC);
+    EXPECT_EQ(magic, MAGIC_VALUE);
+    EXPECT_EQ(buffer[20], SOLVED_VAL);
+
+    uint8_t * record = buffer.data() + EQU_HEADER_SIZE;
+    uint32_t eq_id = 0;
+    int64_t solution = 0;
+    memcpy(&eq_id, record, SO_EQU_ID);
+    memcpy(&solution, record + 6, SO_EQU_SOLUTION);
+    EXPECT_EQ(eq_id, 7);
+    EXPECT_EQ(record[4], SOLVED_VAL);
+    EXPECT_EQ(record[5], SIGNED_OUTPUT);
+    EXPECT_EQ(solution, -20);
+
+    record += SOLVED_EQU_SIZE;
+    memcpy(&eq_id, record, SO_EQU_ID);
+    EXPECT_EQ(eq_id, 8);
+    EXPECT_EQ(record[4], UNSOLVED_VAL);
+
+    free_equation_batch(eqs.batch);
+}
+
+TEST(DecodeRun, VariantsMatchScalar)
+{
+    // 37 records exercises the vector loops and the scalar tail
+    const uint64_t count = 37;
+    std::vector<uint8_t> records(count * UNSOLVED_EQU_SIZE);
+    srand(1337);
+    for (auto & byte : records)
+    {
+        byte = (uint8_t)rand();
+    }
+    for (uint64_t i = 0; i < count; i++)
+    {
+        uint8_t * record = records.data() + (i * UNSOLVED_EQU_SIZE);
+        record[13] = (uint8_t)(i % 15);
+        if (0 != (i % 5))
         {
-            printf("%ld\n%d\n%ld\n", (int64_t)eq->l_operand, eq->opt, (int64_t)eq->r_operand);
+            memset(record + (UNSOLVED_EQU_SIZE - UNSO_PADDING), 0, UNSO_PADDING);
         }
-        else
+    }
+
+    decode_variant_t original = get_decode_variant();
+    ASSERT_EQ(set_decode_variant(DECODE_VARIANT_SCALAR), 1);
+    equ_batch_t * expected = get_equation_batch(count);
+    ASSERT_NE(expected, nullptr);
+    uint64_t expected_malformed = decode_unsolved_run(records.data(), count, expected, 0);
+    EXPECT_GT(expected_malformed, 0);
+
+    for (decode_variant_t variant : {DECODE_VARIANT_AVX2, DECODE_VARIANT_AVX512})
+    {
+        if (0 == set_decode_variant(variant))
         {
-            printf("%ld\n%d\n%ld\n", eq->l_operand, eq->opt, eq->r_operand);
+            continue;
         }
-        printf("Result: %ld\nStatus:%s\n\n", eq->solution, (eq->result == EQ_SOLVED) ? "Solved" : "Failure");
-        un_eq = un_eq->next;
+        equ_batch_t * batch = get_equation_batch(count);
+        ASSERT_NE(batch, nullptr);
+        EXPECT_EQ(decode_unsolved_run(records.data(), count, batch, 0), expected_malformed);
+        for (uint64_t i = 0; i < count; i++)
+        {
+            EXPECT_EQ(batch->eq_id[i], expected->eq_id[i]);
+            EXPECT_EQ(batch->flags[i], expected->flags[i]);
+            EXPECT_EQ(batch->l_operand[i], expected->l_operand[i]);
+            EXPECT_EQ(batch->opt[i], expected->opt[i]);
+            EXPECT_EQ(batch->r_operand[i], expected->r_operand[i]);
+        }
+        free_equation_batch(batch);
+    }
+
+    set_decode_variant(original);
+    free_equation_batch(expected);
+}
+
+/*
+ * Write a small unsolved file with an optional header of opt_size bytes
+ * between the file header and the records into an unlinked temporary file
+ */
+int write_temp_equ(uint32_t magic, uint16_t num_of_opts, uint32_t opt_size, uint64_t number_of_eq, uint64_t records_written)
+{
+    char path[] = "/tmp/gtest_equ_XXXXXX";
+    int file = mkstemp(path);
+    if (-1 == file)
+    {
+        return -1;
+    }
+    unlink(path);
+
+    uint32_t offset = EQU_HEADER_SIZE + opt_size;
+    std::vector<uint8_t> data(offset + records_written * UNSOLVED_EQU_SIZE, 0xAA);
+    memcpy(data.data(), &magic, HEAD_MAGIC);
+    memset(data.data() + 4, 0, HEAD_FILEID);
+    memcpy(data.data() + 12, &number_of_eq, HEAD_NUM_OF_EQU);
+    data[20] = UNSOLVED_VAL;
+    memcpy(data.data() + 21, &offset, HEAD_EQU_OFFSET);
+    memcpy(data.data() + 25, &num_of_opts, HEAD_NUM_OF_OPT_HEADERS);
+
+    for (uint64_t i = 0; i < records_written; i++)
+    {
+        uint8_t * record = data.data() + offset + i * UNSOLVED_EQU_SIZE;
+        uint32_t eq_id = (uint32_t)(100 + i);
+        uint64_t l_operand = i;
+        uint64_t r_operand = 2;
+        memset(record, 0, UNSOLVED_EQU_SIZE);
+        memcpy(record, &eq_id, UNSO_EQU_ID);
+        memcpy(record + 5, &l_operand, L_OPERAND);
+        record[13] = 0x03;
+        memcpy(record + 14, &r_operand, R_OPERAND);
+    }
+
+    if ((ssize_t)data.size() != write(file, data.data(), data.size()))
+    {
+        close(file);
+        return -1;
+    }
+    lseek(file, 0, SEEK_SET);
+    return file;
+}
+
+TEST(EquMap, MatchesParseStream)
+{
+    const char * file_name = "3a78786203e77c0b.equ";
+    int file = get_file(file_name);
+    ASSERT_NE(file, -1) << "[!] File provided " << file_name << " was not found\n";
+
+    stream_reader_t * reader = stream_reader_init(file, SR_DEFAULT_CAPACITY);
+    ASSERT_NE(reader, nullptr);
+    equations_t * expected = parse_stream(reader);
+    ASSERT_NE(expected, nullptr);
+    stream_reader_destroy(&reader);
+
+    equ_map_t * map = equ_map_open(file);
+    close(file);
+    ASSERT_NE(map, nullptr);
+    EXPECT_EQ(map->header->file_id, expected->file_id);
+    EXPECT_EQ(map->header->number_of_eq, expected->number_of_eq);
+    EXPECT_EQ(map->header->offset, expected->offset);
+
+    for (uint64_t i = 0; i < expected->number_of_eq; i++)
+    {
+        EXPECT_EQ(map->records[i].eq_id, expected->batch->eq_id[i]);
+        EXPECT_EQ(map->records[i].l_operand, expected->batch->l_operand[i]);
+        EXPECT_EQ(map->records[i].opt, expected->batch->opt[i]);
+        EXPECT_EQ(map->records[i].r_operand, expected->batch->r_operand[i]);
+    }
+
+    equ_batch_t * batch = get_equation_batch(expected->number_of_eq);
+    ASSERT_NE(batch, nullptr);
+    equ_map_load_batch(map, 0, expected->number_of_eq, batch);
+    EXPECT_EQ(0, memcmp(batch->r_operand, expected->batch->r_operand, expected->number_of_eq * sizeof(uint64_t)));
+    equ_map_release(map, expected->number_of_eq);
+
+    free_equation_batch(batch);
+    free_equation(expected);
+    equ_map_close(&map);
+    EXPECT_EQ(map, nullptr);
+}
+
+TEST(EquMap, SkipsOptionalHeaders)
+{
+    int file = write_temp_equ(MAGIC_VALUE, 1, 13, 3, 3);
+    ASSERT_NE(file, -1);
+    equ_map_t * map = equ_map_open(file);
+    close(file);
+    ASSERT_NE(map, nullptr);
+
+    for (uint64_t i = 0; i < 3; i++)
+    {
+        EXPECT_EQ(map->records[i].eq_id, 100 + i);
+        EXPECT_EQ(map->records[i].l_operand, i);
+        EXPECT_EQ(map->records[i].opt, 0x03);
+    }
+    equ_map_close(&map);
+}
+
+TEST(EquMap, RejectsInvalidFiles)
+{
+    // Bad magic
+    int file = write_temp_equ(0xDEADBEEF, 0, 0, 1, 1);
+    ASSERT_NE(file, -1);
+    EXPECT_EQ(equ_map_open(file), nullptr);
+    close(file);
+
+    // More equations claimed than the file holds
+    file = write_temp_equ(MAGIC_VALUE, 0, 0, 4, 3);
+    ASSERT_NE(file, -1);
+    EXPECT_EQ(equ_map_open(file), nullptr);
+    close(file);
+
+    // Optional headers claimed without room for them
+    file = write_temp_equ(MAGIC_VALUE, 2, 0, 1, 1);
+    ASSERT_NE(file, -1);
+    EXPECT_EQ(equ_map_open(file), nullptr);
+    close(file);
+}
+
+/*
+ * Build a NetCalc upload out of the file: a big endian network header
+ * followed by the untouched file bytes
+ */
+std::vector<uint8_t> build_upload(int file, const char * file_name, uint32_t header_size)
+{
+    std::vector<uint8_t> upload(NET_MAX_HEADER_SIZE);
+    uint8_t chunk[4096];
+    ssize_t read_bytes;
+    lseek(file, 0, SEEK_SET);
+    while ((read_bytes = read(file, chunk, sizeof(chunk))) > 0)
+    {
+        upload.insert(upload.end(), chunk, chunk + read_bytes);
+    }
+
+    uint32_t name_len = htonl((uint32_t)strlen(file_name));
+    uint32_t size = htonl(header_size);
+    uint64_t total = swap_byte_order(upload.size());
+    memcpy(upload.data(), &size, NET_HEADER_SIZE);
+    memcpy(upload.data() + 4, &name_len, NET_FILE_NAME_LEN);
+    memcpy(upload.data() + 8, &total, NET_TOTAL_PACKET_SIZE);
+    strncpy((char *)upload.data() + 16, file_name, NET_FILE_NAME);
+    return upload;
+}
+
+class EquParserChunks : public ::testing::TestWithParam<size_t>{};
+
+TEST_P(EquParserChunks, MatchesParseStream)
+{
+    size_t chunk_size = GetParam();
+    const char * file_name = "3a78786203e77c0b.equ";
+    int file = get_file(file_name);
+    ASSERT_NE(file, -1) << "[!] File provided " << file_name << " was not found\n";
+
+    stream_reader_t * reader = stream_reader_init(file, SR_DEFAULT_CAPACITY);
+    ASSERT_NE(reader, nullptr);
+    equations_t * expected = parse_stream(reader);
+    ASSERT_NE(expected, nullptr);
+    stream_reader_destroy(&reader);
+
+    // Trailing bytes after the upload must be left alone
+    std::vector<uint8_t> upload = build_upload(file, file_name, NET_MAX_HEADER_SIZE);
+    size_t upload_size = upload.size();
+    upload.push_back(0xFF);
+    close(file);
+
+    equ_parser_t * parser = equ_parser_init();
+    ASSERT_NE(parser, nullptr);
+    size_t offset = 0;
+    equ_parser_status_t status = EP_NEED_MORE;
+    while ((EP_NEED_MORE == status) && (offset < upload.size()))
+    {
+        size_t consumed = 0;
+        size_t size = std::min(chunk_size, upload.size() - offset);
+        status = equ_parser_feed(parser, upload.data() + offset, size, &consumed);
+        offset += consumed;
     }
+    ASSERT_EQ(status, EP_COMPLETE);
+    EXPECT_EQ(offset, upload_size);
 
+    net_header_t * header = equ_parser_take_header(parser);
+    ASSERT_NE(header, nullptr);
+    EXPECT_EQ(header->header_size, NET_MAX_HEADER_SIZE);
+    EXPECT_EQ(header->name_len, strlen(file_name));
+    EXPECT_STREQ((char *)header->file_name, file_name);
 
+    equations_t * eqs = equ_parser_take_equations(parser);
+    ASSERT_NE(eqs, nullptr);
+    EXPECT_EQ(eqs->number_of_eq, expected->number_of_eq);
+    for (uint64_t i = 0; i < expected->number_of_eq; i++)
+    {
+        EXPECT_EQ(eqs->batch->eq_id[i], expected->batch->eq_id[i]);
+        EXPECT_EQ(eqs->batch->l_operand[i], expected->batch->l_operand[i]);
+        EXPECT_EQ(eqs->batch->opt[i], expected->batch->opt[i]);
+        EXPECT_EQ(eqs->batch->r_operand[i], expected->batch->r_operand[i]);
+    }
+
+    free_header(header);
     free_equation(eqs);
+    free_equation(expected);
+    equ_parser_destroy(&parser);
+    EXPECT_EQ(parser, nullptr);
+}
+
+INSTANTIATE_TEST_SUITE_P(
+    ChunkSizes,
+    EquParserChunks,
+    ::testing::Values(1, 7, 31, 32, 33, 48, 4096, 65536));
+
+TEST(EquParser, SkipsOptionalHeaders)
+{
+    int file = write_temp_equ(MAGIC_VALUE, 1, 13, 3, 3);
+    ASSERT_NE(file, -1);
+    std::vector<uint8_t> upload = build_upload(file, "opt.equ", NET_MAX_HEADER_SIZE);
     close(file);
+
+    equ_parser_t * parser = equ_parser_init();
+    ASSERT_NE(parser, nullptr);
+    size_t consumed = 0;
+    for (size_t i = 0; i < NET_MAX_HEADER_SIZE + EQU_HEADER_SIZE + 5; i++)
+    {
+        ASSERT_EQ(equ_parser_feed(parser, upload.data() + i, 1, &consumed), EP_NEED_MORE);
+    }
+    EXPECT_EQ(equ_parser_state(parser), EP_STATE_OPT_HEADERS);
+
+    size_t offset = NET_MAX_HEADER_SIZE + EQU_HEADER_SIZE + 5;
+    ASSERT_EQ(equ_parser_feed(parser, upload.data() + offset, upload.size() - offset, &consumed), EP_COMPLETE);
+    EXPECT_EQ(consumed, upload.size() - offset);
+
+    equations_t * eqs = equ_parser_take_equations(parser);
+    ASSERT_NE(eqs, nullptr);
+    for (uint64_t i = 0; i < 3; i++)
+    {
+        EXPECT_EQ(eqs->batch->eq_id[i], 100 + i);
+        EXPECT_EQ(eqs->batch->l_operand[i], i);
+    }
+    free_equation(eqs);
+    equ_parser_destroy(&parser);
 }
 
+TEST(EquParser, ReportsErrors)
+{
+    const char * file_name = "3a78786203e77c0b.equ";
+    int file = get_file(file_name);
+    ASSERT_NE(file, -1) << "[!] File provided " << file_name << " was not found\n";
+
+    // Header size of the reference client is off by 3
+    std::vector<uint8_t> upload = build_upload(file, file_name, NET_MAX_HEADER_SIZE + 3);
+    equ_parser_t * parser = equ_parser_init();
+    ASSERT_NE(parser, nullptr);
+    EXPECT_EQ(equ_parser_feed(parser, upload.data(), upload.size(), NULL), EP_ERROR);
+    EXPECT_EQ(equ_parser_take_equations(parser), nullptr);
+    net_header_t * header = equ_parser_take_header(parser);
+    ASSERT_NE(header, nullptr);
+    EXPECT_EQ(header->header_size, NET_MAX_HEADER_SIZE + 3);
+    free_header(header);
+    equ_parser_destroy(&parser);
+
+    // Bad magic
+    upload = build_upload(file, file_name, NET_MAX_HEADER_SIZE);
+    upload[NET_MAX_HEADER_SIZE] = 0x00;
+    parser = equ_parser_init();
+    ASSERT_NE(parser, nullptr);
+    EXPECT_EQ(equ_parser_feed(parser, upload.data(), upload.size(), NULL), EP_ERROR);
+    EXPECT_EQ(equ_parser_state(parser), EP_STATE_ERROR);
+    equ_parser_destroy(&parser);
+    close(file);
+}
+
+// The equation count is sent by the client, so memory is only committed for
+// the records that arrive. A header claiming 2^32 equations followed by three
+// records must not allocate a batch for the whole count
+TEST(EquParser, ClaimedCountDoesNotAllocate)
+{
+    int file = write_temp_equ(MAGIC_VALUE, 0, 0, 1ULL << 32, 3);
+    ASSERT_NE(file, -1);
+    std::vector<uint8_t> upload = build_upload(file, "claim.equ", NET_MAX_HEADER_SIZE);
+    close(file);
+    if (!track_largest_alloc())
+    {
+        GTEST_SKIP() << "No sanitizer runtime to report allocations";
+    }
+
+    equ_parser_t * parser = equ_parser_init();
+    ASSERT_NE(parser, nullptr);
+    size_t consumed = 0;
+    EXPECT_EQ(equ_parser_feed(parser, upload.data(), upload.size(), &consumed), EP_NEED_MORE);
+    EXPECT_EQ(consumed, upload.size());
+    EXPECT_EQ(equ_parser_state(parser), EP_STATE_RECORDS);
+    EXPECT_LT(largest_alloc.load(), (size_t)1 << 20);
+    equ_parser_destroy(&parser);
+}
+
+// Files larger than BATCH_START_SIZE grow the batch a few times while the
+// records arrive. Odd chunk sizes split records across the growth points
+TEST(EquParser, GrowsBatchAsRecordsArrive)
+{
+    const uint64_t number_of_eq = (BATCH_START_SIZE * 2) + 1808;
+    int file = write_temp_equ(MAGIC_VALUE, 0, 0, number_of_eq, number_of_eq);
+    ASSERT_NE(file, -1);
+    std::vector<uint8_t> upload = build_upload(file, "grow.equ", NET_MAX_HEADER_SIZE);
+
+    lseek(file, 0, SEEK_SET);
+    stream_reader_t * reader = stream_reader_init(file, 100);
+    ASSERT_NE(reader, nullptr);
+    equations_t * expected = parse_stream(reader);
+    ASSERT_NE(expected, nullptr);
+    stream_reader_destroy(&reader);
+    close(file);
+    ASSERT_EQ(expected->batch->count, number_of_eq);
 
+    equ_parser_t * parser = equ_parser_init();
+    ASSERT_NE(parser, nullptr);
+    equ_parser_status_t status = EP_NEED_MORE;
+    for (size_t offset = 0; (offset < upload.size()) && (EP_NEED_MORE == status); offset += 1000)
+    {
+        size_t chunk = std::min<size_t>(1000, upload.size() - offset);
+        status = equ_parser_feed(parser, upload.data() + offset, chunk, NULL);
+    }
+    ASSERT_EQ(status, EP_COMPLETE);
+    equations_t * eqs = equ_parser_take_equations(parser);
+    ASSERT_NE(eqs, nullptr);
+    ASSERT_EQ(eqs->batch->count, number_of_eq);
+
+    for (uint64_t i = 0; i < number_of_eq; i++)
+    {
+        ASSERT_EQ(expected->batch->eq_id[i], 100 + i);
+        ASSERT_EQ(expected->batch->l_operand[i], i);
+        ASSERT_EQ(eqs->batch->eq_id[i], 100 + i);
+        ASSERT_EQ(eqs->batch->l_operand[i], i);
+        ASSERT_EQ(eqs->batch->opt[i], 0x03);
+        ASSERT_EQ(eqs->batch->r_operand[i], 2);
+    }
+
+    free_equation(eqs);
+    free_equation(expected);
+    equ_parser_destroy(&parser);
+}
+
+class ParseStreamSocket : public ::testing::TestWithParam<size_t>{};
+
+// Sockets cannot seek so the padding and the optional headers have to be
+// consumed from the reader. Odd capacities split records across refills.
+TEST_P(ParseStreamSocket, SkipsOptionalHeadersAndPadding)
+{
+    int file = write_temp_equ(MAGIC_VALUE, 2, 45, 40, 40);
+    ASSERT_NE(file, -1);
+    std::vector<uint8_t> data(EQU_HEADER_SIZE + 45 + 40 * UNSOLVED_EQU_SIZE);
+    ASSERT_EQ(read(file, data.data(), data.size()), (ssize_t)data.size());
+    close(file);
+
+    int sockets[2];
+    ASSERT_EQ(socketpair(AF_UNIX, SOCK_STREAM, 0, sockets), 0);
+    ASSERT_EQ(write(sockets[1], data.data(), data.size()), (ssize_t)data.size());
+
+    stream_reader_t * reader = stream_reader_init(sockets[0], GetParam());
+    ASSERT_NE(reader, nullptr);
+    equations_t * eqs = parse_stream(reader);
+    ASSERT_NE(eqs, nullptr);
+    EXPECT_EQ(eqs->num_of_opts, 2);
+    for (uint64_t i = 0; i < 40; i++)
+    {
+        EXPECT_EQ(eqs->batch->eq_id[i], 100 + i);
+        EXPECT_EQ(eqs->batch->l_operand[i], i);
+        EXPECT_EQ(eqs->batch->opt[i], 0x03);
+        EXPECT_EQ(eqs->batch->r_operand[i], 2);
+    }
+
+    free_equation(eqs);
+    stream_reader_destroy(&reader);
+    close(sockets[0]);
+    close(sockets[1]);
+}
+
+INSTANTIATE_TEST_SUITE_P(
+    ReaderCapacities,
+    ParseStreamSocket,
+    ::testing::Values(5, 32, 100, SR_DEFAULT_CAPACITY));
+
+TEST(ParseStream, RecordsInChunksMatchWholeFile)
+{
+    const char * file_name = "3a78786203e77c0b.equ";
+    int file = get_file(file_name);
+    ASSERT_NE(file, -1) << "[!] File provided " << file_name << " was not found\n";
+
+    stream_reader_t * reader = stream_reader_init(file, SR_DEFAULT_CAPACITY);
+    ASSERT_NE(reader, nullptr);
+    equations_t * expected = parse_stream(reader);
+    ASSERT_NE(expected, nullptr);
+    stream_reader_destroy(&reader);
+
+    // Decode the records in uneven chunks like the server pipeline does
+    lseek(file, 0, SEEK_SET);
+    reader = stream_reader_init(file, 100);
+    ASSERT_NE(reader, nullptr);
+    equations_t * eqs = parse_file_header(reader);
+    ASSERT_NE(eqs, nullptr);
+    EXPECT_EQ(eqs->batch, nullptr);
+    ASSERT_EQ(eqs->number_of_eq, expected->number_of_eq);
+    eqs->batch = get_equation_batch(eqs->number_of_eq);
+    ASSERT_NE(eqs->batch, nullptr);
+
+    for (uint64_t parsed = 0; parsed < eqs->number_of_eq;)
+    {
+        uint64_t count = std::min<uint64_t>(3, eqs->number_of_eq - parsed);
+        ASSERT_EQ(parse_records(reader, eqs->batch, parsed, count), 0);
+        parsed += count;
+    }
+    EXPECT_EQ(parse_records(reader, eqs->batch, 0, 1), -1);
+
+    for (uint64_t i = 0; i < expected->number_of_eq; i++)
+    {
+        EXPECT_EQ(eqs->batch->eq_id[i], expected->batch->eq_id[i]);
+        EXPECT_EQ(eqs->batch->l_operand[i], expected->batch->l_operand[i]);
+        EXPECT_EQ(eqs->batch->opt[i], expected->batch->opt[i]);
+        EXPECT_EQ(eqs->batch->r_operand[i], expected->batch->r_operand[i]);
+    }
+
+    free_equation(eqs);
+    free_equation(expected);
+    stream_reader_destroy(&reader);
+    close(file);
+}
+
+TEST(ParseStream, RejectsInvalidHeaders)
+{
+    int file = write_temp_equ(0xDEADBEEF, 0, 0, 1, 1);
+    ASSERT_NE(file, -1);
+    stream_reader_t * reader = stream_reader_init(file, SR_DEFAULT_CAPACITY);
+    ASSERT_NE(reader, nullptr);
+    EXPECT_EQ(parse_stream(reader), nullptr);
+    stream_reader_destroy(&reader);
+    close(file);
+
+    // Too many equations for the size of the reply to be represented
+    file = write_temp_equ(MAGIC_VALUE, 0, 0, UINT64_MAX / SOLVED_EQU_SIZE, 1);
+    ASSERT_NE(file, -1);
+    reader = stream_reader_init(file, SR_DEFAULT_CAPACITY);
+    ASSERT_NE(reader, nullptr);
+    EXPECT_EQ(parse_file_header(reader), nullptr);
+    stream_reader_destroy(&reader);
+    close(file);
+
+    // Stream ends before every record arrived
+    file = write_temp_equ(MAGIC_VALUE, 0, 0, 4, 3);
+    ASSERT_NE(file, -1);
+    reader = stream_reader_init(file, SR_DEFAULT_CAPACITY);
+    ASSERT_NE(reader, nullptr);
+    EXPECT_EQ(parse_stream(reader), nullptr);
+    stream_reader_destroy(&reader);
+    close(file);
+}
+
+TEST(ParseStream, ClaimedCountDoesNotAllocate)
+{
+    int file = write_temp_equ(MAGIC_VALUE, 0, 0, 1ULL << 32, 3);
+    ASSERT_NE(file, -1);
+    std::vector<uint8_t> data(EQU_HEADER_SIZE + 3 * UNSOLVED_EQU_SIZE);
+    ASSERT_EQ(read(file, data.data(), data.size()), (ssize_t)data.size());
+    close(file);
+
+    int sockets[2];
+    ASSERT_EQ(socketpair(AF_UNIX, SOCK_STREAM, 0, sockets), 0);
+    ASSERT_EQ(write(sockets[1], data.data(), data.size()), (ssize_t)data.size());
+    shutdown(sockets[1], SHUT_WR);
+    if (!track_largest_alloc())
+    {
+        close(sockets[0]);
+        close(sockets[1]);
+        GTEST_SKIP() << "No sanitizer runtime to report allocations";
+    }
+
+    stream_reader_t * reader = stream_reader_init(sockets[0], SR_DEFAULT_CAPACITY);
+    ASSERT_NE(reader, nullptr);
+    EXPECT_EQ(parse_stream(reader), nullptr);
+    EXPECT_LT(largest_alloc.load(), (size_t)1 << 20);
+
+    stream_reader_destroy(&reader);
+    close(sockets[0]);
+    close(sockets[1]);
+}
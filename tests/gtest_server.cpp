@@ -1,6 +1,11 @@
 #include <gtest/gtest.h>
 #include <server.h>
+#include <header_parser.h>
 #include <arpa/inet.h>
+#include <sys/socket.h>
+#include <endian.h>
+#include <atomic>
+#include <thread>
 
 extern "C"
 {
@@ -8,7 +13,11 @@ extern "C"
     void free_args(args_t * args);
     uint32_t get_port(char * port);
     uint8_t get_threads(char * thread);
+    uint32_t get_window(char * window);
+    uint32_t get_cache_size(char * cache_size);
     int server_listen(uint32_t port, socklen_t * record_len);
+    void serve_client(void * sock);
+    extern uint32_t stream_window;
 }
 
 class ServerTestValidPorts : public ::testing::TestWithParam<std::tuple<std::string, bool>>{};
@@ -67,6 +76,64 @@ INSTANTIATE_TEST_SUITE_P(
         std::make_tuple("256", true),
         std::make_tuple("0", true)
     ));
+
+class ServerTestValidWindows : public ::testing::TestWithParam<std::tuple<std::string, bool>>{};
+
+TEST_P(ServerTestValidWindows, TestValidWindows)
+{
+    auto [window_str, expect_failure] = GetParam();
+
+    uint32_t window = get_window((char *)window_str.c_str());
+    if (expect_failure)
+    {
+        EXPECT_EQ(window, 0);
+    }
+    else
+    {
+        EXPECT_TRUE(window >= MIN_WINDOW && window <= MAX_WINDOW) << "Window str: " << window_str << " Converted: " << window;
+    }
+}
+
+INSTANTIATE_TEST_SUITE_P(
+    WindowTest,
+    ServerTestValidWindows,
+    ::testing::Values(
+        std::make_tuple("1", false),
+        std::make_tuple("16384", false),
+        std::make_tuple("1048576", false),
+        std::make_tuple("1048577", true),
+        std::make_tuple("-5", true),
+        std::make_tuple("0", true)
+    ));
+class ServerTestValidCacheSizes : public ::testing::TestWithParam<std::tuple<std::string, bool>>{};
+
+TEST_P(ServerTestValidCacheSizes, TestValidCacheSizes)
+{
+    auto [cache_str, expect_failure] = GetParam();
+
+    uint32_t cache_size = get_cache_size((char *)cache_str.c_str());
+    if (expect_failure)
+    {
+        EXPECT_EQ(cache_size, 0);
+    }
+    else
+    {
+        EXPECT_TRUE(cache_size >= MIN_CACHE && cache_size <= MAX_CACHE) << "Cache str: " << cache_str << " Converted: " << cache_size;
+    }
+}
+
+INSTANTIATE_TEST_SUITE_P(
+    CacheTest,
+    ServerTestValidCacheSizes,
+    ::testing::Values(
+        std::make_tuple("1", false),
+        std::make_tuple("65536", false),
+        std::make_tuple("16777216", false),
+        std::make_tuple("16777217", true),
+        std::make_tuple("-5", true),
+        std::make_tuple("0", true),
+        std::make_tuple("1k", true)
+    ));
 class ServerCmdTester : public ::testing::TestWithParam<std::tuple<std::vector<std::string>, bool>>{};
 
 // Parameter test handles signed testing
@@ -130,6 +197,12 @@ INSTANTIATE_TEST_SUITE_P(
         std::make_tuple(std::vector<std::string>{__FILE__, "extra_arg"}, true),
         std::make_tuple(std::vector<std::string>{__FILE__, "-w"}, true),
         std::make_tuple(std::vector<std::string>{__FILE__, "-w", "10", "-p", "10"}, true),
+        std::make_tuple(std::vector<std::string>{__FILE__, "-w", "4096"}, false),
+        std::make_tuple(std::vector<std::string>{__FILE__, "-w", "0"}, true),
+        std::make_tuple(std::vector<std::string>{__FILE__, "-p", "4000", "-n", "8", "-w", "64"}, false),
+        std::make_tuple(std::vector<std::string>{__FILE__, "-c", "65536"}, false),
+        std::make_tuple(std::vector<std::string>{__FILE__, "-c", "0"}, true),
+        std::make_tuple(std::vector<std::string>{__FILE__, "-c"}, true),
         std::make_tuple(std::vector<std::string>{__FILE__}, false)
     ));
 
@@ -145,3 +218,168 @@ TEST(ServerListenTest, ServerListen)
     close(sock_fd);
 }
 
+/*
+ * Build an upload of count records behind opt_size bytes of optional headers.
+ * The records cycle through every operator with operands that overflow,
+ * divide by zero and take negative values
+ */
+std::vector<uint8_t> build_stream_upload(uint64_t count, uint32_t opt_size)
+{
+    const char file_name[] = "stream.equ";
+    uint32_t offset = EQU_HEADER_SIZE + opt_size;
+    uint16_t num_of_opts = (0 == opt_size) ? 0 : 2;
+    std::vector<uint8_t> upload(NET_MAX_HEADER_SIZE + offset + count * UNSOLVED_EQU_SIZE, 0);
+
+    uint32_t header_size = htonl(NET_MAX_HEADER_SIZE);
+    uint32_t name_len = htonl(sizeof(file_name) - 1);
+    uint64_t total_payload_size = htobe64(upload.size());
+    memcpy(upload.data(), &header_size, NET_HEADER_SIZE);
+    memcpy(upload.data() + 4, &name_len, NET_FILE_NAME_LEN);
+    memcpy(upload.data() + 8, &total_payload_size, NET_TOTAL_PACKET_SIZE);
+    memcpy(upload.data() + 16, file_name, sizeof(file_name) - 1);
+
+    uint8_t * file = upload.data() + NET_MAX_HEADER_SIZE;
+    uint32_t magic = MAGIC_VALUE;
+    uint64_t file_id = 7;
+    memcpy(file, &magic, HEAD_MAGIC);
+    memcpy(file + 4, &file_id, HEAD_FILEID);
+    memcpy(file + 12, &count, HEAD_NUM_OF_EQU);
+    file[20] = UNSOLVED_VAL;
+    memcpy(file + 21, &offset, HEAD_EQU_OFFSET);
+    memcpy(file + 25, &num_of_opts, HEAD_NUM_OF_OPT_HEADERS);
+    memset(file + EQU_HEADER_SIZE, 0xAA, opt_size);
+
+    for (uint64_t i = 0; i < count; i++)
+    {
+        uint8_t * record = file + offset + i * UNSOLVED_EQU_SIZE;
+        uint32_t eq_id = (uint32_t)(100 + i);
+        uint64_t l_operand = i * 0x9E3779B97F4A7C15;
+        uint64_t r_operand = (i % 5) - 2;
+        memcpy(record, &eq_id, UNSO_EQU_ID);
+        memcpy(record + 5, &l_operand, L_OPERAND);
+        record[13] = (uint8_t)(0x01 + (i % 12));
+        memcpy(record + 14, &r_operand, R_OPERAND);
+    }
+    return upload;
+}
+
+/*
+ * Run serve_client on one end of a socket pair with the given stream window.
+ * The first sent bytes of the upload are written from a second thread while
+ * the reply is read, so neither side blocks the other. The client stops
+ * reading and shuts its end down once read_limit bytes have arrived
+ */
+std::vector<uint8_t> serve_upload(const std::vector<uint8_t> & upload, uint32_t window,
+                                  size_t sent, size_t read_limit = SIZE_MAX)
+{
+    int sockets[2];
+    if (0 != socketpair(AF_UNIX, SOCK_STREAM, 0, sockets))
+    {
+        return {};
+    }
+
+    stream_window = window;
+    int server_sock = sockets[1];
+    std::thread server([&server_sock]() { serve_client(&server_sock); });
+    std::thread client([&upload, &sockets, sent]() {
+        size_t written = 0;
+        while (written < sent)
+        {
+            ssize_t result = send(sockets[0], upload.data() + written, sent - written, MSG_NOSIGNAL);
+            if (result <= 0)
+            {
+                return;
+            }
+            written += (size_t)result;
+        }
+        shutdown(sockets[0], SHUT_WR);
+    });
+
+    std::vector<uint8_t> reply;
+    uint8_t chunk[4096];
+    while (reply.size() < read_limit)
+    {
+        size_t wanted = std::min(sizeof(chunk), read_limit - reply.size());
+        ssize_t read_bytes = read(sockets[0], chunk, wanted);
+        if (read_bytes <= 0)
+        {
+            break;
+        }
+        reply.insert(reply.end(), chunk, chunk + read_bytes);
+    }
+    shutdown(sockets[0], SHUT_RDWR);
+
+    client.join();
+    server.join();
+    close(sockets[0]);
+    stream_window = MAX_WINDOW;
+    return reply;
+}
+
+class ServerStreamReply : public ::testing::TestWithParam<std::tuple<uint32_t, uint32_t>>{};
+
+// Files larger than the window are solved and sent one window at a time
+// through the sender thread. The bytes must be the same as solving the whole
+// file at once, zero fill of the optional headers included
+TEST_P(ServerStreamReply, MatchesBufferedReply)
+{
+    auto [window, opt_size] = GetParam();
+    const uint64_t count = 1000;
+    std::vector<uint8_t> upload = build_stream_upload(count, opt_size);
+
+    std::vector<uint8_t> buffered = serve_upload(upload, MAX_WINDOW, upload.size());
+    ASSERT_EQ(buffered.size(), NET_MAX_HEADER_SIZE + EQU_HEADER_SIZE + opt_size + count * SOLVED_EQU_SIZE);
+    EXPECT_EQ(buffered[NET_MAX_HEADER_SIZE + 20], SOLVED_VAL);
+
+    std::vector<uint8_t> streamed = serve_upload(upload, window, upload.size());
+    EXPECT_EQ(streamed, buffered) << "Window " << window;
+}
+
+INSTANTIATE_TEST_SUITE_P(
+    StreamWindows,
+    ServerStreamReply,
+    ::testing::Combine(
+        ::testing::Values(1, 7, 64, 999),
+        ::testing::Values(0, 40, 5000)
+    ));
+
+// An upload that ends inside a window stops the stream after the windows
+// that were complete. The headers are already out so there is no error reply
+TEST(ServerStreamTruncated, StopsAfterCompleteWindows)
+{
+    const uint32_t window = 8;
+    for (uint32_t opt_size : {0u, 40u})
+    {
+        std::vector<uint8_t> upload = build_stream_upload(100, opt_size);
+        std::vector<uint8_t> buffered = serve_upload(upload, MAX_WINDOW, upload.size());
+
+        // Three whole windows, then four and a half records of the fourth
+        size_t file_header = EQU_HEADER_SIZE + opt_size;
+        size_t sent = NET_MAX_HEADER_SIZE + file_header + (3 * window + 4) * UNSOLVED_EQU_SIZE + 16;
+        std::vector<uint8_t> streamed = serve_upload(upload, window, sent);
+
+        ASSERT_EQ(streamed.size(), NET_MAX_HEADER_SIZE + file_header + 3 * window * SOLVED_EQU_SIZE) << opt_size;
+        EXPECT_TRUE(std::equal(streamed.begin(), streamed.end(), buffered.begin())) << opt_size;
+    }
+}
+
+// A client that goes away part way through the reply fails the writes of
+// the sender thread. Both threads of the connection have to give up instead
+// of solving the rest of the file or waiting on each other
+TEST(ServerStreamPeerClosed, StopsWhenWritesFail)
+{
+    const uint64_t count = 100000;
+    const uint32_t window = 64;
+    std::vector<uint8_t> upload = build_stream_upload(count, 0);
+    size_t first_window = NET_MAX_HEADER_SIZE + EQU_HEADER_SIZE + window * SOLVED_EQU_SIZE;
+
+    std::vector<uint8_t> partial = serve_upload(upload, window, upload.size(), first_window);
+    ASSERT_EQ(partial.size(), first_window);
+
+    // The part that did arrive is still the start of the right reply
+    std::vector<uint8_t> prefix = build_stream_upload(window, 0);
+    std::vector<uint8_t> expected = serve_upload(prefix, MAX_WINDOW, prefix.size());
+    ASSERT_EQ(expected.size(), first_window);
+    size_t records = NET_MAX_HEADER_SIZE + EQU_HEADER_SIZE;
+    EXPECT_TRUE(std::equal(partial.begin() + records, partial.end(), expected.begin() + records));
+}
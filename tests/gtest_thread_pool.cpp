@@ -1,5 +1,10 @@
 #include <gtest/gtest.h>
 #include <thread_pool.h>
+#include <chrono>
+#include <mutex>
+#include <set>
+#include <thread>
+#include <vector>
 
 void work_func_one(void * arg)
 {
@@ -59,3 +64,279 @@ TEST_F(ThreadPoolTextFixture, TestMultiUpdating)
 
 
 
+void work_func_count(void * arg)
+{
+    std::atomic_fetch_add((std::atomic_int64_t *)arg, 1);
+}
+
+void work_func_block(void * arg)
+{
+    std::atomic_bool * release = (std::atomic_bool *)arg;
+    while (!std::atomic_load(release))
+    {
+        usleep(1000);
+    }
+}
+
+// Fill the queue while every worker is held up so enqueue has to refuse a job
+TEST(ThreadPoolQueue, RefusesJobsWhenFull)
+{
+    thpool_t * thpool = thpool_init(4);
+    ASSERT_NE(thpool, nullptr);
+
+    std::atomic_bool release(false);
+    std::atomic_int64_t count(0);
+    for (int worker = 0; worker < 4; worker++)
+    {
+        ASSERT_EQ(thpool_enqueue_job(thpool, work_func_block, &release), THP_SUCCESS);
+    }
+
+    int64_t queued = 0;
+    while (THP_SUCCESS == thpool_enqueue_job(thpool, work_func_count, &count))
+    {
+        queued++;
+        ASSERT_LE(queued, THPOOL_QUEUE_SIZE);
+    }
+    EXPECT_GE(queued, THPOOL_QUEUE_SIZE - 4);
+
+    std::atomic_store(&release, true);
+    thpool_wait(thpool);
+    EXPECT_EQ(std::atomic_load(&count), queued);
+
+    // The slots can be used again once the jobs have been consumed
+    EXPECT_EQ(thpool_enqueue_job(thpool, work_func_count, &count), THP_SUCCESS);
+    thpool_wait(thpool);
+    EXPECT_EQ(std::atomic_load(&count), queued + 1);
+    thpool_destroy(&thpool);
+}
+
+// Equal numbers of producer threads and workers hammer the queue, producers
+// retry whenever the queue is full. Every job has to run exactly once.
+class ThreadPoolStress : public ::testing::TestWithParam<int>
+{
+};
+
+TEST_P(ThreadPoolStress, EveryJobRunsOnce)
+{
+    const int threads = GetParam();
+    const int64_t jobs_per_producer = 20000;
+    thpool_t * thpool = thpool_init((uint8_t)threads);
+    ASSERT_NE(thpool, nullptr);
+
+    std::atomic_int64_t count(0);
+    std::atomic_int64_t refused(0);
+    std::vector<std::thread> producers;
+    auto start = std::chrono::steady_clock::now();
+    for (int producer = 0; producer < threads; producer++)
+    {
+        producers.emplace_back([&]()
+        {
+            for (int64_t job = 0; job < jobs_per_producer; job++)
+            {
+                while (THP_SUCCESS != thpool_enqueue_job(thpool, work_func_count, &count))
+                {
+                    std::atomic_fetch_add(&refused, 1);
+                    std::this_thread::yield();
+                }
+            }
+        });
+    }
+    for (auto & producer : producers)
+    {
+        producer.join();
+    }
+    thpool_wait(thpool);
+    auto elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start);
+
+    EXPECT_EQ(std::atomic_load(&count), threads * jobs_per_producer);
+    printf("[ STRESS   ] %d producers, %d workers: %.0f jobs/s, %ld refused while full\n",
+           threads, threads, (double)(threads * jobs_per_producer) / elapsed.count(),
+           (long)std::atomic_load(&refused));
+    thpool_destroy(&thpool);
+}
+
+INSTANTIATE_TEST_SUITE_P(ThreadCounts, ThreadPoolStress, ::testing::Values(1, 8, 64, 128));
+
+// A job fans out children from inside the pool. The parent keeps its worker
+// busy, so any child that runs before it returns was stolen.
+typedef struct spawn_state_t
+{
+    thpool_t * thpool;
+    std::thread::id parent;
+    std::atomic_int64_t children_run;
+    std::atomic_int64_t children_stolen;
+    std::atomic_int64_t refused;
+} spawn_state_t;
+
+void work_func_child(void * arg)
+{
+    spawn_state_t * state = (spawn_state_t *)arg;
+    if (std::this_thread::get_id() != state->parent)
+    {
+        std::atomic_fetch_add(&state->children_stolen, 1);
+    }
+    std::atomic_fetch_add(&state->children_run, 1);
+    usleep(1000);
+}
+
+void work_func_parent(void * arg)
+{
+    spawn_state_t * state = (spawn_state_t *)arg;
+    state->parent = std::this_thread::get_id();
+    for (int child = 0; child < 64; child++)
+    {
+        if (THP_SUCCESS != thpool_enqueue_job(state->thpool, work_func_child, state))
+        {
+            std::atomic_fetch_add(&state->refused, 1);
+        }
+    }
+    usleep(50000);
+}
+
+TEST_F(ThreadPoolTextFixture, TestIdleWorkersSteal)
+{
+    spawn_state_t state;
+    state.thpool = this->thpool;
+    state.children_run = 0;
+    state.children_stolen = 0;
+    state.refused = 0;
+
+    ASSERT_EQ(thpool_enqueue_job(this->thpool, work_func_parent, &state), THP_SUCCESS);
+    thpool_wait(this->thpool);
+
+    EXPECT_EQ(std::atomic_load(&state.refused), 0);
+    EXPECT_EQ(std::atomic_load(&state.children_run), 64);
+    EXPECT_GT(std::atomic_load(&state.children_stolen), 0);
+}
+
+static std::atomic_int64_t inline_sum(0);
+
+void work_func_inline(void * arg)
+{
+    std::atomic_fetch_add(&inline_sum, *(int64_t *)arg);
+}
+
+// Arguments copied into the job arrive intact even though the caller's
+// copy is gone by the time the job runs
+TEST_F(ThreadPoolTextFixture, TestInlineArguments)
+{
+    std::atomic_store(&inline_sum, 0);
+    int64_t expected = 0;
+    for (int64_t value = 1; value <= 1000; value++)
+    {
+        ASSERT_EQ(thpool_enqueue_inline(this->thpool, work_func_inline, &value, sizeof(value)), THP_SUCCESS);
+        expected += value;
+    }
+    thpool_wait(this->thpool);
+    EXPECT_EQ(std::atomic_load(&inline_sum), expected);
+
+    uint8_t too_large[THPOOL_INLINE_ARG_SIZE + 1] = {0};
+    EXPECT_EQ(thpool_enqueue_inline(this->thpool, work_func_inline, too_large, sizeof(too_large)), THP_FAILURE);
+}
+
+// Records which threads ran a batch so the test can tell the sleeping
+// workers were woken for it and not left for a single thread to drain
+typedef struct batch_state_t
+{
+    std::mutex lock;
+    std::set<std::thread::id> threads;
+    std::atomic_int64_t jobs_run;
+} batch_state_t;
+
+void work_func_batch(void * arg)
+{
+    batch_state_t * state = *(batch_state_t **)arg;
+    {
+        std::lock_guard<std::mutex> guard(state->lock);
+        state->threads.insert(std::this_thread::get_id());
+    }
+    std::atomic_fetch_add(&state->jobs_run, 1);
+    usleep(50000);
+}
+
+TEST_F(ThreadPoolTextFixture, TestBatchWakesWorkers)
+{
+    batch_state_t state;
+    state.jobs_run = 0;
+    std::vector<batch_state_t *> states(8, &state);
+    std::vector<void *> args;
+    for (auto & entry : states)
+    {
+        args.push_back(&entry);
+    }
+
+    ASSERT_EQ(thpool_enqueue_batch(this->thpool, work_func_batch, args.data(), args.size()), THP_SUCCESS);
+    thpool_wait(this->thpool);
+    EXPECT_EQ(std::atomic_load(&state.jobs_run), 8);
+    EXPECT_GT(state.threads.size(), 1);
+}
+
+TEST_F(ThreadPoolTextFixture, TestBatchIsAllOrNothing)
+{
+    std::atomic_int64_t count(0);
+    std::vector<void *> args(THPOOL_QUEUE_SIZE + 1, &count);
+
+    EXPECT_EQ(thpool_enqueue_batch(this->thpool, work_func_count, args.data(), args.size()), THP_FAILURE);
+    thpool_wait(this->thpool);
+    EXPECT_EQ(std::atomic_load(&count), 0);
+
+    EXPECT_EQ(thpool_enqueue_batch(this->thpool, work_func_count, args.data(), 1000), THP_SUCCESS);
+    EXPECT_EQ(thpool_enqueue_batch(this->thpool, work_func_count, args.data(), 0), THP_SUCCESS);
+    thpool_wait(this->thpool);
+    EXPECT_EQ(std::atomic_load(&count), 1000);
+}
+
+void work_func_spawn_batch(void * arg)
+{
+    spawn_state_t * state = (spawn_state_t *)arg;
+    state->parent = std::this_thread::get_id();
+    std::vector<void *> args(64, state);
+    if (THP_SUCCESS != thpool_enqueue_batch(state->thpool, work_func_child, args.data(), args.size()))
+    {
+        std::atomic_fetch_add(&state->refused, 1);
+    }
+    usleep(50000);
+}
+
+// A batch from inside the pool lands on the worker's deque and is stolen
+TEST_F(ThreadPoolTextFixture, TestBatchFromWorker)
+{
+    spawn_state_t state;
+    state.thpool = this->thpool;
+    state.children_run = 0;
+    state.children_stolen = 0;
+    state.refused = 0;
+
+    ASSERT_EQ(thpool_enqueue_job(this->thpool, work_func_spawn_batch, &state), THP_SUCCESS);
+    thpool_wait(this->thpool);
+
+    EXPECT_EQ(std::atomic_load(&state.refused), 0);
+    EXPECT_EQ(std::atomic_load(&state.children_run), 64);
+    EXPECT_GT(std::atomic_load(&state.children_stolen), 0);
+}
+
+// Pools are started and stopped back to back, with and without work, so a
+// lost wakeup during start up or shut down would hang the test
+TEST(ThreadPoolLifecycle, RepeatedInitDestroy)
+{
+    for (int threads : {1, 8, 64})
+    {
+        for (int round = 0; round < 20; round++)
+        {
+            thpool_t * thpool = thpool_init((uint8_t)threads);
+            ASSERT_NE(thpool, nullptr);
+            if (1 == (round % 2))
+            {
+                std::atomic_int64_t count(0);
+                for (int job = 0; job < 100; job++)
+                {
+                    ASSERT_EQ(thpool_enqueue_job(thpool, work_func_count, &count), THP_SUCCESS);
+                }
+                thpool_wait(thpool);
+                EXPECT_EQ(std::atomic_load(&count), 100);
+            }
+            thpool_destroy(&thpool);
+            EXPECT_EQ(thpool, nullptr);
+        }
+    }
+}